@@ -0,0 +1,305 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/execution/outstanding_work.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/prefer.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "stream/Stream.hpp"
+
+/// co_await support for all streams. Requires C++20, the library itself does not depend on it.
+///
+/// The await* functions return light awaiters usable from any coroutine type accepting standard awaiters.
+/// They do not allocate. The coroutine is resumed directly by the completion callback of the stream, on the thread executing it.
+/// If the operation completes immediately, i.e. data is already buffered, the coroutine is not suspended at all.
+///
+/// asio coroutines (boost::asio::awaitable) only accept asio operations. For those, use the async* functions
+/// taking a completion token, e.g. co_await asyncRead(stream, size, boost::asio::use_awaitable).
+/// They follow the rules of asio: The handler is posted to its associated executor, i.e. the one of the coroutine or a strand,
+/// also when the data is buffered already. Handlers without an associated executor are executed by boost::asio::system_executor.
+namespace daq::stream {
+    /// Result of operations transferring data
+    struct IoResult {
+        boost::system::error_code ec;
+        std::size_t bytesTransferred = 0;
+    };
+
+    /// Suspends the awaiting coroutine until the operation started by the derived class completes.
+    /// An awaiter is bound to the coroutine frame and is neither copied nor moved.
+    template < class Result >
+    class StreamAwaiter {
+    public:
+        explicit StreamAwaiter(Stream& stream)
+            : m_stream(stream)
+            , m_state(State::Initiating)
+        {
+        }
+
+        StreamAwaiter(const StreamAwaiter&) = delete;
+        StreamAwaiter& operator= (const StreamAwaiter&) = delete;
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        Result await_resume() noexcept
+        {
+            return std::move(m_result);
+        }
+
+    protected:
+        /// Starts the operation and tells whether the coroutine needs to be suspended
+        template < class Initiate >
+        bool suspend(std::coroutine_handle <> handle, Initiate&& initiate)
+        {
+            m_handle = handle;
+            initiate();
+            // the operation might have completed already, i.e. the callback was executed directly or by another thread
+            return m_state.exchange(State::Suspended) != State::Completed;
+        }
+
+        void complete(Result result)
+        {
+            m_result = std::move(result);
+            if (m_state.exchange(State::Completed) == State::Suspended) {
+                m_handle.resume();
+            }
+        }
+
+        Stream& m_stream;
+
+    private:
+        enum class State {
+            Initiating,
+            Suspended,
+            Completed
+        };
+
+        std::coroutine_handle <> m_handle;
+        std::atomic < State > m_state;
+        Result m_result;
+    };
+
+    class InitAwaiter : public StreamAwaiter < boost::system::error_code > {
+    public:
+        using StreamAwaiter::StreamAwaiter;
+
+        bool await_suspend(std::coroutine_handle <> handle)
+        {
+            return suspend(handle, [this]() {
+                m_stream.asyncInit([this](const boost::system::error_code& ec) { complete(ec); });
+            });
+        }
+    };
+
+    class ReadAwaiter : public StreamAwaiter < boost::system::error_code > {
+    public:
+        ReadAwaiter(Stream& stream, std::size_t size)
+            : StreamAwaiter(stream)
+            , m_size(size)
+        {
+        }
+
+        bool await_suspend(std::coroutine_handle <> handle)
+        {
+            return suspend(handle, [this]() {
+                m_stream.asyncRead([this](const boost::system::error_code& ec) { complete(ec); }, m_size);
+            });
+        }
+
+    private:
+        std::size_t m_size;
+    };
+
+    class ReadSomeAwaiter : public StreamAwaiter < IoResult > {
+    public:
+        using StreamAwaiter::StreamAwaiter;
+
+        bool await_suspend(std::coroutine_handle <> handle)
+        {
+            return suspend(handle, [this]() {
+                m_stream.asyncReadSome([this](const boost::system::error_code& ec, std::size_t bytesRead) { complete({ ec, bytesRead }); });
+            });
+        }
+    };
+
+    class WriteAwaiter : public StreamAwaiter < IoResult > {
+    public:
+        WriteAwaiter(Stream& stream, const ConstBufferView& data)
+            : StreamAwaiter(stream)
+            , m_data(data)
+        {
+        }
+
+        WriteAwaiter(Stream& stream, const boost::asio::const_buffer& data)
+            : StreamAwaiter(stream)
+            , m_buffer(data)
+            , m_data(&m_buffer, &m_buffer + 1)
+        {
+        }
+
+        bool await_suspend(std::coroutine_handle <> handle)
+        {
+            return suspend(handle, [this]() {
+                m_stream.asyncWriteBuffers(m_data, [this](const boost::system::error_code& ec, std::size_t bytesWritten) { complete({ ec, bytesWritten }); });
+            });
+        }
+
+    private:
+        /// m_data refers to this for single buffer writes
+        boost::asio::const_buffer m_buffer;
+        ConstBufferView m_data;
+    };
+
+    class CloseAwaiter : public StreamAwaiter < boost::system::error_code > {
+    public:
+        using StreamAwaiter::StreamAwaiter;
+
+        bool await_suspend(std::coroutine_handle <> handle)
+        {
+            return suspend(handle, [this]() {
+                m_stream.asyncClose([this](const boost::system::error_code& ec) { complete(ec); });
+            });
+        }
+    };
+
+    /// co_await yields the boost::system::error_code of Stream::asyncInit()
+    inline InitAwaiter awaitInit(Stream& stream)
+    {
+        return InitAwaiter(stream);
+    }
+
+    /// co_await yields the boost::system::error_code of Stream::asyncRead(). The data is available by Stream::data() afterwards.
+    inline ReadAwaiter awaitRead(Stream& stream, std::size_t size)
+    {
+        return ReadAwaiter(stream, size);
+    }
+
+    /// co_await yields the IoResult of Stream::asyncReadSome()
+    inline ReadSomeAwaiter awaitReadSome(Stream& stream)
+    {
+        return ReadSomeAwaiter(stream);
+    }
+
+    /// co_await yields the IoResult of writing data. Data has to stay valid until the write completed.
+    inline WriteAwaiter awaitWrite(Stream& stream, const boost::asio::const_buffer& data)
+    {
+        return WriteAwaiter(stream, data);
+    }
+
+    /// co_await yields the IoResult of writing a sequence of buffers. The vector is not copied, it has to stay valid until the write completed.
+    inline WriteAwaiter awaitWrite(Stream& stream, const ConstBufferVector& data)
+    {
+        return WriteAwaiter(stream, ConstBufferView(data.data(), data.data() + data.size()));
+    }
+
+    /// co_await yields the boost::system::error_code of Stream::asyncClose()
+    inline CloseAwaiter awaitClose(Stream& stream)
+    {
+        return CloseAwaiter(stream);
+    }
+
+    /// Completion callback of a stream posting an asio completion handler to the associated executor of the handler.
+    /// Keeps the executor busy until the operation completed.
+    template < class Handler >
+    class PostedHandler {
+    public:
+        explicit PostedHandler(Handler handler)
+            : m_executor(boost::asio::prefer(boost::asio::get_associated_executor(handler), boost::asio::execution::outstanding_work.tracked))
+            , m_handler(std::move(handler))
+        {
+        }
+
+        template < class... Args >
+        void operator()(const Args&... args)
+        {
+            // the work is finished when the moved executor goes out of scope
+            Executor executor = std::move(m_executor);
+            boost::asio::post(executor, boost::asio::bind_executor(executor, [handler = std::move(m_handler), args...]() mutable { handler(args...); }));
+        }
+
+    private:
+        using Executor = std::decay_t < decltype(boost::asio::prefer(std::declval < boost::asio::associated_executor_t < Handler > >(),
+                                                                    boost::asio::execution::outstanding_work.tracked)) >;
+
+        Executor m_executor;
+        Handler m_handler;
+    };
+
+    /// Stream::asyncInit() for asio completion tokens, i.e. boost::asio::use_awaitable. Completion signature is void(boost::system::error_code).
+    template < class CompletionToken >
+    auto asyncInit(Stream& stream, CompletionToken&& token)
+    {
+        auto initiate = [&stream](auto handler) {
+            stream.asyncInit(PostedHandler < decltype(handler) >(std::move(handler)));
+        };
+        return boost::asio::async_initiate < CompletionToken, void(boost::system::error_code) >(initiate, token);
+    }
+
+    /// Stream::asyncRead() for asio completion tokens. Completion signature is void(boost::system::error_code).
+    template < class CompletionToken >
+    auto asyncRead(Stream& stream, std::size_t size, CompletionToken&& token)
+    {
+        auto initiate = [&stream, size](auto handler) {
+            stream.asyncRead(PostedHandler < decltype(handler) >(std::move(handler)), size);
+        };
+        return boost::asio::async_initiate < CompletionToken, void(boost::system::error_code) >(initiate, token);
+    }
+
+    /// Stream::asyncReadSome() for asio completion tokens. Completion signature is void(boost::system::error_code, std::size_t).
+    template < class CompletionToken >
+    auto asyncReadSome(Stream& stream, CompletionToken&& token)
+    {
+        auto initiate = [&stream](auto handler) {
+            stream.asyncReadSome(PostedHandler < decltype(handler) >(std::move(handler)));
+        };
+        return boost::asio::async_initiate < CompletionToken, void(boost::system::error_code, std::size_t) >(initiate, token);
+    }
+
+    /// Stream::asyncWrite() for asio completion tokens. Completion signature is void(boost::system::error_code, std::size_t).
+    template < class CompletionToken >
+    auto asyncWrite(Stream& stream, const boost::asio::const_buffer& data, CompletionToken&& token)
+    {
+        auto initiate = [&stream, data](auto handler) {
+            stream.asyncWrite(data, PostedHandler < decltype(handler) >(std::move(handler)));
+        };
+        return boost::asio::async_initiate < CompletionToken, void(boost::system::error_code, std::size_t) >(initiate, token);
+    }
+
+    /// Stream::asyncClose() for asio completion tokens. Completion signature is void(boost::system::error_code).
+    template < class CompletionToken >
+    auto asyncClose(Stream& stream, CompletionToken&& token)
+    {
+        auto initiate = [&stream](auto handler) {
+            stream.asyncClose(PostedHandler < decltype(handler) >(std::move(handler)));
+        };
+        return boost::asio::async_initiate < CompletionToken, void(boost::system::error_code) >(initiate, token);
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+
+#include "stream/BufferPool.hpp"
+#include "stream/Stream.hpp"
+
+namespace daq::stream {
+    struct BroadcastHubOptions {
+        /// Number of recent messages sent to a new subscriber right away. 0 disables the cache.
+        size_t lateJoinMessages = 0;
+        /// Messages are skipped for a subscriber with this many messages not yet written. 0 is unlimited.
+        size_t maxLagMessages = 0;
+    };
+
+    struct BroadcastSubscriberStats {
+        /// Messages queued on the stream but not written yet
+        size_t lagMessages = 0;
+        size_t lagBytes = 0;
+        uint64_t sentMessages = 0;
+        /// Messages skipped because of maxLagMessages or dropped by the overflow policy of the stream, see WriteQueueOptions
+        uint64_t skippedMessages = 0;
+    };
+
+    /// Sends the same messages to many streams, e.g. all streams accepted by a Server.
+    /// A message is one immutable reference counted buffer. It is queued on every subscribed stream without copying. The memory is released after the last stream wrote it.
+    /// Messages are queued by Stream::asyncWrite(). Byte oriented streams combine queued messages, websocket streams keep the boundaries.
+    /// Subscribers are held weakly. Streams that got destroyed or failed writing are removed, writes dropped by their overflow policy do not count as failure.
+    /// Not thread safe, use it from the io_context of the streams.
+    class BroadcastHub {
+    public:
+        explicit BroadcastHub(const BroadcastHubOptions& options = BroadcastHubOptions());
+        BroadcastHub(const BroadcastHub&) = delete;
+        BroadcastHub& operator= (const BroadcastHub&) = delete;
+
+        /// Add a stream. Cached messages are queued on it before anything else.
+        void subscribe(const StreamSharedPtr& stream);
+        void unsubscribe(const Stream& stream);
+        size_t subscriberCount() const;
+
+        /// Queue the message on all subscribers. The memory is shared, not copied.
+        void publish(const BufferSlice& message);
+        /// Copy the data once into reference counted memory and publish it
+        void publish(const boost::asio::const_buffer& data);
+
+        /// \return Statistics of the subscribed stream, all zero for an unknown stream
+        BroadcastSubscriberStats stats(const Stream& stream) const;
+        /// \return Biggest lag of all subscribers in messages
+        size_t maxLagMessages() const;
+
+    private:
+        struct Subscriber {
+            std::weak_ptr < Stream > stream;
+            BroadcastSubscriberStats stats;
+            /// Set by a failed write
+            bool failed = false;
+        };
+        using SubscriberSharedPtr = std::shared_ptr < Subscriber >;
+
+        static void send(const SubscriberSharedPtr& subscriber, Stream& stream, const BufferSlice& message);
+        /// Remove subscribers whose stream is gone or failed
+        void prune();
+
+        BroadcastHubOptions m_options;
+        std::vector < SubscriberSharedPtr > m_subscribers;
+        std::deque < BufferSlice > m_cache;
+    };
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+
+namespace daq::stream {
+    /// Read-only view into reference counted memory.
+    /// The memory stays valid as long as any slice referring to it exists.
+    /// Copying a slice only copies the reference, never the data. Slices may be passed to and released by other threads.
+    class BufferSlice {
+    public:
+        BufferSlice() = default;
+        BufferSlice(std::shared_ptr < const uint8_t > memory, const uint8_t* data, size_t size)
+            : m_memory(std::move(memory))
+            , m_data(data)
+            , m_size(size)
+        {
+        }
+
+        const uint8_t* data() const
+        {
+            return m_data;
+        }
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        bool empty() const
+        {
+            return m_size == 0;
+        }
+
+        /// \return A slice referring to part of this slice. Shares the memory.
+        BufferSlice subSlice(size_t offset, size_t size) const
+        {
+            return BufferSlice(m_memory, m_data + offset, size);
+        }
+
+        boost::asio::const_buffer buffer() const
+        {
+            return boost::asio::const_buffer(m_data, m_size);
+        }
+
+    private:
+        std::shared_ptr < const uint8_t > m_memory;
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+    };
+
+    class BufferPool;
+    using BufferPoolSharedPtr = std::shared_ptr < BufferPool >;
+
+    /// Keeps released memory chunks of a fixed size for reuse.
+    /// Chunks are handed out as reference counted memory. When the last reference is dropped, the chunk goes back to the pool.
+    /// Thread safe, chunks may be released by any thread.
+    class BufferPool : public std::enable_shared_from_this < BufferPool > {
+    public:
+        static const size_t DefaultChunkSize;
+        static const size_t DefaultMaxPooledChunks;
+
+        /// \param chunkSize Size of the pooled chunks
+        /// \param maxPooledChunks Released chunks exceeding this number are freed
+        static BufferPoolSharedPtr create(size_t chunkSize = DefaultChunkSize, size_t maxPooledChunks = DefaultMaxPooledChunks);
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator= (const BufferPool&) = delete;
+        ~BufferPool();
+
+        /// \return Memory of at least chunkSize(). Bigger requests are allocated without pooling.
+        std::shared_ptr < uint8_t > acquire(size_t size);
+
+        size_t chunkSize() const;
+        /// \return Number of released chunks waiting for reuse
+        size_t pooledChunks() const;
+
+    private:
+        BufferPool(size_t chunkSize, size_t maxPooledChunks);
+        void release(uint8_t* chunk);
+
+        const size_t m_chunkSize;
+        const size_t m_maxPooledChunks;
+        mutable std::mutex m_mutex;
+        std::vector < uint8_t* > m_chunks;
+    };
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include <boost/asio/buffer.hpp>
+
+namespace daq::stream {
+    /// Buffer sequence referring to consecutive buffers owned by someone else, i.e. a std::vector.
+    /// asio copies buffer sequences into its operations. Copying this view does not allocate, copying a vector does.
+    template < class Buffer >
+    class BufferSequenceView {
+    public:
+        using value_type = Buffer;
+        using const_iterator = const Buffer*;
+
+        BufferSequenceView() = default;
+        BufferSequenceView(const Buffer* begin, const Buffer* end)
+            : m_begin(begin)
+            , m_end(end)
+        {
+        }
+
+        const_iterator begin() const
+        {
+            return m_begin;
+        }
+
+        const_iterator end() const
+        {
+            return m_end;
+        }
+
+        size_t count() const
+        {
+            return static_cast < size_t >(m_end - m_begin);
+        }
+
+    private:
+        const Buffer* m_begin = nullptr;
+        const Buffer* m_end = nullptr;
+    };
+
+    using ConstBufferView = BufferSequenceView < boost::asio::const_buffer >;
+    using MutableBufferView = BufferSequenceView < boost::asio::mutable_buffer >;
+}
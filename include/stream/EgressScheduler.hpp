@@ -0,0 +1,107 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "stream/TokenBucket.hpp"
+
+namespace daq::stream {
+    class Stream;
+
+    struct EgressSchedulerOptions {
+        /// Bytes a stream of weight 1 may send per round
+        size_t quantum = 16 * 1024;
+        /// Transport writes in progress at the same time over all streams. 0 is unlimited.
+        size_t maxConcurrentWrites = 0;
+        /// Budget of all streams together. 0 is unlimited.
+        uint64_t bytesPerSecond = 0;
+        /// Budget collected while idle. 0 allows one second worth of bytes.
+        size_t burstBytes = 0;
+    };
+
+    class EgressScheduler;
+    using EgressSchedulerSharedPtr = std::shared_ptr < EgressScheduler >;
+
+    /// Shares the uplink of a Server between its streams by deficit round robin.
+    /// Streams with queued data take turns. Each turn, a stream gains quantum * weight bytes of credit and may start a transport write while it has credit.
+    /// The actual size of the write is charged afterwards, so big writes take several rounds to be paid back. Set WriteQueueOptions::maxChunkSize to keep them short.
+    /// Fairness only matters if something limits sending. That is the global budget, the number of concurrent writes, or both.
+    /// Not thread safe, all streams have to use the io_context of the scheduler.
+    class EgressScheduler {
+    public:
+        EgressScheduler(boost::asio::io_context& ioContext, const EgressSchedulerOptions& options = EgressSchedulerOptions());
+        EgressScheduler(const EgressScheduler&) = delete;
+        EgressScheduler& operator= (const EgressScheduler&) = delete;
+        ~EgressScheduler();
+
+        void setOptions(const EgressSchedulerOptions& options);
+        const EgressSchedulerOptions& options() const;
+
+        /// \param weight Share of the stream relative to the others. Default is 1, 0 is taken as 1.
+        void setWeight(const Stream& stream, size_t weight);
+        size_t weight(const Stream& stream) const;
+        /// \return Bytes sent by the stream since it got attached
+        uint64_t sentBytes(const Stream& stream) const;
+
+        /// \return Number of streams waiting for their turn
+        size_t waitingStreams() const;
+
+    private:
+        friend class Stream;
+
+        struct Entry {
+            size_t weight = 1;
+            /// Negative after sending more than the credit
+            int64_t deficit = 0;
+            bool waiting = false;
+            bool writing = false;
+            uint64_t sentBytes = 0;
+        };
+
+        /// Called by Stream::setEgressScheduler()
+        void attach(Stream& stream);
+        /// Called by Stream on destruction
+        void detach(Stream& stream);
+        /// The stream has queued data and waits for its turn. Also tells that the previous write completed.
+        void requestWrite(Stream& stream);
+        /// The transport write granted to the stream completed and the stream does not wait for its next turn,
+        /// i.e. nothing else is queued or it waits for its own write rate limit
+        void onWritten(Stream& stream);
+
+        /// Grant turns while limits allow
+        void dispatch();
+        void waitForBudget();
+
+        boost::asio::steady_timer m_timer;
+        EgressSchedulerOptions m_options;
+        TokenBucket m_budget;
+        std::unordered_map < const Stream*, Entry > m_entries;
+        /// Streams waiting for their turn, the next one first
+        std::deque < Stream* > m_waiting;
+        size_t m_writesInProgress;
+        bool m_timerPending;
+        bool m_dispatching;
+    };
+}
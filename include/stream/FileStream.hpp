@@ -33,15 +33,14 @@ namespace daq::stream {
 
     public:
         /// \param fileName Existing file to open
-        explicit FileStream(boost::asio::io_context& ioc, const std::string& fileName, bool writable = false);
+        /// \param receiveBufferType Memory used for buffering data read from the file
+        explicit FileStream(boost::asio::io_context& ioc, const std::string& fileName, bool writable = false, ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
         FileStream(const FileStream&) = delete;
         FileStream& operator= (FileStream&) = delete;
 
         /// Start the asynchronous operation
         void asyncInit(CompletionCb completionCb) override;
         boost::system::error_code init() override;
-        void asyncWrite(const boost::asio::const_buffer& data, WriteCompletionCb writeCompletionCb) override;
-        void asyncWrite(const ConstBufferVector& data, WriteCompletionCb writeCompletionCb) override;
 
         size_t write(const boost::asio::const_buffer& data, boost::system::error_code& ec) override;
         size_t write(const ConstBufferVector& data, boost::system::error_code& ec) override;
@@ -54,7 +53,11 @@ namespace daq::stream {
 
     private:
         void asyncReadAtLeast(std::size_t bytesToRead, ReadCompletionCb readCompletionCb) override;
+        void asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb) override;
         size_t readAtLeast(std::size_t bytesToRead, boost::system::error_code &ec) override;
+        void asyncWaitTransportReadable(CompletionCb waitCb) override;
+        size_t readSomeInto(const boost::asio::mutable_buffer& buffer, boost::system::error_code& ec) override;
+        void asyncReadAllInto(const MutableBufferView& buffers, ReadCompletionCb readCb) override;
 
         boost::asio::io_context& m_ioc;
         std::string m_fileName;
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "stream/Stream.hpp"
+#include "stream/UniqueFunction.hpp"
+
+namespace daq::stream {
+    /// Describes the header in front of each message: The payload length, optionally followed by a type byte.
+    /// The length does not include the header.
+    struct FrameHeaderFormat {
+        enum class Length {
+            UInt8,
+            UInt16,
+            UInt32,
+            UInt64,
+            /// Unsigned LEB128: 7 bits per byte, least significant group first, highest bit set if more bytes follow
+            Varint
+        };
+
+        enum class ByteOrder {
+            BigEndian,
+            LittleEndian
+        };
+
+        Length length = Length::UInt32;
+        /// Ignored for Length::UInt8 and Length::Varint
+        ByteOrder byteOrder = ByteOrder::BigEndian;
+        /// A type byte follows the length
+        bool typeByte = false;
+        /// Received messages with a bigger payload are treated as protocol error. FramedStream limits it to what fits into size_t with the header.
+        uint64_t maxPayloadSize = 16 * 1024 * 1024;
+    };
+
+    /// Decorator adding length prefixed messages to any stream.
+    ///
+    /// Received messages are delivered as views into the receive buffer of the stream, they are not copied.
+    /// Header and payload are sent by a single gather write without copying the payload, see Stream::asyncWritePrefixed().
+    /// The stream keeps callbacks referring to the FramedStream while a read is pending. The FramedStream has to outlive it,
+    /// i.e. close the stream and let the read complete before destroying the FramedStream.
+    class FramedStream {
+    public:
+        /// Biggest header possible: 10 bytes varint and type byte
+        static const size_t MaxHeaderSize = 11;
+
+        struct Message {
+            /// 0 if the format has no type byte
+            uint8_t type;
+            boost::asio::const_buffer payload;
+        };
+        using Messages = std::vector < Message >;
+        /// @param messages All complete messages received. The views are only valid during the callback.
+        using MessagesCb = UniqueFunction < void(const boost::system::error_code& ec, const Messages& messages) >;
+
+        explicit FramedStream(StreamSharedPtr stream, const FrameHeaderFormat& format = FrameHeaderFormat());
+        FramedStream(const FramedStream&) = delete;
+        FramedStream& operator= (const FramedStream&) = delete;
+
+        const StreamSharedPtr& stream() const;
+        const FrameHeaderFormat& format() const;
+
+        /// Request all complete messages available. If there is none, reads until there is at least one.
+        /// See Stream::asyncReadFrames(), messages are consumed after messagesCb returned.
+        /// A payload exceeding FrameHeaderFormat::maxPayloadSize completes with boost::asio::error::message_size.
+        /// The FramedStream must not be destroyed before messagesCb got executed.
+        void asyncReadMessages(MessagesCb messagesCb);
+
+        /// Header and payload are written by a single gather write. The payload is not copied and has to stay valid until completion.
+        /// A payload not fitting into the length field or exceeding FrameHeaderFormat::maxPayloadSize is not written,
+        /// it completes with boost::asio::error::message_size.
+        /// @param writeCompletionCb bytesWritten includes the header
+        void asyncWriteMessage(const boost::asio::const_buffer& payload, Stream::WriteCompletionCb writeCompletionCb);
+        void asyncWriteMessage(uint8_t type, const boost::asio::const_buffer& payload, Stream::WriteCompletionCb writeCompletionCb);
+        /// \return Number of bytes written including the header
+        size_t writeMessage(uint8_t type, const boost::asio::const_buffer& payload, boost::system::error_code& ec);
+
+        /// \param header Has to provide room for MaxHeaderSize bytes
+        /// \return Size of the header
+        static size_t encodeHeader(const FrameHeaderFormat& format, uint8_t type, uint64_t payloadSize, uint8_t* header);
+        /// \return Size of the header, 0 if size is too small to contain the complete header.
+        /// Stream::InvalidFrameLength on a malformed varint or one exceeding 64 bits.
+        static size_t decodeHeader(const FrameHeaderFormat& format, const uint8_t* data, size_t size, uint64_t& payloadSize, uint8_t& type);
+
+    private:
+        /// \return Length of the message including the header, see Stream::FrameLengthExtractor
+        size_t frameLength(const uint8_t* data, size_t size) const;
+        void onFrames(const boost::system::error_code& ec, const ConstBufferView& frames);
+
+        StreamSharedPtr m_stream;
+        FrameHeaderFormat m_format;
+        MessagesCb m_messagesCb;
+        /// Kept to reuse the memory
+        Messages m_messages;
+    };
+}
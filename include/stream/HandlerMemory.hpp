@@ -0,0 +1,134 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace daq::stream {
+    /// Memory for the asio operation of one asynchronous operation at a time.
+    /// If it is in use already or too small, the heap is used instead.
+    class HandlerMemory {
+    public:
+        static const size_t Size = 1024;
+
+        HandlerMemory() = default;
+        HandlerMemory(const HandlerMemory&) = delete;
+        HandlerMemory& operator= (const HandlerMemory&) = delete;
+
+        void* allocate(size_t size)
+        {
+            if (!m_inUse && size <= Size) {
+                m_inUse = true;
+                return m_storage;
+            }
+            return ::operator new(size);
+        }
+
+        void deallocate(void* pointer)
+        {
+            if (pointer == m_storage) {
+                m_inUse = false;
+            } else {
+                ::operator delete(pointer);
+            }
+        }
+
+    private:
+        alignas(std::max_align_t) unsigned char m_storage[Size];
+        bool m_inUse = false;
+    };
+
+    using HandlerMemorySharedPtr = std::shared_ptr < HandlerMemory >;
+
+    /// Allocator taking memory from a HandlerMemory.
+    /// Shares ownership, so the memory stays valid for pending operations even if the stream is gone.
+    template < class T >
+    class HandlerAllocator {
+    public:
+        using value_type = T;
+
+        explicit HandlerAllocator(HandlerMemorySharedPtr memory)
+            : m_memory(std::move(memory))
+        {
+        }
+
+        template < class U >
+        HandlerAllocator(const HandlerAllocator < U >& other) noexcept
+            : m_memory(other.m_memory)
+        {
+        }
+
+        T* allocate(size_t count)
+        {
+            return static_cast < T* >(m_memory->allocate(sizeof(T) * count));
+        }
+
+        void deallocate(T* pointer, size_t)
+        {
+            m_memory->deallocate(pointer);
+        }
+
+        template < class U >
+        bool operator== (const HandlerAllocator < U >& other) const noexcept
+        {
+            return m_memory == other.m_memory;
+        }
+
+        template < class U >
+        bool operator!= (const HandlerAllocator < U >& other) const noexcept
+        {
+            return m_memory != other.m_memory;
+        }
+
+    private:
+        template < class U > friend class HandlerAllocator;
+
+        HandlerMemorySharedPtr m_memory;
+    };
+
+    /// Completion handler whose asio operations are allocated from a HandlerMemory.
+    /// asio finds the memory by the associated allocator of the handler.
+    template < class Handler >
+    class MemoryBoundHandler {
+    public:
+        using allocator_type = HandlerAllocator < Handler >;
+
+        MemoryBoundHandler(HandlerMemorySharedPtr memory, Handler handler)
+            : m_memory(std::move(memory))
+            , m_handler(std::move(handler))
+        {
+        }
+
+        allocator_type get_allocator() const noexcept
+        {
+            return allocator_type(m_memory);
+        }
+
+        template < class... Args >
+        void operator()(Args&&... args)
+        {
+            m_handler(std::forward < Args >(args)...);
+        }
+
+    private:
+        HandlerMemorySharedPtr m_memory;
+        Handler m_handler;
+    };
+}
@@ -26,7 +26,8 @@ class LocalClientStream : public LocalStream
 {
 public:
     /// Resolver and socket require an io_context
-    explicit LocalClientStream(boost::asio::io_context& ioc, const std::string& endPointFile);
+    /// \param receiveBufferType Memory used for buffering received data
+    explicit LocalClientStream(boost::asio::io_context& ioc, const std::string& endPointFile, ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
     LocalClientStream(const LocalClientStream&) = delete;
     LocalClientStream& operator= (LocalClientStream&) = delete;
 
@@ -25,7 +25,7 @@
 namespace daq::stream {
     class LocalServerStream : public LocalStream {
     public:
-        LocalServerStream(boost::asio::local::stream_protocol::socket&& socket);
+        LocalServerStream(boost::asio::local::stream_protocol::socket&& socket, ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
         LocalServerStream(const LocalServerStream&) = delete;
         LocalServerStream& operator= (LocalServerStream&) = delete;
 
@@ -25,14 +25,12 @@
 namespace daq::stream {
     class LocalStream : public Stream {
     public:
-        LocalStream(boost::asio::io_context& ioc);
-        LocalStream(boost::asio::local::stream_protocol::socket&& socket);
+        LocalStream(boost::asio::io_context& ioc, ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
+        LocalStream(boost::asio::local::stream_protocol::socket&& socket, ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
         LocalStream(const LocalStream&) = delete;
         LocalStream& operator= (LocalStream&) = delete;
         
         
-        void asyncWrite(const boost::asio::const_buffer& data, WriteCompletionCb writeCompletionCb) override;
-        void asyncWrite(const ConstBufferVector& data, WriteCompletionCb writeCompletionCb) override;
         size_t write(const boost::asio::const_buffer& data, boost::system::error_code& ec) override;
         size_t write(const ConstBufferVector& data, boost::system::error_code& ec) override;
 
@@ -41,7 +39,11 @@ namespace daq::stream {
 
     protected:
         void asyncReadAtLeast(std::size_t bytesToRead, ReadCompletionCb readAtLeastCb) override;
+        void asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb) override;
         size_t readAtLeast(std::size_t bytesToRead, boost::system::error_code &ec) override;
+        void asyncWaitTransportReadable(CompletionCb waitCb) override;
+        size_t readSomeInto(const boost::asio::mutable_buffer& buffer, boost::system::error_code& ec) override;
+        void asyncReadAllInto(const MutableBufferView& buffers, ReadCompletionCb readCb) override;
 
         boost::asio::local::stream_protocol::socket m_socket;
     };
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+#include <boost/asio/io_context.hpp>
+
+#include "stream/WebsocketClientStream.hpp"
+
+namespace daq::stream {
+/// Websocket client connecting to a LocalWebsocketServer by an abstract Unix domain socket.
+/// Apart from the connection, it is the same as WebsocketClientStream.
+class LocalWebsocketClientStream : public WebsocketClientStream
+{
+public:
+    /// @param endPointFile Name of the abstract socket the server listens to
+    /// @param path Used to reach serveral services behind the same socket. Must be at least "/".
+    /// @param receiveBufferType Memory used for buffering received data
+    explicit LocalWebsocketClientStream(boost::asio::io_context& ioc, const std::string& endPointFile, const std::string& path = "/", ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
+    LocalWebsocketClientStream(const LocalWebsocketClientStream&) = delete;
+    LocalWebsocketClientStream& operator= (LocalWebsocketClientStream&) = delete;
+
+    /// Connect and upgrade to websocket
+    void asyncInit(CompletionCb completionCb) override;
+    boost::system::error_code init() override;
+
+    std::string endPointUrl() const override;
+    std::string remoteHost() const override;
+
+private:
+    Endpoints endpoints() const;
+
+    std::string m_endpointFile;
+};
+}
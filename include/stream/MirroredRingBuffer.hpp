@@ -0,0 +1,60 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "stream/ReceiveBuffer.hpp"
+
+namespace daq::stream {
+    /// Ring buffer whose memory is mapped twice into consecutive virtual memory.
+    ///
+    /// Because the second mapping continues where the first one ends, readable data and prepared memory are contiguous,
+    /// even when they wrap around the end of the ring. Consuming and committing only move offsets, data is never moved.
+    /// The ring is reallocated with a bigger capacity only if prepare() requests more memory than is free.
+    class MirroredRingBuffer : public ReceiveBuffer {
+    public:
+        static const size_t DefaultCapacity;
+
+        /// \param capacity Rounded up to a multiple of the page size
+        /// \throw boost::system::system_error if the memory could not be mapped
+        explicit MirroredRingBuffer(size_t capacity = DefaultCapacity);
+        MirroredRingBuffer(const MirroredRingBuffer&) = delete;
+        MirroredRingBuffer& operator= (const MirroredRingBuffer&) = delete;
+        ~MirroredRingBuffer();
+
+        size_t size() const override;
+        size_t capacity() const override;
+        size_t maxSize() const override;
+        const uint8_t* data() const override;
+
+        boost::asio::mutable_buffer prepare(size_t size) override;
+        void commit(size_t size) override;
+        void consume(size_t size) override;
+
+    private:
+        /// \return Start address of the two mappings. Each of them has the given capacity.
+        static uint8_t* map(size_t capacity);
+        static void unmap(uint8_t* memory, size_t capacity);
+        void grow(size_t requiredCapacity);
+
+        uint8_t* m_memory;
+        size_t m_capacity;
+        /// Offset of the readable data within the first mapping
+        size_t m_readPos;
+        size_t m_size;
+        size_t m_prepared;
+    };
+}
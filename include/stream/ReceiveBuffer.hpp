@@ -0,0 +1,248 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "stream/BufferPool.hpp"
+
+namespace daq::stream {
+    /// Selects the memory used by a stream to keep received but not yet consumed data.
+    enum class ReceiveBufferType {
+        /// boost::asio::streambuf. Making room for new data might move the unread data to the front of the buffer.
+        Streambuf,
+        /// Ring buffer mapped twice into consecutive virtual memory. Received data is never moved.
+        /// Not available on Windows, ReceiveBufferType::Streambuf is used instead.
+        MirroredRing,
+        /// Chunks taken from a BufferPool. Received data can be detached without copying.
+        Pooled
+    };
+
+    /// Controls how much memory is prepared in the receive buffer for a single read from the transport.
+    struct ReadSizePolicy {
+        /// Smallest amount of memory prepared for a single read
+        size_t minReadSize = 512;
+        /// Largest amount of memory prepared for a single read
+        size_t maxReadSize = 65536;
+        /// false: Prepare minReadSize or all free memory of the receive buffer if there is more, limited by maxReadSize.
+        /// true: Start with minReadSize. Double the size while reads fill the prepared memory,
+        /// halve it when reads return less than a quarter of it. Stays within minReadSize and maxReadSize.
+        bool adaptive = false;
+    };
+
+    /// Applies a ReadSizePolicy and keeps track of the current read size of the adaptive mode.
+    class ReadSizer {
+    public:
+        ReadSizer();
+
+        void setPolicy(const ReadSizePolicy& policy);
+        const ReadSizePolicy& policy() const;
+
+        /// \param freeCapacity Memory available in the receive buffer without allocating
+        /// \return Amount of memory to prepare for the next read
+        size_t nextReadSize(size_t freeCapacity) const;
+        /// \return Largest amount to be read by a single read operation
+        size_t maxReadSize() const;
+        /// Limit the read size below the policy, e.g. to the budget of a rate limit.
+        /// Pass std::numeric_limits<size_t>::max() to remove the limit.
+        void setLimit(size_t limit);
+
+        /// Memory of the given size got prepared for a read
+        void onPrepare(size_t prepared);
+        /// A read returned the given amount of data into the memory prepared before
+        void onCommit(size_t bytesRead);
+
+    private:
+        ReadSizePolicy m_policy;
+        size_t m_currentReadSize;
+        size_t m_prepared;
+        size_t m_limit;
+    };
+
+    /// Memory holding received data until it gets consumed.
+    /// Readable data is always one contiguous memory area.
+    class ReceiveBuffer {
+    public:
+        virtual ~ReceiveBuffer() = default;
+
+        /// \return Amount of readable data
+        virtual size_t size() const = 0;
+        /// \return Amount of data that can be held without allocating more memory
+        virtual size_t capacity() const = 0;
+        virtual size_t maxSize() const = 0;
+        /// \return Start of the readable data
+        virtual const uint8_t* data() const = 0;
+
+        /// \return Writable memory of the requested size located directly behind the readable data
+        virtual boost::asio::mutable_buffer prepare(size_t size) = 0;
+        /// Make size bytes of the prepared memory readable
+        virtual void commit(size_t size) = 0;
+        /// Remove size bytes from the beginning of the readable data.
+        /// If there is not enough data available, the amount of available data is consumed
+        virtual void consume(size_t size) = 0;
+
+        /// Hand over size bytes from the beginning of the readable data and consume them.
+        /// The default implementation copies the data into newly allocated memory.
+        /// If there is not enough data available, the amount of available data is detached
+        virtual BufferSlice detach(size_t size);
+    };
+
+    /// Backend wrapping a boost::asio::streambuf
+    class StreambufReceiveBuffer : public ReceiveBuffer {
+    public:
+        explicit StreambufReceiveBuffer(boost::asio::streambuf& streambuf);
+
+        size_t size() const override;
+        size_t capacity() const override;
+        size_t maxSize() const override;
+        const uint8_t* data() const override;
+
+        boost::asio::mutable_buffer prepare(size_t size) override;
+        void commit(size_t size) override;
+        void consume(size_t size) override;
+
+    private:
+        boost::asio::streambuf& m_streambuf;
+    };
+
+    /// Backend receiving into chunks of a BufferPool.
+    ///
+    /// Detaching hands out a reference to the current chunk instead of a copy.
+    /// Once a slice got detached from a chunk, it is not written at or before the detached data anymore, even after the slice got released.
+    /// When it is full, the stream continues with a fresh chunk from the pool. Only unread data is copied into it, usually an incomplete frame.
+    /// Chunks released by other threads are reused only after going through the pool, which synchronizes the handover.
+    class PooledReceiveBuffer : public ReceiveBuffer {
+    public:
+        explicit PooledReceiveBuffer(BufferPoolSharedPtr pool);
+
+        /// Continue with chunks of another pool, e.g. one shared by several streams. Unread data is copied over.
+        void setPool(BufferPoolSharedPtr pool);
+
+        size_t size() const override;
+        size_t capacity() const override;
+        size_t maxSize() const override;
+        const uint8_t* data() const override;
+
+        boost::asio::mutable_buffer prepare(size_t size) override;
+        void commit(size_t size) override;
+        void consume(size_t size) override;
+        BufferSlice detach(size_t size) override;
+
+    private:
+        /// Move the readable data into memory with room for the requested amount of data behind it
+        void makeRoom(size_t size);
+        /// Copy the readable data into a fresh chunk of the pool with room for the requested amount of data behind it
+        void changeChunk(size_t size);
+
+        BufferPoolSharedPtr m_pool;
+        std::shared_ptr < uint8_t > m_chunk;
+        size_t m_chunkSize;
+        size_t m_readPos;
+        size_t m_size;
+        size_t m_prepared;
+        /// A slice of the current chunk got detached. It is never rewound nor moved, released or not.
+        bool m_detached;
+    };
+
+    /// Makes a ReceiveBuffer usable as dynamic buffer (DynamicBuffer_v1) for boost::asio::async_read and boost::asio::read.
+    /// Cheap to copy, it only refers to the receive buffer.
+    ///
+    /// asio prepares as much memory as capacity() reports to be free. Hence capacity() includes the read size chosen by the ReadSizer.
+    /// Use together with ReadAtLeast as completion condition, which limits the size of a single read.
+    /// Websocket streams pass it to Beast directly, see asyncWebsocketReadAtLeast.
+    class ReceiveBufferRef {
+    public:
+        using const_buffers_type = boost::asio::const_buffer;
+        using mutable_buffers_type = boost::asio::mutable_buffer;
+
+        ReceiveBufferRef(ReceiveBuffer& receiveBuffer, ReadSizer& readSizer)
+            : m_receiveBuffer(receiveBuffer)
+            , m_readSizer(readSizer)
+        {
+        }
+
+        size_t size() const
+        {
+            return m_receiveBuffer.size();
+        }
+
+        size_t max_size() const
+        {
+            return m_receiveBuffer.maxSize();
+        }
+
+        size_t capacity() const
+        {
+            size_t size = m_receiveBuffer.size();
+            return size + m_readSizer.nextReadSize(m_receiveBuffer.capacity() - size);
+        }
+
+        const_buffers_type data() const
+        {
+            return const_buffers_type(m_receiveBuffer.data(), m_receiveBuffer.size());
+        }
+
+        mutable_buffers_type prepare(size_t size)
+        {
+            m_readSizer.onPrepare(size);
+            return m_receiveBuffer.prepare(size);
+        }
+
+        void commit(size_t size)
+        {
+            m_readSizer.onCommit(size);
+            m_receiveBuffer.commit(size);
+        }
+
+        void consume(size_t size)
+        {
+            m_receiveBuffer.consume(size);
+        }
+
+    private:
+        ReceiveBuffer& m_receiveBuffer;
+        ReadSizer& m_readSizer;
+    };
+
+    /// Completion condition for boost::asio::async_read and boost::asio::read.
+    /// Like boost::asio::transfer_at_least but the size of a single read is limited by the ReadSizer instead of a fixed 64KiB.
+    class ReadAtLeast {
+    public:
+        ReadAtLeast(size_t bytesToRead, const ReadSizer& readSizer)
+            : m_bytesToRead(bytesToRead)
+            , m_readSizer(readSizer)
+        {
+        }
+
+        size_t operator()(const boost::system::error_code& ec, size_t bytesTransferred) const
+        {
+            if (ec || bytesTransferred >= m_bytesToRead) {
+                return 0;
+            }
+            return m_readSizer.maxReadSize();
+        }
+
+    private:
+        size_t m_bytesToRead;
+        const ReadSizer& m_readSizer;
+    };
+}
@@ -16,8 +16,11 @@
 
 #pragma once
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
+#include "stream/EgressScheduler.hpp"
 #include "stream/Stream.hpp"
 
 namespace daq::stream {
@@ -30,16 +33,122 @@ namespace daq::stream {
         virtual int start() = 0;
         virtual void stop() = 0;
 
+        /// Share the uplink between the streams of this server. Applies to streams accepted afterwards.
+        /// Per stream weights are set with EgressScheduler::setWeight(), e.g. from NewStreamCb.
+        void setEgressScheduler(EgressSchedulerSharedPtr egressScheduler)
+        {
+            m_egressScheduler = std::move(egressScheduler);
+        }
+
+        const EgressSchedulerSharedPtr& egressScheduler() const
+        {
+            return m_egressScheduler;
+        }
+
+        /// Memory used by streams accepted afterwards for buffering received data. Default is ReceiveBufferType::Streambuf.
+        void setReceiveBufferType(ReceiveBufferType receiveBufferType)
+        {
+            m_receiveBufferType = receiveBufferType;
+        }
+
+        ReceiveBufferType receiveBufferType() const
+        {
+            return m_receiveBufferType;
+        }
+
+        /// Pool shared by the streams accepted afterwards if they use ReceiveBufferType::Pooled, see Stream::setReceiveBufferPool().
+        /// nullptr (default): Each stream has a pool of its own
+        void setReceiveBufferPool(BufferPoolSharedPtr receiveBufferPool)
+        {
+            m_receiveBufferPool = std::move(receiveBufferPool);
+        }
+
+        const BufferPoolSharedPtr& receiveBufferPool() const
+        {
+            return m_receiveBufferPool;
+        }
+
+        /// true: stop() closes all streams created by this server that are still alive. Default is false, streams outlive the server.
+        /// Streams are closed asynchronously by Stream::asyncClose(), all at once. They are kept alive until their close completed.
+        void setCloseStreamsOnStop(bool closeStreamsOnStop)
+        {
+            m_closeStreamsOnStop = closeStreamsOnStop;
+        }
+
+        bool closeStreamsOnStop() const
+        {
+            return m_closeStreamsOnStop;
+        }
+
+        /// \return Streams created by this server that are still alive
+        std::vector < StreamSharedPtr > streams() const
+        {
+            std::vector < StreamSharedPtr > streams;
+            for (const auto& weakStream : m_streams) {
+                if (auto stream = weakStream.lock()) {
+                    streams.push_back(stream);
+                }
+            }
+            return streams;
+        }
+
+        /// Close all streams created by this server that are still alive, without waiting for completion
+        void closeStreams()
+        {
+            for (const auto& stream : streams()) {
+                stream->asyncClose([stream](const boost::system::error_code&)
+                {
+                });
+            }
+            m_streams.clear();
+        }
+
     protected:
 
         /// \param NewStreamCb callback function to be executed for each succesfully created worker.
         Server(NewStreamCb newStreamCb)
             : m_newStreamCb(newStreamCb)
+            , m_receiveBufferType(ReceiveBufferType::Streambuf)
+            , m_closeStreamsOnStop(false)
+            , m_pruneThreshold(MinPruneThreshold)
+        {
+        }
+
+        /// Keep track of a stream created by the server, without keeping it alive
+        void addStream(const StreamSharedPtr& stream)
         {
+            if (m_streams.size() >= m_pruneThreshold) {
+                // amortized removal of the streams gone meanwhile
+                std::vector < std::weak_ptr < Stream > > liveStreams;
+                for (auto& weakStream : m_streams) {
+                    if (!weakStream.expired()) {
+                        liveStreams.push_back(std::move(weakStream));
+                    }
+                }
+                m_streams = std::move(liveStreams);
+                m_pruneThreshold = std::max(MinPruneThreshold, 2 * m_streams.size());
+            }
+            m_streams.push_back(stream);
+        }
+
+        /// To be called by stop() of derived classes
+        void onStop()
+        {
+            if (m_closeStreamsOnStop) {
+                closeStreams();
+            }
         }
 
         NewStreamCb m_newStreamCb;
+        EgressSchedulerSharedPtr m_egressScheduler;
 
     private:
+        static constexpr size_t MinPruneThreshold = 16;
+
+        ReceiveBufferType m_receiveBufferType;
+        BufferPoolSharedPtr m_receiveBufferPool;
+        bool m_closeStreamsOnStop;
+        std::vector < std::weak_ptr < Stream > > m_streams;
+        size_t m_pruneThreshold;
     };
 }
@@ -16,14 +16,26 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include <boost/asio/io_context.hpp>
 #include <boost/asio/streambuf.hpp>
 #include <boost/system/error_code.hpp>
 
+#include "stream/BufferSequenceView.hpp"
+#include "stream/EgressScheduler.hpp"
+#include "stream/HandlerMemory.hpp"
+#include "stream/ReceiveBuffer.hpp"
+#include "stream/WriteQueue.hpp"
+#include "stream/UniqueFunction.hpp"
+
 
 namespace daq::stream {
     using ConstBufferVector = std::vector <boost::asio::const_buffer>;
+    using MutableBufferVector = std::vector <boost::asio::mutable_buffer>;
 
     class Stream;
     using StreamSharedPtr = std::shared_ptr <Stream>;
@@ -39,12 +51,34 @@ namespace daq::stream {
     class Stream
     {
     public:
+        // Completion callbacks are move-only. Small callables are stored without allocating memory, see UniqueFunction.
         /// @param bytesRead Number of bytes acually read. Might be bigger than requested.
-        using ReadCompletionCb = std::function <void (const boost::system::error_code& ec, std::size_t bytesRead) >;
-        using WriteCompletionCb = std::function <void (const boost::system::error_code& ec, std::size_t bytesWritten) >;
-        using CompletionCb = std::function <void (const boost::system::error_code& ec) >;
+        using ReadCompletionCb = UniqueFunction <void (const boost::system::error_code& ec, std::size_t bytesRead) >;
+        using WriteCompletionCb = UniqueFunction <void (const boost::system::error_code& ec, std::size_t bytesWritten) >;
+        using CompletionCb = UniqueFunction <void (const boost::system::error_code& ec) >;
+        /// @param data Start of a frame
+        /// @param size Amount of data available from data on. Might contain several frames or only part of a frame.
+        /// \return Length of the frame including its header. 0 if not enough data is available to tell.
+        /// Stream::InvalidFrameLength if the frame is malformed.
+        using FrameLengthExtractor = UniqueFunction <size_t (const uint8_t* data, std::size_t size) >;
+        /// @param frames Views of all complete frames. Only valid during the callback.
+        using FramesCompletionCb = UniqueFunction <void (const boost::system::error_code& ec, const ConstBufferView& frames) >;
+        /// @param message View of one complete message. Only valid during the callback.
+        /// @param binary false for a text message
+        using MessageCompletionCb = UniqueFunction <void (const boost::system::error_code& ec, const ConstBufferView& message, bool binary) >;
+
+        /// @param queuedBytes Bytes of all pending writes at the time of the crossing
+        using WatermarkCb = std::function < void(std::size_t queuedBytes) >;
+
+        /// Returned by a FrameLengthExtractor for a malformed frame
+        static const std::size_t InvalidFrameLength;
 
-        virtual ~Stream() = default;
+        /// \param receiveBufferType Memory used for buffering received data
+        /// \throw boost::system::system_error if the receive buffer could not be created
+        explicit Stream(ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
+        Stream(const Stream&) = delete;
+        Stream& operator= (const Stream&) = delete;
+        virtual ~Stream();
 
         /// Initialize depending on the kind of stream
         /// @param CompletionCb Executed after completion to start reading/writing data
@@ -60,6 +94,7 @@ namespace daq::stream {
         /// A receive buffer is used that allows to read more data than requested. Additional data being read is kept for the next read request.
         /// @warning If the requested amount of data is already available, callback function is executed directly in the same context.
         /// When having lots of data in the buffer, containing lots of small packages, we might have lots of method calls resulting in a very deep stack.
+        /// Use setMaxInlineDepth() to limit the stack depth.
         /// @param readCb Processing callback to be executed upon data availability
         void asyncRead(CompletionCb readCb, std::size_t size);
         boost::system::error_code read(std::size_t size);
@@ -67,10 +102,106 @@ namespace daq::stream {
         /// If there is data remaining in the buffer, readCb is called directly. Otherwise an asynchronous read of at least one byte is started.
         void asyncReadSome(ReadCompletionCb readCb);
         size_t readSome(boost::system::error_code& ec);
-        virtual void asyncWrite(const boost::asio::const_buffer& dataBuffer, WriteCompletionCb writeCompletionCb) = 0;
+
+        /// Wait until data can be read without blocking. Use readInto() to fetch it.
+        /// If there is data remaining in the buffer, waitCb is called directly.
+        /// Supported by TCP, Unix Domain socket and file streams, others complete with boost::asio::error::operation_not_supported.
+        void asyncWaitReadable(CompletionCb waitCb);
+        /// Read directly into the memory of the caller without passing the receive buffer.
+        /// Data remaining in the buffer is returned first to keep the order. Only if the buffer is empty, the transport is read.
+        /// Like read_some, this returns at least one byte and blocks if nothing is available. Call it after asyncWaitReadable() to not block.
+        /// \return Number of bytes written to buffer
+        size_t readInto(const boost::asio::mutable_buffer& buffer, boost::system::error_code& ec);
+
+        /// Request all complete frames available. On completion, callback function is executed once for all of them.
+        /// If there is no complete frame available, reads until there is at least one.
+        /// The frames are consumed in one step after framesCb returned. Do not consume them within framesCb.
+        /// Calling asyncReadFrames() from within framesCb is executed after the frames got consumed, it does not nest callbacks.
+        /// @param frameLengthExtractor Tells the length of the frame at the beginning of the data, see fixedFrameLength() for frames of fixed size
+        /// @param framesCb Executed with views of the frames. On error, no frames are provided.
+        /// Frames before a malformed frame are delivered. Requesting frames with a malformed frame at the beginning completes with boost::asio::error::message_size.
+        void asyncReadFrames(FrameLengthExtractor frameLengthExtractor, FramesCompletionCb framesCb);
+        /// \return Extractor for asyncReadFrames() with frames of fixed size
+        static FrameLengthExtractor fixedFrameLength(std::size_t frameSize);
+
+        /// Read one complete message of a message oriented transport, keeping the boundaries the transport framed.
+        /// Supported by websocket streams, others complete with boost::asio::error::operation_not_supported.
+        /// The message is consumed after messageCb returned. Calling asyncReadMessage() from within messageCb is executed afterwards, it does not nest.
+        /// Do not mix with byte oriented reads. If the receive buffer is not empty, messageCb completes with boost::asio::error::invalid_argument.
+        void asyncReadMessage(MessageCompletionCb messageCb);
+
+        /// Fill all buffers of a scatter list, i.e. a number of preallocated fixed size records.
+        /// Data remaining in the receive buffer is copied first, the rest is read directly into the buffers by as few system calls as possible.
+        /// Websocket streams read into the receive buffer and copy from there because of the websocket framing.
+        /// If the data is already available, readCb is called directly.
+        /// @param buffers Copied, the memory they refer to has to stay valid until readCb is executed.
+        /// @param readCb Executed when all buffers are filled. bytesRead is the total number of bytes written to the buffers.
+        void asyncReadInto(const MutableBufferVector& buffers, ReadCompletionCb readCb);
+
+        /// Any number of writes may be pending. They are queued and sent in the order they were requested.
+        /// While a write is in progress, the queued ones are combined into a single gather write within the limits of setWriteQueueOptions().
+        /// Message oriented streams like websocket streams do not combine writes, each write is sent as a message of its own.
+        /// Each writeCompletionCb is executed with the size of its own data. If the transport fails, all queued writes complete with the error.
+        /// The data has to stay valid until writeCompletionCb is executed.
+        void asyncWrite(const boost::asio::const_buffer& dataBuffer, WriteCompletionCb writeCompletionCb);
         /// Sending a sequence of buffers is usefull to avoid copying parts into one memory area before sending.
-        virtual void asyncWrite(const ConstBufferVector& data, WriteCompletionCb writeCompletionCb) = 0;
+        /// The sequence is copied.
+        void asyncWrite(const ConstBufferVector& data, WriteCompletionCb writeCompletionCb);
+        /// Like asyncWrite() with a sequence of buffers but the sequence is not copied.
+        /// Besides the data, the buffers referred to by the view have to stay valid until writeCompletionCb is executed.
+        void asyncWriteBuffers(const ConstBufferView& data, WriteCompletionCb writeCompletionCb);
+
+        /// Write a small header in front of the data, i.e. the length of a message. Both are sent by one gather write.
+        /// The header is copied into the write queue, the data is not copied. Neither allocates memory.
+        /// A header bigger than WriteQueue::MaxPrefixSize completes with boost::asio::error::invalid_argument.
+        /// @param writeCompletionCb bytesWritten includes the header
+        void asyncWritePrefixed(const boost::asio::const_buffer& header, const boost::asio::const_buffer& dataBuffer, WriteCompletionCb writeCompletionCb);
+
+        /// Write that may be replaced by a newer one with the same key while it is queued, see WriteOverflowPolicy::KeepLatestPerKey.
+        /// With other policies, this is a plain asyncWrite().
+        void asyncWriteKeyed(uint64_t key, const boost::asio::const_buffer& dataBuffer, WriteCompletionCb writeCompletionCb);
 
+        /// Queued like asyncWrite() but never combined with other writes nor chunked. Websocket streams send it as one message of the given kind.
+        /// Byte oriented streams send the data without any framing.
+        /// The buffer is stored in the write queue, no memory is allocated.
+        /// @param binary false for a text message
+        void asyncWriteMessage(const boost::asio::const_buffer& dataBuffer, bool binary, WriteCompletionCb writeCompletionCb);
+        /// The sequence is copied
+        void asyncWriteMessage(const ConstBufferVector& data, bool binary, WriteCompletionCb writeCompletionCb);
+
+        /// Write queued in the lane of the given priority. Writes of a higher priority are sent before those of lower priorities,
+        /// between the chunks of a big write if WriteQueueOptions::interleaveChunks is set. Within a lane, the order is kept.
+        /// asyncWrite() uses priority 0. Priorities beyond WriteQueueOptions::priorityLanes use the highest lane.
+        void asyncWritePriority(size_t priority, const boost::asio::const_buffer& dataBuffer, WriteCompletionCb writeCompletionCb);
+        void asyncWritePriority(size_t priority, const ConstBufferVector& data, WriteCompletionCb writeCompletionCb);
+
+        /// Limits for queueing and combining writes. Limits for combining take effect with the next gather write.
+        /// Writes dropped by the overflow policy complete with boost::asio::error::no_buffer_space.
+        void setWriteQueueOptions(const WriteQueueOptions& options);
+        const WriteQueueOptions& writeQueueOptions() const;
+
+        /// \return Bytes of all pending asynchronous writes, including the ones being sent
+        size_t queuedBytes() const;
+        /// Get notified when pending writes pile up because the remote side does not read fast enough.
+        /// highWatermarkCb is executed by asyncWrite() when queuedBytes() reaches highWatermark.
+        /// Afterwards lowWatermarkCb is executed as soon as completed writes bring queuedBytes() down to lowWatermark, then the high watermark is armed again.
+        /// The notifications do not reject writes, pausing is up to the producer. Writes are dropped only by the overflow policy, see setWriteQueueOptions().
+        /// @param highWatermark 0 disables the notifications
+        /// @param lowWatermark Limited to highWatermark
+        void setWriteWatermarks(size_t highWatermark, size_t lowWatermark, WatermarkCb highWatermarkCb, WatermarkCb lowWatermarkCb);
+        /// \return true after reaching the high watermark until dropping to the low watermark
+        bool aboveHighWatermark() const;
+        /// \return Number of writes dropped by the overflow policy
+        uint64_t droppedWrites() const;
+        /// \return Bytes of the writes dropped by the overflow policy
+        uint64_t droppedBytes() const;
+
+        /// Take turns with the other streams using the scheduler instead of writing whenever data is queued, see EgressScheduler.
+        /// Servers attach their scheduler to all accepted streams. nullptr detaches.
+        void setEgressScheduler(EgressSchedulerSharedPtr egressScheduler);
+        const EgressSchedulerSharedPtr& egressScheduler() const;
+
+        /// Blocking writes bypass the write queue. Do not mix them with pending asynchronous writes.
         virtual size_t write(const boost::asio::const_buffer& data, boost::system::error_code& ec) = 0;
         virtual size_t write(const ConstBufferVector& data, boost::system::error_code& ec) = 0;
 
@@ -90,12 +221,223 @@ namespace daq::stream {
         /// @warning No check whether enough is available
         void copyDataAndConsume(void* dest, size_t size);
 
+        /// Hands over available data and consumes it. The returned slice stays valid after further reads.
+        /// With ReceiveBufferType::Pooled the data is not copied, otherwise it is copied into new memory.
+        /// If there is not enough data available, the amount of available data is detached
+        BufferSlice detach(size_t size);
+        /// With ReceiveBufferType::Pooled, receive into chunks of the given pool instead of a private one, e.g. a pool shared by all streams of a server.
+        /// Buffered data is copied over. Ignored by other receive buffer types.
+        void setReceiveBufferPool(BufferPoolSharedPtr pool);
+
+        /// Limits the nesting of callbacks executed directly by asyncRead() and asyncReadSome() when the data is already buffered.
+        /// A read requested from a callback at the maximum depth does not execute its callback directly.
+        /// It is executed after the outermost callback returned, by a loop of the outermost asyncRead() or asyncReadSome() call.
+        /// @param maxInlineDepth 0: Unlimited, callbacks are always executed directly (default)
+        void setMaxInlineDepth(size_t maxInlineDepth);
+        size_t maxInlineDepth() const;
+
+        /// Controls how much memory is prepared for a single read from the transport.
+        /// Bigger reads need fewer system calls to drain a backlog but need more memory.
+        void setReadSizePolicy(const ReadSizePolicy& readSizePolicy);
+        const ReadSizePolicy& readSizePolicy() const;
+
+        /// Limit the rate of asynchronous reads from the transport by a token bucket.
+        /// A transport read starts when the budget covers the missing data or ReadSizePolicy::minReadSize, at most the burst.
+        /// Neither the data waited for nor a single read exceed the budget, larger reads are split. The bytes read are charged when the read completes.
+        /// asyncReadInto() reads through the receive buffer while limited. Synchronous reads are not limited.
+        /// \param bytesPerSecond 0 removes the limit
+        /// \param burstBytes Budget collected while idle. 0 allows one second worth of bytes.
+        void setReadRateLimit(boost::asio::io_context& ioContext, uint64_t bytesPerSecond, size_t burstBytes = 0);
+        /// Limit the rate of queued writes by a token bucket. A gather write starts when budget is available and is charged right away.
+        /// Set WriteQueueOptions::maxChunkSize to keep single writes small compared to the rate. Synchronous writes are not limited.
+        /// \param bytesPerSecond 0 removes the limit
+        /// \param burstBytes Budget collected while idle. 0 allows one second worth of bytes.
+        void setWriteRateLimit(boost::asio::io_context& ioContext, uint64_t bytesPerSecond, size_t burstBytes = 0);
+
     protected:
         virtual void asyncReadAtLeast(std::size_t bytesToRead, ReadCompletionCb readCompletionCb) = 0;
         virtual size_t readAtLeast(std::size_t bytesToRead, boost::system::error_code &ec) = 0;
+        /// Transport specific part of asyncWaitReadable(). Default completes with boost::asio::error::operation_not_supported.
+        virtual void asyncWaitTransportReadable(CompletionCb waitCb);
+        /// Transport specific part of readInto(). Default fails with boost::asio::error::operation_not_supported.
+        virtual size_t readSomeInto(const boost::asio::mutable_buffer& buffer, boost::system::error_code& ec);
+        /// Transport specific part of asyncReadInto(). Fills all buffers.
+        /// Default reads into the receive buffer using asyncRead() and copies from there.
+        virtual void asyncReadAllInto(const MutableBufferView& buffers, ReadCompletionCb readCb);
+
+        /// Write all data to the transport. Only one transport write is in progress at a time.
+        /// @param data Refers to memory of the stream, valid until writeCompletionCb is executed
+        virtual void asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb) = 0;
+
+        /// \return true while asyncWriteTransport() sends a text message, see asyncWriteMessage()
+        bool writingText() const;
+
+        /// Transport specific part of asyncReadMessage(). Appends one complete message to the receive buffer.
+        /// Default completes with boost::asio::error::operation_not_supported.
+        /// @param readCb bytesRead is the size of the message
+        virtual void asyncReadMessageTransport(ReadCompletionCb readCb);
+        /// \return true if the message read last is binary
+        virtual bool messageBinary() const;
+        /// \return true if each transport write is received as a message of its own, i.e. by websocket streams.
+        /// Queued writes are not combined then. Default is false.
+        virtual bool messageOriented() const;
+
+        /// \return Handler for asio whose operation is allocated from memory of the stream reserved for reading
+        template < class Handler >
+        MemoryBoundHandler < Handler > readHandler(Handler&& handler)
+        {
+            return MemoryBoundHandler < Handler >(m_readHandlerMemory, std::forward < Handler >(handler));
+        }
+
+        /// \return Handler for asio whose operation is allocated from memory of the stream reserved for writing
+        template < class Handler >
+        MemoryBoundHandler < Handler > writeHandler(Handler&& handler)
+        {
+            return MemoryBoundHandler < Handler >(m_writeHandlerMemory, std::forward < Handler >(handler));
+        }
+
+        /// \return The receive buffer as dynamic buffer to be passed to boost::asio::async_read and boost::asio::read
+        ReceiveBufferRef receiveBuffer();
+        /// \return Completion condition for boost::asio::async_read and boost::asio::read applying the read size policy
+        ReadAtLeast transferAtLeast(std::size_t bytesToRead) const;
+        /// \return Largest amount to be read by a single read from the transport according to the read size policy
+        size_t maxReadSize() const;
 
         /// will be called upon completion of asyncInit
         CompletionCb m_initCompletionCb;
+        /// Used as receive buffer when having ReceiveBufferType::Streambuf
         boost::asio::streambuf m_buffer;
+
+    private:
+        friend class EgressScheduler;
+
+        /// A read request with buffered data, executed by the loop in runDeferredReads()
+        struct DeferredRead {
+            CompletionCb readCb;
+            std::size_t size = 0;
+            ReadCompletionCb readSomeCb;
+        };
+
+        /// Held while executing user callbacks, tells whether one of them destroyed the stream.
+        /// Guards nest, the destructor of the stream flags all of them.
+        struct DestructionGuard {
+            explicit DestructionGuard(Stream& stream);
+            ~DestructionGuard();
+
+            Stream& stream;
+            DestructionGuard* outer;
+            bool destroyed;
+        };
+
+        /// \return true if a callback may be executed directly, false if it has to be deferred
+        bool enterInline();
+        void leaveInline();
+        void runDeferredReads();
+
+        ReceiveBufferType m_receiveBufferType;
+        std::unique_ptr < ReceiveBuffer > m_receiveBuffer;
+        ReadSizer m_readSizer;
+        HandlerMemorySharedPtr m_readHandlerMemory;
+        HandlerMemorySharedPtr m_writeHandlerMemory;
+        size_t m_maxInlineDepth;
+        size_t m_inlineDepth;
+        bool m_runningDeferredReads;
+        DeferredRead m_deferredRead;
+        /// Callback of asyncRead() waiting for the transport
+        CompletionCb m_readCb;
+        /// Buffers of asyncReadInto() still to be filled
+        MutableBufferVector m_readIntoBuffers;
+
+        /// Token bucket and the timer waiting for its budget
+        struct RateLimiter;
+        using RateLimiterSharedPtr = std::shared_ptr < RateLimiter >;
+        static void setRateLimit(RateLimiterSharedPtr& rateLimiter, boost::asio::io_context& ioContext, uint64_t bytesPerSecond, size_t burstBytes);
+        /// Execute continuation once the budget of rateLimiter is available or reaches bytes
+        void waitForBudget(const RateLimiterSharedPtr& rateLimiter, void (Stream::*continuation)(), size_t bytes = 0);
+        /// asyncReadAtLeast() respecting the read rate limit
+        void readTransport(std::size_t bytesToRead, ReadCompletionCb readCb);
+        void startLimitedRead();
+
+        RateLimiterSharedPtr m_readRateLimiter;
+        RateLimiterSharedPtr m_writeRateLimiter;
+        /// Transport read waiting for or using the read budget.
+        /// It is split into reads fitting the budget available at their start.
+        std::size_t m_limitedReadSize;
+        std::size_t m_limitedBytesRead;
+        ReadCompletionCb m_limitedReadCb;
+
+        /// Apply the overflow policy and queue a write
+        template < class Data >
+        void queueWrite(size_t priority, const Data& data, WriteCompletionCb writeCompletionCb);
+        /// Apply the overflow policy and queue a message
+        template < class Data >
+        void queueMessage(const Data& data, bool binary, WriteCompletionCb writeCompletionCb);
+        WriteQueue& writeLane(size_t priority);
+        /// \return Position of the first write of the lane that may be dropped
+        size_t firstDroppable(size_t lane) const;
+        /// Make room for a new write according to the overflow policy
+        /// \return false if the new write is to be dropped
+        bool admitWrite(size_t bytes);
+        /// Check the high watermark and start sending if the transport is idle
+        void onWriteQueued();
+        /// Count a write dropped by the overflow policy, its completion is deferred to completeDroppedWrites()
+        void dropWrite(WriteCompletionCb writeCompletionCb, size_t bytes);
+        /// Execute the completion callbacks of the dropped writes, after the write queue got updated
+        /// \return false if a callback destroyed the stream
+        bool completeDroppedWrites();
+        /// Drop the queued write at the given position
+        void dropQueuedWrite(size_t lane, size_t position);
+        /// Start a gather write now or when the egress scheduler grants the turn
+        void requestWrite();
+        /// Start a gather write of the queued writes
+        /// \return Number of bytes being sent
+        size_t startWrite();
+        void onWritten(const boost::system::error_code& ec, std::size_t bytesWritten);
+
+        /// One queue per priority, the lowest priority first
+        std::vector < WriteQueue > m_writeLanes;
+        WriteQueueOptions m_writeQueueOptions;
+        /// Buffers of the gather write in progress
+        ConstBufferVector m_writeGather;
+        /// Number of writes at the front of the queue being sent or completed. They must not be dropped.
+        size_t m_writesInProgress;
+        /// Lane of the write in progress
+        size_t m_writingLane;
+        /// Size of the chunk being sent, 0 if complete writes are sent
+        size_t m_chunkInProgress;
+        bool m_writing;
+        /// Waiting for the egress scheduler to grant a turn
+        bool m_waitingForTurn;
+        bool m_writingText;
+        EgressSchedulerSharedPtr m_egressScheduler;
+        size_t m_highWatermark;
+        size_t m_lowWatermark;
+        WatermarkCb m_highWatermarkCb;
+        WatermarkCb m_lowWatermarkCb;
+        bool m_aboveHighWatermark;
+        uint64_t m_droppedWrites;
+        uint64_t m_droppedBytes;
+        /// Completion callbacks of dropped writes not executed yet
+        std::vector < WriteCompletionCb > m_droppedCompletions;
+        bool m_completingDroppedWrites;
+        /// Innermost guard of the callbacks being executed, see DestructionGuard
+        DestructionGuard* m_destructionGuard;
+
+        /// Deliver all complete frames, start reading if there is none
+        void deliverFrames();
+        void readMessage();
+        void deliverMessage(const boost::system::error_code& ec, std::size_t bytesRead);
+
+        FrameLengthExtractor m_frameLengthExtractor;
+        FramesCompletionCb m_framesCb;
+        /// Views of the frames being delivered, kept to reuse the memory
+        ConstBufferVector m_frames;
+        bool m_deliveringFrames;
+        bool m_framesRequested;
+        MessageCompletionCb m_messageCb;
+        /// The message being delivered
+        boost::asio::const_buffer m_message;
+        bool m_deliveringMessage;
+        bool m_messageRequested;
     };
 }
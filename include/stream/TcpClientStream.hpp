@@ -28,7 +28,8 @@ namespace daq::stream {
     public:
         static const std::chrono::milliseconds DefaultConnectTimeout;
 
-        explicit TcpClientStream(boost::asio::io_context& ioc, const std::string& host, const std::string& port);
+        /// \param receiveBufferType Memory used for buffering received data
+        explicit TcpClientStream(boost::asio::io_context& ioc, const std::string& host, const std::string& port, ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
         TcpClientStream(const TcpClientStream&) = delete;
         TcpClientStream& operator= (const TcpClientStream&) = delete;
         ~TcpClientStream() = default;
@@ -25,7 +25,7 @@
 namespace daq::stream {
     class TcpServerStream : public TcpStream {
     public:
-        TcpServerStream(boost::asio::ip::tcp::socket&& socket);
+        TcpServerStream(boost::asio::ip::tcp::socket&& socket, ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
         TcpServerStream(const TcpServerStream&) = delete;
         TcpServerStream& operator= (TcpServerStream&) = delete;
 
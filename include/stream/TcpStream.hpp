@@ -28,17 +28,14 @@ namespace daq::stream {
     {
     public:
         /// Used for client session
-        TcpStream(boost::asio::io_context& ioc);
+        TcpStream(boost::asio::io_context& ioc, ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
         /// Used for accepted session on server side
-        TcpStream(boost::asio::ip::tcp::socket&& socket);
+        TcpStream(boost::asio::ip::tcp::socket&& socket, ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
 
         TcpStream(const TcpStream&) = delete;
         TcpStream& operator= (const TcpStream&) = delete;
         ~TcpStream() = default;
 
-        void asyncWrite(const boost::asio::const_buffer& data, Stream::WriteCompletionCb writeCompletionCb) override;
-        void asyncWrite(const ConstBufferVector& data, WriteCompletionCb writeCompletionCb) override;
-
         size_t write(const boost::asio::const_buffer& data, boost::system::error_code& ec) override;
         size_t write(const ConstBufferVector& data, boost::system::error_code& ec) override;
 
@@ -51,7 +48,11 @@ namespace daq::stream {
         //int initKeepAlive();
 
         void asyncReadAtLeast(std::size_t bytesToRead, ReadCompletionCb readCompletionCb) override;
+        void asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb) override;
         size_t readAtLeast(std::size_t bytesToRead, boost::system::error_code &ec) override;
+        void asyncWaitTransportReadable(CompletionCb waitCb) override;
+        size_t readSomeInto(const boost::asio::mutable_buffer& buffer, boost::system::error_code& ec) override;
+        void asyncReadAllInto(const MutableBufferView& buffers, ReadCompletionCb readCb) override;
 
         boost::asio::ip::tcp::socket m_socket;
     };
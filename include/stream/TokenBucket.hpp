@@ -0,0 +1,61 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace daq::stream {
+    /// Byte budget refilled at a constant rate up to a burst size.
+    /// Consuming more than available is allowed, the debt delays the next consumer. This way, amounts bigger than the burst size pass as well.
+    class TokenBucket {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /// \param bytesPerSecond Refill rate. 0 is unlimited.
+        /// \param burstBytes Maximum budget collected while idle. 0 allows one second worth of bytes.
+        explicit TokenBucket(uint64_t bytesPerSecond = 0, size_t burstBytes = 0, Clock::time_point now = Clock::now());
+
+        /// Change the rate. Collected budget is kept up to the new burst size. Limiting an unlimited bucket starts with the full burst.
+        void setRate(uint64_t bytesPerSecond, size_t burstBytes = 0, Clock::time_point now = Clock::now());
+        uint64_t bytesPerSecond() const;
+        bool unlimited() const;
+        size_t burstBytes() const;
+
+        /// \return True if the budget is not exhausted
+        bool available(Clock::time_point now = Clock::now());
+        /// \return Bytes that can be taken without getting into debt, at least 1 while available, 0 otherwise.
+        /// std::numeric_limits<size_t>::max() if unlimited
+        size_t budget(Clock::time_point now = Clock::now());
+        /// Take bytes from the budget, the budget may become negative
+        void consume(size_t bytes, Clock::time_point now = Clock::now());
+        /// \return Time until the budget is available again, zero if it is available
+        Clock::duration delay(Clock::time_point now = Clock::now());
+        /// \return Time until the budget reaches bytes, zero if it does already
+        Clock::duration delay(size_t bytes, Clock::time_point now = Clock::now());
+
+    private:
+        void refill(Clock::time_point now);
+
+        uint64_t m_bytesPerSecond;
+        double m_burstBytes;
+        /// Negative while in debt
+        double m_tokens;
+        Clock::time_point m_lastRefill;
+    };
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace daq::stream {
+    template < class Signature, std::size_t InlineSize = 64 >
+    class UniqueFunction;
+
+    /// Move-only replacement for std::function, used for completion handlers.
+    ///
+    /// Callables of up to InlineSize bytes are stored inside the object without allocating.
+    /// Bigger ones are moved to the heap. Unlike std::function, callables do not need to be copyable.
+    template < class Result, class... Args, std::size_t InlineSize >
+    class UniqueFunction < Result(Args...), InlineSize > {
+    public:
+        UniqueFunction() noexcept = default;
+
+        UniqueFunction(std::nullptr_t) noexcept
+        {
+        }
+
+        template < class Function,
+                   class = std::enable_if_t < !std::is_same < std::decay_t < Function >, UniqueFunction >::value &&
+                                              std::is_invocable_r < Result, std::decay_t < Function >&, Args... >::value > >
+        UniqueFunction(Function&& function)
+        {
+            using Target = std::decay_t < Function >;
+            // a reference to a function is never null
+            if constexpr ((std::is_pointer < Target >::value || std::is_member_pointer < Target >::value) &&
+                          !std::is_function < std::remove_reference_t < Function > >::value) {
+                if (function == nullptr) {
+                    return;
+                }
+            }
+            if constexpr (isInline < Target >()) {
+                new (m_storage) Target(std::forward < Function >(function));
+                m_operations = &InlineOperations < Target >::operations;
+            } else {
+                new (m_storage) Target*(new Target(std::forward < Function >(function)));
+                m_operations = &HeapOperations < Target >::operations;
+            }
+        }
+
+        UniqueFunction(UniqueFunction&& other) noexcept
+        {
+            moveFrom(other);
+        }
+
+        UniqueFunction& operator= (UniqueFunction&& other) noexcept
+        {
+            if (this != &other) {
+                reset();
+                moveFrom(other);
+            }
+            return *this;
+        }
+
+        UniqueFunction& operator= (std::nullptr_t) noexcept
+        {
+            reset();
+            return *this;
+        }
+
+        UniqueFunction(const UniqueFunction&) = delete;
+        UniqueFunction& operator= (const UniqueFunction&) = delete;
+
+        ~UniqueFunction()
+        {
+            reset();
+        }
+
+        /// \throw std::bad_function_call if empty
+        Result operator()(Args... args) const
+        {
+            if (!m_operations) {
+                throw std::bad_function_call();
+            }
+            return m_operations->invoke(const_cast < unsigned char* >(m_storage), std::forward < Args >(args)...);
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return m_operations != nullptr;
+        }
+
+    private:
+        struct Operations {
+            Result (*invoke)(void* storage, Args&&... args);
+            /// move construct into destination and destroy the source
+            void (*relocate)(void* destination, void* source) noexcept;
+            void (*destroy)(void* storage) noexcept;
+        };
+
+        template < class Target >
+        static constexpr bool isInline()
+        {
+            return sizeof(Target) <= InlineSize
+                && alignof(std::max_align_t) % alignof(Target) == 0
+                && std::is_nothrow_move_constructible < Target >::value;
+        }
+
+        template < class Target >
+        struct InlineOperations {
+            static Result invoke(void* storage, Args&&... args)
+            {
+                return std::invoke(*static_cast < Target* >(storage), std::forward < Args >(args)...);
+            }
+
+            static void relocate(void* destination, void* source) noexcept
+            {
+                Target* target = static_cast < Target* >(source);
+                new (destination) Target(std::move(*target));
+                target->~Target();
+            }
+
+            static void destroy(void* storage) noexcept
+            {
+                static_cast < Target* >(storage)->~Target();
+            }
+
+            static constexpr Operations operations = { &invoke, &relocate, &destroy };
+        };
+
+        template < class Target >
+        struct HeapOperations {
+            static Result invoke(void* storage, Args&&... args)
+            {
+                return std::invoke(**static_cast < Target** >(storage), std::forward < Args >(args)...);
+            }
+
+            static void relocate(void* destination, void* source) noexcept
+            {
+                new (destination) Target*(*static_cast < Target** >(source));
+            }
+
+            static void destroy(void* storage) noexcept
+            {
+                delete *static_cast < Target** >(storage);
+            }
+
+            static constexpr Operations operations = { &invoke, &relocate, &destroy };
+        };
+
+        void moveFrom(UniqueFunction& other) noexcept
+        {
+            if (other.m_operations) {
+                other.m_operations->relocate(m_storage, other.m_storage);
+                m_operations = other.m_operations;
+                other.m_operations = nullptr;
+            }
+        }
+
+        void reset() noexcept
+        {
+            if (m_operations) {
+                // the callable might reset this object when being destroyed
+                const Operations* operations = m_operations;
+                m_operations = nullptr;
+                operations->destroy(m_storage);
+            }
+        }
+
+        alignas(std::max_align_t) unsigned char m_storage[InlineSize];
+        const Operations* m_operations = nullptr;
+    };
+}
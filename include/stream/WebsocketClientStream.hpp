@@ -16,12 +16,18 @@
 
 #pragma once
 
+#include <vector>
+
 #include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/websocket.hpp>
 
 #include "Stream.hpp"
+#include "WebsocketOptions.hpp"
+#include "WebsocketRttMeter.hpp"
+#include "WebsocketTransport.hpp"
 
 namespace daq::stream {
 class WebsocketClientStream : public Stream
@@ -33,7 +39,8 @@ public:
     /// Resolver and socket require an io_context
     /// @param path Used to reach serveral services on the same physical machine i.e. "/servicegreoup/service1". Must be at least "/".
     /// The complete URI of the service has the folowing form: <host>:<port><path>.
-    explicit WebsocketClientStream(boost::asio::io_context& ioc, const std::string& host, const std::string &port, const std::string& path = "/");
+    /// @param receiveBufferType Memory used for buffering received data
+    explicit WebsocketClientStream(boost::asio::io_context& ioc, const std::string& host, const std::string &port, const std::string& path = "/", ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
     WebsocketClientStream(const WebsocketClientStream&) = delete;
     WebsocketClientStream& operator= (WebsocketClientStream&) = delete;
 
@@ -49,8 +56,6 @@ public:
     /// This includes address resolution, tcp connect and upgrade to websocket
     boost::system::error_code init() override;
 
-    void asyncWrite(const boost::asio::const_buffer& data, Stream::WriteCompletionCb writeCompletionCb) override;
-    void asyncWrite(const ConstBufferVector& data, WriteCompletionCb writeCompletionCb) override;
     size_t write(const boost::asio::const_buffer& data, boost::system::error_code& ec) override;
     size_t write(const ConstBufferVector& data, boost::system::error_code& ec) override;
     void asyncClose(CompletionCb closeCb) override;
@@ -60,25 +65,68 @@ public:
     std::string endPointUrl() const override;
     std::string remoteHost() const override;
 
+    /// Takes effect with the next init. minMessageSize applies to every following message
+    void setDeflateOptions(const WebsocketDeflateOptions& deflateOptions);
+    WebsocketTrafficStats trafficStats() const;
+    /// Takes effect with the next message written or read
+    void setWebsocketOptions(const WebsocketOptions& websocketOptions);
+    const WebsocketOptions& websocketOptions() const;
+
+    /// Measure the round trip time by pings sent every interval, see WebsocketRttMeter. Call after init, keep a read pending to receive the pongs.
+    /// @param interval 0 stops pinging
+    void setPingInterval(std::chrono::milliseconds interval);
+    WebsocketRttStats rttStats() const;
+
+protected:
+    using Endpoints = std::vector < boost::asio::generic::stream_protocol::endpoint >;
+
+    /// Connect to the first reachable endpoint and upgrade to websocket. Completes with m_initCompletionCb.
+    void asyncConnect(const Endpoints& endpoints);
+    /// Synchronous variant of asyncConnect()
+    boost::system::error_code connect(const Endpoints& endpoints);
+    bool isOpen() const;
+
+    boost::asio::io_context& m_ioc;
+
 private:
     void onResolve(const boost::beast::error_code& ec, boost::asio::ip::tcp::resolver::results_type results);
     void onConnect(const boost::beast::error_code& ec);
     void onUpgrade(const boost::beast::error_code& ec);
 
     void asyncReadAtLeast(std::size_t bytesToRead, ReadCompletionCb readAtLeastCb) override;
+    void asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb) override;
     size_t readAtLeast(std::size_t bytesToRead, boost::system::error_code &ec) override;
+    void asyncReadMessageTransport(ReadCompletionCb readCb) override;
+    bool messageBinary() const override;
+    bool messageOriented() const override;
     void asyncTimeoutCb(const boost::system::error_code& ec);
 
     void setOptions();
+    /// Transport traffic so far belongs to the handshake
+    void onHandshakeDone();
+    /// Compress the next message if it is big enough
+    void compressIfWorthIt(size_t messageSize);
+    /// Size the write buffer for the next message in the adaptive mode
+    void adaptWriteBuffer(size_t messageSize);
 
-    boost::asio::io_context& m_ioc;
     std::string m_host;
     std::string m_port;
     /// specifies the service on the server addressed with host and port
     std::string m_path;
-    boost::beast::websocket::stream<boost::beast::tcp_stream> m_stream;
+    Websocket m_stream;
     boost::asio::ip::tcp::resolver m_resolver;
     boost::asio::deadline_timer m_asyncOperationTimer;
     std::chrono::milliseconds m_asyncTimeout;
+    /// Receive buffer as dynamic buffer for reads by Beast. Has to outlive the read operation.
+    ReceiveBufferRef m_dynamicBuffer;
+    WebsocketDeflateOptions m_deflateOptions;
+    WebsocketOptions m_websocketOptions;
+    WebsocketWriteBufferSizer m_writeBufferSizer;
+    /// Uncompressed bytes are counted here, the transport counts the compressed ones
+    WebsocketTrafficStats m_trafficStats;
+    /// Transport traffic of the handshake
+    uint64_t m_handshakeBytesRead;
+    uint64_t m_handshakeBytesWritten;
+    WebsocketRttMeterSharedPtr m_rttMeter;
 };
 }
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/beast/core/role.hpp>
+#include <boost/beast/websocket/option.hpp>
+
+#include "stream/WebsocketTransport.hpp"
+
+namespace daq::stream {
+    /// permessage-deflate compression (RFC 7692) of websocket messages.
+    /// Negotiated during the websocket handshake, messages are only compressed if both peers enable it.
+    struct WebsocketDeflateOptions {
+        bool enabled = false;
+        /// Base 2 logarithm of the sliding window used by the server for compressing, 9 to 15.
+        /// Smaller windows need less memory per connection and compress worse
+        int serverMaxWindowBits = 15;
+        /// Base 2 logarithm of the sliding window used by the client for compressing, 9 to 15
+        int clientMaxWindowBits = 15;
+        /// true: The server compresses each message on its own, without referring to earlier messages.
+        /// Saves the memory of keeping the window between messages at the cost of compression ratio
+        bool serverNoContextTakeover = false;
+        /// Same for messages compressed by the client
+        bool clientNoContextTakeover = false;
+        /// zlib compression level, 0 (none) to 9 (best). Higher levels cost more CPU time
+        int compressionLevel = 8;
+        /// zlib memory level, 1 to 9. Higher levels use more memory to compress faster and better
+        int memoryLevel = 4;
+        /// Messages with less payload are sent uncompressed. Applied by the stream for each message it writes.
+        /// Needs a Beast version providing websocket::stream::compress(), see perMessageCompressionSupported().
+        /// Otherwise a warning is logged and it is reset to 0, every message is compressed.
+        size_t minMessageSize = 0;
+    };
+
+    /// \return The options to be negotiated by Beast for a websocket stream of the given role
+    boost::beast::websocket::permessage_deflate permessageDeflate(const WebsocketDeflateOptions& options, boost::beast::role_type role);
+
+    /// Switch compression of the next message written on or off. Without compression negotiated, nothing is compressed anyway.
+    /// \return false if not supported by the Beast version in use
+    bool compressNextMessage(Websocket& websocket, bool compress);
+    bool compressNextMessage(TcpWebsocket& websocket, bool compress);
+    /// \return true if the Beast version in use can switch compression per message, see WebsocketDeflateOptions::minMessageSize
+    bool perMessageCompressionSupported();
+    /// \return The options without what the Beast version in use does not support, a warning is logged for each dropped option
+    WebsocketDeflateOptions supportedDeflateOptions(const WebsocketDeflateOptions& options);
+
+    /// Buffering, fragmentation and limits of a websocket stream. Trades throughput of big messages against memory per connection.
+    struct WebsocketOptions {
+        /// Memory Beast uses to mask (client role) or compress outgoing payload before writing it. Also the size of the frames
+        /// when autoFragment is set. Bigger buffers need fewer writes to the transport. Unmasked and uncompressed messages of the
+        /// server role are written without it. Minimum is 8
+        size_t writeBufferSize = 65536;
+        /// true: Messages are split into frames of writeBufferSize. false: Each message is sent as a single frame
+        bool autoFragment = false;
+        /// Reading a bigger message fails with boost::beast::websocket::error::message_too_big. 0: No limit
+        uint64_t readMessageMax = 16 * 1024 * 1024;
+        /// Largest amount of payload read from the transport at once. Replaces maxReadSize of the read size policy.
+        /// 0: Keep the read size policy of the stream
+        size_t readBufferSize = 0;
+        /// true: writeBufferSize is the initial size only. The buffer grows to fit bigger messages up to maxWriteBufferSize
+        /// and shrinks by half when a number of messages in a row fit into a quarter of it, not below minWriteBufferSize
+        bool adaptiveWriteBuffer = false;
+        size_t minWriteBufferSize = 4096;
+        size_t maxWriteBufferSize = 1024 * 1024;
+    };
+
+    /// How a websocket stream gets closed
+    enum class WebsocketCloseMode {
+        /// Close handshake: Send a close frame and wait for the reply of the peer, at most WEBSOCKET_CLOSE_HANDSHAKE_TIMEOUT
+        Handshake,
+        /// Send a close frame if the socket takes it without blocking, then close the TCP connection without waiting for the reply.
+        /// If a write is in progress, including pings and pongs of Beast, the frame would end up within another one and is left out.
+        /// If the socket takes only part of the frame, the connection is reset like by Abort.
+        CloseFrame,
+        /// Reset the TCP connection right away, nothing is sent
+        Abort
+    };
+
+    /// Apply the options that Beast keeps itself. Write buffer and fragmenting take effect with the next message written
+    void applyWebsocketOptions(Websocket& websocket, const WebsocketOptions& options);
+    void applyWebsocketOptions(TcpWebsocket& websocket, const WebsocketOptions& options);
+
+    /// Keeps track of the write buffer size in the adaptive mode of WebsocketOptions
+    class WebsocketWriteBufferSizer {
+    public:
+        /// Number of small messages in a row that halve the write buffer
+        static const size_t ShrinkAfterMessages;
+
+        WebsocketWriteBufferSizer();
+
+        void setOptions(const WebsocketOptions& options);
+        /// A message of the given size is about to be written
+        /// \return Write buffer size to be used for it
+        size_t onMessage(size_t messageSize);
+        size_t writeBufferSize() const;
+
+    private:
+        bool m_adaptive;
+        size_t m_minWriteBufferSize;
+        size_t m_maxWriteBufferSize;
+        size_t m_writeBufferSize;
+        size_t m_smallMessages;
+    };
+
+    /// Traffic of a websocket stream to weigh the bandwidth saved by compression against its CPU time.
+    /// Counted from the completion of the websocket handshake.
+    struct WebsocketTrafficStats {
+        /// Payload of all messages sent, before compression
+        uint64_t uncompressedBytesSent = 0;
+        /// Bytes written to the transport. Includes frame headers and control frames
+        uint64_t compressedBytesSent = 0;
+        /// Payload of all messages received, after decompression
+        uint64_t uncompressedBytesReceived = 0;
+        /// Bytes read from the transport. Includes frame headers and control frames
+        uint64_t compressedBytesReceived = 0;
+    };
+}
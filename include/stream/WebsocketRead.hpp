@@ -0,0 +1,92 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+#include <boost/system/error_code.hpp>
+
+namespace daq::stream {
+    /// Continues reading from a Beast websocket stream until at least the requested amount of payload arrived.
+    template < class Websocket, class DynamicBuffer, class Handler >
+    class WebsocketReadAtLeastOp {
+    public:
+        WebsocketReadAtLeastOp(Websocket& websocket, DynamicBuffer& buffer, std::size_t bytesToRead, std::size_t maxReadSize, Handler&& handler)
+            : m_websocket(websocket)
+            , m_buffer(buffer)
+            , m_bytesToRead(bytesToRead)
+            , m_maxReadSize(maxReadSize)
+            , m_bytesRead(0)
+            , m_handler(std::move(handler))
+        {
+        }
+
+        void start()
+        {
+            m_websocket.async_read_some(m_buffer, m_maxReadSize, std::move(*this));
+        }
+
+        void operator()(const boost::system::error_code& ec, std::size_t bytesRead)
+        {
+            m_bytesRead += bytesRead;
+            if (ec || m_bytesRead >= m_bytesToRead) {
+                m_handler(ec, m_bytesRead);
+                return;
+            }
+            start();
+        }
+
+    private:
+        Websocket& m_websocket;
+        DynamicBuffer& m_buffer;
+        std::size_t m_bytesToRead;
+        std::size_t m_maxReadSize;
+        std::size_t m_bytesRead;
+        Handler m_handler;
+    };
+
+    /// Read websocket payload into a dynamic buffer until at least bytesToRead bytes arrived.
+    ///
+    /// boost::asio::async_read offers Beast the memory the dynamic buffer prepares on its own, usually less than a frame.
+    /// Beast then receives into its internal frame buffer, unmasks there and copies into the dynamic buffer.
+    /// Here each read prepares room for the remaining payload of the current frame, up to maxReadSize.
+    /// Large frames are received and unmasked in place, directly in the dynamic buffer.
+    /// Only data arriving together with a frame header goes through the frame buffer of Beast.
+    /// \param buffer Has to outlive the operation
+    template < class Websocket, class DynamicBuffer, class Handler >
+    void asyncWebsocketReadAtLeast(Websocket& websocket, DynamicBuffer& buffer, std::size_t bytesToRead, std::size_t maxReadSize, Handler handler)
+    {
+        WebsocketReadAtLeastOp < Websocket, DynamicBuffer, Handler > op(websocket, buffer, bytesToRead, maxReadSize, std::move(handler));
+        op.start();
+    }
+
+    /// Synchronous variant of asyncWebsocketReadAtLeast
+    template < class Websocket, class DynamicBuffer >
+    std::size_t websocketReadAtLeast(Websocket& websocket, DynamicBuffer& buffer, std::size_t bytesToRead, std::size_t maxReadSize, boost::system::error_code& ec)
+    {
+        ec.clear();
+        std::size_t bytesRead = 0;
+        while (bytesRead < bytesToRead) {
+            bytesRead += websocket.read_some(buffer, maxReadSize, ec);
+            if (ec) {
+                break;
+            }
+        }
+        return bytesRead;
+    }
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <variant>
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/string_type.hpp>
+#include <boost/beast/websocket/rfc6455.hpp>
+
+#include "stream/WebsocketTransport.hpp"
+
+namespace daq::stream {
+    /// Round trip time and health of a websocket connection, measured by pings carrying their send time
+    struct WebsocketRttStats {
+        /// Exponentially weighted average of the round trip time like TCP does it (RFC 6298)
+        std::chrono::microseconds smoothedRtt{0};
+        /// Average deviation of the round trip time from smoothedRtt
+        std::chrono::microseconds jitter{0};
+        std::chrono::microseconds minRtt{0};
+        std::chrono::microseconds maxRtt{0};
+        /// Round trip time of the latest pong
+        std::chrono::microseconds lastRtt{0};
+        uint64_t pingsSent = 0;
+        uint64_t pongsReceived = 0;
+        /// Time of the latest pong. Default constructed if there was none yet
+        std::chrono::steady_clock::time_point lastPongTime;
+    };
+
+    /// Smoothed round trip time and its variation, calculated as TCP does it (RFC 6298)
+    class RttEstimator {
+    public:
+        RttEstimator();
+
+        void addSample(std::chrono::microseconds rtt);
+        /// \return Number of samples added
+        uint64_t samples() const;
+        std::chrono::microseconds smoothedRtt() const;
+        std::chrono::microseconds jitter() const;
+        std::chrono::microseconds minRtt() const;
+        std::chrono::microseconds maxRtt() const;
+        std::chrono::microseconds lastRtt() const;
+
+    private:
+        uint64_t m_samples;
+        std::chrono::microseconds m_smoothedRtt;
+        std::chrono::microseconds m_jitter;
+        std::chrono::microseconds m_minRtt;
+        std::chrono::microseconds m_maxRtt;
+        std::chrono::microseconds m_lastRtt;
+    };
+
+    /// Sends pings with the send time as payload periodically and measures the round trip time from the pongs.
+    /// The next ping is sent one interval after the previous one went out. Pings sent by the idle timeout of Beast are not counted.
+    /// Beast hands over pongs while reading only, a read has to be pending for the pongs to be seen.
+    class WebsocketRttMeter : public std::enable_shared_from_this < WebsocketRttMeter > {
+    public:
+        /// \param websocket Has to outlive the meter
+        explicit WebsocketRttMeter(Websocket& websocket);
+        explicit WebsocketRttMeter(TcpWebsocket& websocket);
+        WebsocketRttMeter(const WebsocketRttMeter&) = delete;
+        WebsocketRttMeter& operator= (const WebsocketRttMeter&) = delete;
+
+        /// Start pinging, the first ping is sent right away. Sending stops when a ping fails, i.e. the connection got closed.
+        /// \param interval 0 stops pinging
+        void setInterval(std::chrono::milliseconds interval);
+        std::chrono::milliseconds interval() const;
+        WebsocketRttStats stats() const;
+
+        /// Called by Beast for each control frame received
+        void onControlFrame(boost::beast::websocket::frame_type kind, boost::beast::string_view payload);
+
+    private:
+        void sendPing();
+        void onPingSent(const boost::system::error_code& ec);
+        void onTimer(const boost::system::error_code& ec);
+
+        std::variant < Websocket*, TcpWebsocket* > m_websocket;
+        boost::asio::steady_timer m_timer;
+        std::chrono::milliseconds m_interval;
+        bool m_timerPending;
+        bool m_pingPending;
+        RttEstimator m_estimator;
+        uint64_t m_pingsSent;
+        uint64_t m_pongsReceived;
+        std::chrono::steady_clock::time_point m_lastPongTime;
+    };
+
+    using WebsocketRttMeterSharedPtr = std::shared_ptr < WebsocketRttMeter >;
+}
@@ -16,14 +16,18 @@
 
 #pragma once
 
+#include <chrono>
 
+#include "boost/asio/generic/stream_protocol.hpp"
 #include "boost/asio/io_context.hpp"
 #include "boost/asio/ip/tcp.hpp"
 
 
 #include "stream/Server.hpp"
 #include "stream/Stream.hpp"
+#include "stream/WebsocketOptions.hpp"
 #include "stream/WebsocketServerStream.hpp"
+#include "stream/WebsocketTransport.hpp"
 
 namespace daq::stream {
     class WebsocketServer : public Server {
@@ -35,17 +39,51 @@ namespace daq::stream {
         WebsocketServer& operator= (const WebsocketServer&) = delete;
         virtual ~WebsocketServer();
         int start();
+        /// Connections whose websocket handshake completes afterwards are closed by the shutdown mode, no stream is handed out for them
         void stop();
+
+        /// Offered to clients connecting afterwards. Disabled by default
+        void setDeflateOptions(const WebsocketDeflateOptions& deflateOptions);
+        const WebsocketDeflateOptions& deflateOptions() const;
+        /// Applied to streams of clients connecting afterwards
+        void setWebsocketOptions(const WebsocketOptions& websocketOptions);
+        const WebsocketOptions& websocketOptions() const;
+        /// Streams of clients connecting afterwards measure their round trip time, see WebsocketServerStream::setPingInterval()
+        /// \param interval 0 (default) disables pinging
+        void setPingInterval(std::chrono::milliseconds interval);
+        std::chrono::milliseconds pingInterval() const;
+        /// Close mode of the streams closed by stop(), see Server::setCloseStreamsOnStop(). Default is WebsocketCloseMode::Handshake.
+        /// The handshakes of all streams run at the same time, stopping takes WEBSOCKET_CLOSE_HANDSHAKE_TIMEOUT at most.
+        /// The other modes close all streams right away.
+        void setShutdownMode(WebsocketCloseMode shutdownMode);
+        WebsocketCloseMode shutdownMode() const;
+
+    protected:
+        /// For servers accepting other than TCP connections, the TCP acceptors are not used
+        WebsocketServer(boost::asio::io_context& readerIoContext, NewStreamCb newStreamCb);
+
+        /// Upgrade an accepted connection to websocket. A stream is created on success.
+        /// \param socket TCP or Unix domain socket
+        void upgrade(boost::asio::generic::stream_protocol::socket&& socket);
+        /// To be called by start() of derived classes not calling WebsocketServer::start()
+        void onStart();
+
     private:
         void startTcpAccept(boost::asio::ip::tcp::acceptor& tcpAcceptor);
         void onAccept(boost::asio::ip::tcp::acceptor& tcpAcceptor,
                       const boost::system::error_code& ec,
                       boost::asio::ip::tcp::socket&& tcpSocket);
         /// called after completion of upgrade to websocket
-        void onUpgrade(const boost::system::error_code& ec, std::shared_ptr < boost::beast::websocket::stream <boost::beast::tcp_stream > > websocket);
+        void onUpgrade(const boost::system::error_code& ec, std::shared_ptr < Websocket > websocket);
         
         uint16_t m_tcpDataPort;
         boost::asio::ip::tcp::acceptor m_tcpAcceptorV4;
         boost::asio::ip::tcp::acceptor m_tcpAcceptorV6;
+        WebsocketDeflateOptions m_deflateOptions;
+        WebsocketOptions m_websocketOptions;
+        std::chrono::milliseconds m_pingInterval;
+        WebsocketCloseMode m_shutdownMode;
+        /// Set by stop(), cleared by start()
+        bool m_stopped;
     };
 }
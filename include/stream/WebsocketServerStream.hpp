@@ -17,40 +17,92 @@
 #pragma once
 
 #include <string>
+#include <variant>
 
 #include "boost/asio/buffer.hpp"
-#include <boost/beast/core/tcp_stream.hpp>
 
 #include "boost/beast/websocket/stream.hpp"
 
 #include "Stream.hpp"
+#include "WebsocketOptions.hpp"
+#include "WebsocketRttMeter.hpp"
+#include "WebsocketTransport.hpp"
 
 namespace daq::stream {
+    /// Server side of a websocket connection.
+    /// Messages are sent unfragmented and without copying the payload. Broadcasting one BufferSlice to many streams, see BroadcastHub,
+    /// costs a frame header of a few bytes and one gather write per stream.
     class WebsocketServerStream : public Stream {
     public:
         /// websocket upgrade will happen later in asyncInit()
-        WebsocketServerStream(std::shared_ptr<boost::beast::websocket::stream<boost::beast::tcp_stream> > websocket);
+        /// \param websocket Runs on WebsocketTransport, on a TCP or a Unix domain socket, see Websocket
+        /// \param receiveBufferType Memory used for buffering received data
+        WebsocketServerStream(std::shared_ptr<Websocket> websocket, ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
+        /// \param websocket Runs on boost::beast::tcp_stream. The compressed bytes of trafficStats() are not counted
+        /// and WebsocketCloseMode::CloseFrame closes without sending the frame, there is no telling whether Beast is writing.
+        WebsocketServerStream(std::shared_ptr<TcpWebsocket> websocket, ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf);
         WebsocketServerStream(const WebsocketServerStream&) = delete;
         WebsocketServerStream& operator= (WebsocketServerStream&) = delete;
 
+        /// \return Remote address and port of TCP peers, the path of the local endpoint and the socket handle of Unix domain peers
         std::string endPointUrl() const override;
         std::string remoteHost() const override;
         /// Upgrade to websocket happens here.
         void asyncInit(CompletionCb completionCb) override;
         boost::system::error_code init() override;
-        void asyncWrite(const boost::asio::const_buffer& data, WriteCompletionCb writeCompletionCb) override;
-        void asyncWrite(const ConstBufferVector& data, Stream::WriteCompletionCb writeCompletionCb) override;
         size_t write(const boost::asio::const_buffer& data, boost::system::error_code& ec) override;
         size_t write(const ConstBufferVector& data, boost::system::error_code& ec) override;
 
+        /// Depending on the close mode, asyncClose() completes right away
         void asyncClose(CompletionCb closeCb) override;
         boost::system::error_code close() override;
+
+        /// Default is WebsocketCloseMode::Handshake
+        void setCloseMode(WebsocketCloseMode closeMode);
+        WebsocketCloseMode closeMode() const;
+
+        /// Compression got negotiated by the WebsocketServer already, only minMessageSize takes effect here
+        void setDeflateOptions(const WebsocketDeflateOptions& deflateOptions);
+        WebsocketTrafficStats trafficStats() const;
+        /// Takes effect with the next message written or read
+        void setWebsocketOptions(const WebsocketOptions& websocketOptions);
+        const WebsocketOptions& websocketOptions() const;
+
+        /// Measure the round trip time by pings sent every interval, see WebsocketRttMeter. Keep a read pending to receive the pongs.
+        /// \param interval 0 stops pinging
+        void setPingInterval(std::chrono::milliseconds interval);
+        WebsocketRttStats rttStats() const;
     private:
         /// websocket accept (handshake)
         void onAccept(const boost::beast::error_code& ec);
         void asyncReadAtLeast(std::size_t bytesToRead, ReadCompletionCb readAtLeastCb) override;
+        void asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb) override;
         size_t readAtLeast(std::size_t bytesToRead, boost::system::error_code &ec) override;
+        void asyncReadMessageTransport(ReadCompletionCb readCb) override;
+        bool messageBinary() const override;
+        bool messageOriented() const override;
         void setOptions();
-        std::shared_ptr<boost::beast::websocket::stream<boost::beast::tcp_stream> > m_websocket;
+        /// Close the transport according to a close mode other than WebsocketCloseMode::Handshake
+        boost::system::error_code closeWithoutHandshake();
+        /// Compress the next message if it is big enough
+        void compressIfWorthIt(size_t messageSize);
+        /// Size the write buffer for the next message in the adaptive mode
+        void adaptWriteBuffer(size_t messageSize);
+        /// Execute operation with the websocket, whichever kind it is
+        template < class Operation >
+        decltype(auto) visitWebsocket(Operation&& operation) const;
+        std::variant < std::shared_ptr < Websocket >, std::shared_ptr < TcpWebsocket > > m_websocket;
+        /// Receive buffer as dynamic buffer for reads by Beast. Has to outlive the read operation.
+        ReceiveBufferRef m_dynamicBuffer;
+        WebsocketDeflateOptions m_deflateOptions;
+        WebsocketOptions m_websocketOptions;
+        WebsocketWriteBufferSizer m_writeBufferSizer;
+        /// Uncompressed bytes are counted here, the transport counts the compressed ones
+        WebsocketTrafficStats m_trafficStats;
+        /// Transport traffic of the handshake
+        uint64_t m_handshakeBytesRead;
+        uint64_t m_handshakeBytesWritten;
+        WebsocketRttMeterSharedPtr m_rttMeter;
+        WebsocketCloseMode m_closeMode;
     };
 }
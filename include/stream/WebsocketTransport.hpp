@@ -0,0 +1,157 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/beast/core/basic_stream.hpp>
+#include <boost/beast/core/rate_policy.hpp>
+#include <boost/beast/core/role.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/websocket/teardown.hpp>
+#include <boost/beast/websocket/stream.hpp>
+
+namespace daq::stream {
+    /// Rate policy of Beast that does not limit anything but counts the bytes transferred.
+    /// Beast asks it before each asynchronous write to the socket and tells it after completion, this tells whether a write is in progress.
+    class TransportByteCounter {
+    public:
+        uint64_t bytesRead() const
+        {
+            return m_bytesRead;
+        }
+
+        uint64_t bytesWritten() const
+        {
+            return m_bytesWritten;
+        }
+
+        /// \return true while an asynchronous write to the socket is in progress, no matter whether it carries a message or a control frame of Beast.
+        /// A frame might be written partially then.
+        bool writing() const
+        {
+            return m_writesInProgress != 0;
+        }
+
+        void transfer_read_bytes(std::size_t size) noexcept
+        {
+            m_bytesRead += size;
+        }
+
+        /// Count bytes of a synchronous write
+        void countBytesWritten(std::size_t size) noexcept
+        {
+            m_bytesWritten += size;
+        }
+
+    private:
+        friend class boost::beast::rate_policy_access;
+
+        std::size_t available_read_bytes() const noexcept
+        {
+            return std::numeric_limits < std::size_t >::max();
+        }
+
+        /// Start of an asynchronous write
+        std::size_t available_write_bytes() noexcept
+        {
+            ++m_writesInProgress;
+            return std::numeric_limits < std::size_t >::max();
+        }
+
+        /// Completion of an asynchronous write. Writes of empty buffers complete without being started.
+        void transfer_write_bytes(std::size_t size) noexcept
+        {
+            m_bytesWritten += size;
+            if (m_writesInProgress) {
+                --m_writesInProgress;
+            }
+        }
+
+        void on_timer() const noexcept
+        {
+        }
+
+        uint64_t m_bytesRead = 0;
+        uint64_t m_bytesWritten = 0;
+        size_t m_writesInProgress = 0;
+    };
+
+    /// Transport of websocket streams. Like boost::beast::tcp_stream, it additionally counts the bytes passing it.
+    /// The generic protocol takes over a TCP socket as well as a Unix domain socket, both run the same websocket streams.
+    /// Beast applies the rate policy to asynchronous operations only, the synchronous ones are counted here.
+    class WebsocketTransport : public boost::beast::basic_stream < boost::asio::generic::stream_protocol, boost::asio::any_io_executor, TransportByteCounter > {
+    public:
+        using basic_stream::basic_stream;
+
+        template < class MutableBufferSequence >
+        std::size_t read_some(const MutableBufferSequence& buffers)
+        {
+            std::size_t bytesRead = basic_stream::read_some(buffers);
+            rate_policy().transfer_read_bytes(bytesRead);
+            return bytesRead;
+        }
+
+        template < class MutableBufferSequence >
+        std::size_t read_some(const MutableBufferSequence& buffers, boost::system::error_code& ec)
+        {
+            std::size_t bytesRead = basic_stream::read_some(buffers, ec);
+            rate_policy().transfer_read_bytes(bytesRead);
+            return bytesRead;
+        }
+
+        template < class ConstBufferSequence >
+        std::size_t write_some(const ConstBufferSequence& buffers)
+        {
+            std::size_t bytesWritten = basic_stream::write_some(buffers);
+            rate_policy().countBytesWritten(bytesWritten);
+            return bytesWritten;
+        }
+
+        template < class ConstBufferSequence >
+        std::size_t write_some(const ConstBufferSequence& buffers, boost::system::error_code& ec)
+        {
+            std::size_t bytesWritten = basic_stream::write_some(buffers, ec);
+            rate_policy().countBytesWritten(bytesWritten);
+            return bytesWritten;
+        }
+    };
+
+    /// Found by Beast through argument dependent lookup when closing
+    inline void teardown(boost::beast::role_type role, WebsocketTransport& transport, boost::system::error_code& ec)
+    {
+        boost::beast::websocket::teardown(role, transport.socket(), ec);
+    }
+
+    template < class TeardownHandler >
+    void async_teardown(boost::beast::role_type role, WebsocketTransport& transport, TeardownHandler&& handler)
+    {
+        boost::beast::websocket::async_teardown(role, transport.socket(), std::forward < TeardownHandler >(handler));
+    }
+
+    /// Websocket stream run by WebsocketServerStream and WebsocketClientStream. Created on WebsocketTransport,
+    /// e.g. from a TCP or Unix domain socket moved into a boost::asio::generic::stream_protocol::socket.
+    /// Socket options of TCP still apply to next_layer().socket(), e.g. set_option(boost::asio::ip::tcp::no_delay(true)). Its endpoints are generic ones.
+    using Websocket = boost::beast::websocket::stream < WebsocketTransport >;
+    /// Websocket stream on TCP only, as used before WebsocketTransport. WebsocketServerStream still takes it but cannot count the bytes passing the transport.
+    using TcpWebsocket = boost::beast::websocket::stream < boost::beast::tcp_stream >;
+}
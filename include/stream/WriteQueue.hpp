@@ -0,0 +1,168 @@
+/*
+ * Copyright 2022-2024 openDAQ d.o.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "stream/BufferSequenceView.hpp"
+#include "stream/UniqueFunction.hpp"
+
+namespace daq::stream {
+    /// What to do with a write that does not fit into WriteQueueOptions::maxQueuedBytes
+    enum class WriteOverflowPolicy {
+        /// Accept all writes. Use the write watermarks of the stream to pause producers.
+        Block,
+        /// Drop queued writes, starting with the oldest, until the new one fits. Writes being sent are never dropped.
+        DropOldest,
+        /// Drop the new write
+        DropNewest,
+        /// A keyed write replaces the queued write with the same key that is not being sent yet.
+        /// Writes without key and maxQueuedBytes are not affected.
+        KeepLatestPerKey
+    };
+
+    /// Limits for queueing writes and for combining them into a single gather write
+    struct WriteQueueOptions {
+        /// Queued writes are combined as long as the total stays within this amount of bytes.
+        /// A single write that is bigger is sent on its own.
+        size_t maxCoalescedBytes = 65536;
+        /// Queued writes are combined as long as the total number of buffers stays within this limit (iovec entries of writev).
+        size_t maxCoalescedBuffers = 64;
+        WriteOverflowPolicy overflowPolicy = WriteOverflowPolicy::Block;
+        /// Limit for WriteOverflowPolicy::DropOldest and WriteOverflowPolicy::DropNewest. 0 is unlimited.
+        size_t maxQueuedBytes = 0;
+        /// Number of priority lanes, see Stream::asyncWritePriority(). Lanes are added but never removed.
+        size_t priorityLanes = 1;
+        /// Writes bigger than this are sent in chunks of this size, i.e. to keep rate limited writes short. 0 disables chunking.
+        /// Message oriented streams ignore it, each chunk would be a message of its own.
+        size_t maxChunkSize = 0;
+        /// Allow writes of a higher priority to be sent between the chunks of a write. Otherwise the chunked write is completed first.
+        /// Chunks are cut at any byte position. Enable it only if the receiver tells apart the data of different lanes, i.e. by a framing of its own.
+        bool interleaveChunks = false;
+    };
+
+    /// Writes waiting for the transport, in the order they were requested.
+    /// Memory of completed writes is reused, a steady flow of writes does not allocate.
+    class WriteQueue {
+    public:
+        using WriteCompletionCb = UniqueFunction < void(const boost::system::error_code& ec, std::size_t bytesWritten) >;
+
+        /// Biggest prefix stored by pushPrefixed()
+        static const size_t MaxPrefixSize = 16;
+
+        WriteQueue();
+
+        /// Buffer is copied
+        void push(const boost::asio::const_buffer& data, WriteCompletionCb writeCb);
+        /// Sequence of buffers is copied
+        void push(const std::vector < boost::asio::const_buffer >& data, WriteCompletionCb writeCb);
+        /// Sequence of buffers is referred to, not copied
+        void push(const ConstBufferView& data, WriteCompletionCb writeCb);
+        /// The prefix, at most MaxPrefixSize bytes, is copied into the queue and sent in front of the data. The buffer of the data is copied.
+        void pushPrefixed(const boost::asio::const_buffer& prefix, const boost::asio::const_buffer& data, WriteCompletionCb writeCb);
+        /// Buffer is copied. The write can be found by its key.
+        void pushKeyed(uint64_t key, const boost::asio::const_buffer& data, WriteCompletionCb writeCb);
+        /// Buffer is copied. The write is a message of its own, it is neither combined with others nor chunked.
+        void pushMessage(const boost::asio::const_buffer& data, bool text, WriteCompletionCb writeCb);
+        /// Sequence of buffers is copied, otherwise like pushMessage() with a single buffer
+        void pushMessage(const std::vector < boost::asio::const_buffer >& data, bool text, WriteCompletionCb writeCb);
+
+        bool empty() const;
+        /// \return Number of queued writes
+        size_t count() const;
+        /// \return Number of bytes of all queued writes not sent yet
+        size_t bytes() const;
+        /// \return 1 if the write at the front is sent partially already, 0 otherwise. Such a write has to be completed, it must not be removed.
+        size_t partiallySent() const;
+
+        /// Collect the buffers of the queued writes from the front that fit into the limits of options. At least one write is collected.
+        /// If the remaining data of the write at the front exceeds options.maxChunkSize, only a chunk of it is collected.
+        /// \param coalesce false to collect only the write at the front
+        /// \param gather Cleared, then filled with the buffers of the collected writes
+        /// \param[out] chunkSize Size of the chunk if only a chunk is collected, 0 otherwise
+        /// \return Number of writes collected completely
+        size_t gather(const WriteQueueOptions& options, bool coalesce, std::vector < boost::asio::const_buffer >& gather, size_t& chunkSize) const;
+        /// A chunk of the write at the front got sent
+        void advance(size_t chunkSize);
+        /// \return true if the write at the front is a message flagged as text
+        bool frontIsText() const;
+
+        /// Remove the write at the front
+        /// \param[out] bytes Size of the removed write
+        /// \return Completion callback of the removed write
+        WriteCompletionCb pop(size_t& bytes);
+        /// Remove the write at the given position, counted from the front. The order of the others is kept.
+        /// \param[out] bytes Size of the removed write
+        /// \return Completion callback of the removed write
+        WriteCompletionCb remove(size_t position, size_t& bytes);
+        /// \return Position of the first keyed write with the given key at or behind position first, count() if there is none
+        size_t find(uint64_t key, size_t first) const;
+
+    private:
+        struct Request {
+            /// Tells which member holds the data. Members of other kinds may be left over from earlier writes.
+            enum class Kind {
+                Buffer,
+                Buffers,
+                View,
+                Prefixed
+            };
+
+            Kind kind = Kind::Buffer;
+            /// Used for a single buffer
+            boost::asio::const_buffer buffer;
+            /// Used for a copied sequence of buffers
+            std::vector < boost::asio::const_buffer > buffers;
+            /// Used for a sequence of buffers owned by the caller
+            ConstBufferView view;
+            /// Used for a copied prefix followed by a single buffer
+            std::array < uint8_t, MaxPrefixSize > prefix;
+            std::array < boost::asio::const_buffer, 2 > prefixed;
+            size_t bytes = 0;
+            /// Bytes sent as chunks already
+            size_t sent = 0;
+            bool keyed = false;
+            uint64_t key = 0;
+            /// Written on its own, see pushMessage()
+            bool message = false;
+            bool text = false;
+            WriteCompletionCb writeCb;
+
+            ConstBufferView sequence() const;
+        };
+
+        /// Append size bytes of the sequence starting at offset to gather
+        static void append(const ConstBufferView& sequence, size_t offset, size_t size, std::vector < boost::asio::const_buffer >& gather);
+
+        Request& emplace();
+        Request& at(size_t position);
+        const Request& at(size_t position) const;
+
+        /// Ring of requests, grows when full. Requests keep their address, a prefix being sent stays valid.
+        std::vector < std::unique_ptr < Request > > m_requests;
+        size_t m_head;
+        size_t m_count;
+        size_t m_bytes;
+    };
+}
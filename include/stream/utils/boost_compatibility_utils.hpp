@@ -20,6 +20,8 @@
 #include <boost/beast/core/tcp_stream.hpp>
 #include <boost/beast/websocket/stream.hpp>
 
+#include "stream/WebsocketTransport.hpp"
+
 #define BEGIN_NAMESPACE_STREAM_UTILS namespace daq { namespace stream { 
 #define END_NAMESPACE_STREAM_UTILS }}
 
@@ -28,7 +30,7 @@ BEGIN_NAMESPACE_STREAM_UTILS
 namespace boost_compatibility_utils
 {
     using BoostHandler = std::function<void(const boost::system::error_code&)>;
-    using WebsocketStream = boost::beast::websocket::stream<boost::beast::tcp_stream>;
+    using WebsocketStream = Websocket;
     using WriteCallback = std::function<void(boost::beast::error_code ec, std::size_t written)>;
 
     void async_handshake(WebsocketStream& stream,
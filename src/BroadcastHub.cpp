@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstring>
+
+#include <boost/asio/error.hpp>
+
+#include "stream/BroadcastHub.hpp"
+
+namespace daq::stream {
+    BroadcastHub::BroadcastHub(const BroadcastHubOptions& options)
+        : m_options(options)
+    {
+    }
+
+    void BroadcastHub::subscribe(const StreamSharedPtr& stream)
+    {
+        auto subscriber = std::make_shared < Subscriber >();
+        subscriber->stream = stream;
+        m_subscribers.push_back(subscriber);
+        // snapshot for the late joiner
+        for (const BufferSlice& message : m_cache) {
+            send(subscriber, *stream, message);
+        }
+    }
+
+    void BroadcastHub::unsubscribe(const Stream& stream)
+    {
+        auto iter = std::find_if(m_subscribers.begin(), m_subscribers.end(), [&stream](const SubscriberSharedPtr& subscriber)
+        {
+            return subscriber->stream.lock().get() == &stream;
+        });
+        if (iter != m_subscribers.end()) {
+            m_subscribers.erase(iter);
+        }
+    }
+
+    size_t BroadcastHub::subscriberCount() const
+    {
+        return m_subscribers.size();
+    }
+
+    void BroadcastHub::publish(const BufferSlice& message)
+    {
+        prune();
+        if (m_options.lateJoinMessages) {
+            m_cache.push_back(message);
+            while (m_cache.size() > m_options.lateJoinMessages) {
+                m_cache.pop_front();
+            }
+        }
+        for (size_t index = 0; index < m_subscribers.size(); ++index) {
+            // copied, a completing write might unsubscribe
+            SubscriberSharedPtr subscriber = m_subscribers[index];
+            StreamSharedPtr stream = subscriber->stream.lock();
+            if (!stream) {
+                continue;
+            }
+            if (m_options.maxLagMessages && subscriber->stats.lagMessages >= m_options.maxLagMessages) {
+                ++subscriber->stats.skippedMessages;
+                continue;
+            }
+            send(subscriber, *stream, message);
+        }
+    }
+
+    void BroadcastHub::publish(const boost::asio::const_buffer& data)
+    {
+        std::shared_ptr < uint8_t > memory(new uint8_t[data.size()], std::default_delete < uint8_t[] >());
+        memcpy(memory.get(), data.data(), data.size());
+        publish(BufferSlice(memory, memory.get(), data.size()));
+    }
+
+    BroadcastSubscriberStats BroadcastHub::stats(const Stream& stream) const
+    {
+        for (const auto& subscriber : m_subscribers) {
+            if (subscriber->stream.lock().get() == &stream) {
+                return subscriber->stats;
+            }
+        }
+        return BroadcastSubscriberStats();
+    }
+
+    size_t BroadcastHub::maxLagMessages() const
+    {
+        size_t lag = 0;
+        for (const auto& subscriber : m_subscribers) {
+            lag = std::max(lag, subscriber->stats.lagMessages);
+        }
+        return lag;
+    }
+
+    void BroadcastHub::send(const SubscriberSharedPtr& subscriber, Stream& stream, const BufferSlice& message)
+    {
+        ++subscriber->stats.lagMessages;
+        subscriber->stats.lagBytes += message.size();
+        // the slice keeps the memory alive until the stream wrote it
+        // byte oriented streams combine queued messages into gather writes, websocket streams send each one as a message of its own
+        stream.asyncWrite(message.buffer(), [subscriber, message](const boost::system::error_code& ec, std::size_t)
+        {
+            --subscriber->stats.lagMessages;
+            subscriber->stats.lagBytes -= message.size();
+            if (ec == boost::asio::error::no_buffer_space) {
+                // dropped by the overflow policy of the stream, the subscriber is just slow
+                ++subscriber->stats.skippedMessages;
+                return;
+            }
+            if (ec) {
+                subscriber->failed = true;
+                return;
+            }
+            ++subscriber->stats.sentMessages;
+        });
+    }
+
+    void BroadcastHub::prune()
+    {
+        auto gone = [](const SubscriberSharedPtr& subscriber)
+        {
+            return subscriber->failed || subscriber->stream.expired();
+        };
+        m_subscribers.erase(std::remove_if(m_subscribers.begin(), m_subscribers.end(), gone), m_subscribers.end());
+    }
+}
@@ -0,0 +1,72 @@
+#include "stream/BufferPool.hpp"
+
+namespace daq::stream {
+    const size_t BufferPool::DefaultChunkSize = 64 * 1024;
+    const size_t BufferPool::DefaultMaxPooledChunks = 64;
+
+    BufferPoolSharedPtr BufferPool::create(size_t chunkSize, size_t maxPooledChunks)
+    {
+        return BufferPoolSharedPtr(new BufferPool(chunkSize, maxPooledChunks));
+    }
+
+    BufferPool::BufferPool(size_t chunkSize, size_t maxPooledChunks)
+        : m_chunkSize(chunkSize)
+        , m_maxPooledChunks(maxPooledChunks)
+    {
+        m_chunks.reserve(m_maxPooledChunks);
+    }
+
+    BufferPool::~BufferPool()
+    {
+        for (uint8_t* chunk : m_chunks) {
+            delete[] chunk;
+        }
+    }
+
+    std::shared_ptr < uint8_t > BufferPool::acquire(size_t size)
+    {
+        if (size > m_chunkSize) {
+            return std::shared_ptr < uint8_t >(new uint8_t[size], std::default_delete < uint8_t[] >());
+        }
+
+        uint8_t* chunk = nullptr;
+        {
+            std::lock_guard < std::mutex > lock(m_mutex);
+            if (!m_chunks.empty()) {
+                chunk = m_chunks.back();
+                m_chunks.pop_back();
+            }
+        }
+        if (!chunk) {
+            chunk = new uint8_t[m_chunkSize];
+        }
+        // the deleter keeps the pool alive until all chunks are released
+        BufferPoolSharedPtr self = shared_from_this();
+        return std::shared_ptr < uint8_t >(chunk, [self](uint8_t* released) {
+            self->release(released);
+        });
+    }
+
+    void BufferPool::release(uint8_t* chunk)
+    {
+        {
+            std::lock_guard < std::mutex > lock(m_mutex);
+            if (m_chunks.size() < m_maxPooledChunks) {
+                m_chunks.push_back(chunk);
+                return;
+            }
+        }
+        delete[] chunk;
+    }
+
+    size_t BufferPool::chunkSize() const
+    {
+        return m_chunkSize;
+    }
+
+    size_t BufferPool::pooledChunks() const
+    {
+        std::lock_guard < std::mutex > lock(m_mutex);
+        return m_chunks.size();
+    }
+}
@@ -0,0 +1,181 @@
+#include <algorithm>
+
+#include "stream/EgressScheduler.hpp"
+#include "stream/Stream.hpp"
+
+namespace daq::stream {
+    EgressScheduler::EgressScheduler(boost::asio::io_context& ioContext, const EgressSchedulerOptions& options)
+        : m_timer(ioContext)
+        , m_budget(options.bytesPerSecond, options.burstBytes)
+        , m_writesInProgress(0)
+        , m_timerPending(false)
+        , m_dispatching(false)
+    {
+        setOptions(options);
+    }
+
+    EgressScheduler::~EgressScheduler()
+    {
+        m_timer.cancel();
+    }
+
+    void EgressScheduler::setOptions(const EgressSchedulerOptions& options)
+    {
+        m_options = options;
+        m_options.quantum = std::max < size_t >(m_options.quantum, 1);
+        m_budget.setRate(m_options.bytesPerSecond, m_options.burstBytes);
+        // limits might have been raised
+        dispatch();
+    }
+
+    const EgressSchedulerOptions& EgressScheduler::options() const
+    {
+        return m_options;
+    }
+
+    void EgressScheduler::setWeight(const Stream& stream, size_t weight)
+    {
+        auto iter = m_entries.find(&stream);
+        if (iter != m_entries.end()) {
+            iter->second.weight = std::max < size_t >(weight, 1);
+        }
+    }
+
+    size_t EgressScheduler::weight(const Stream& stream) const
+    {
+        auto iter = m_entries.find(&stream);
+        if (iter == m_entries.end()) {
+            return 0;
+        }
+        return iter->second.weight;
+    }
+
+    uint64_t EgressScheduler::sentBytes(const Stream& stream) const
+    {
+        auto iter = m_entries.find(&stream);
+        if (iter == m_entries.end()) {
+            return 0;
+        }
+        return iter->second.sentBytes;
+    }
+
+    size_t EgressScheduler::waitingStreams() const
+    {
+        return m_waiting.size();
+    }
+
+    void EgressScheduler::attach(Stream& stream)
+    {
+        m_entries.emplace(&stream, Entry());
+    }
+
+    void EgressScheduler::detach(Stream& stream)
+    {
+        auto iter = m_entries.find(&stream);
+        if (iter == m_entries.end()) {
+            return;
+        }
+        bool writing = iter->second.writing;
+        if (iter->second.waiting) {
+            m_waiting.erase(std::find(m_waiting.begin(), m_waiting.end(), &stream));
+        }
+        m_entries.erase(iter);
+        if (writing) {
+            --m_writesInProgress;
+            dispatch();
+        }
+    }
+
+    void EgressScheduler::requestWrite(Stream& stream)
+    {
+        Entry& entry = m_entries[&stream];
+        if (entry.waiting) {
+            return;
+        }
+        bool continueTurn = false;
+        if (entry.writing) {
+            // the previous write completed, keep the turn while there is credit left
+            entry.writing = false;
+            --m_writesInProgress;
+            continueTurn = entry.deficit > 0;
+        }
+        entry.waiting = true;
+        if (continueTurn) {
+            m_waiting.push_front(&stream);
+        } else {
+            m_waiting.push_back(&stream);
+        }
+        dispatch();
+    }
+
+    void EgressScheduler::onWritten(Stream& stream)
+    {
+        auto iter = m_entries.find(&stream);
+        if (iter == m_entries.end() || !iter->second.writing) {
+            return;
+        }
+        iter->second.writing = false;
+        --m_writesInProgress;
+        dispatch();
+    }
+
+    void EgressScheduler::dispatch()
+    {
+        if (m_dispatching) {
+            return;
+        }
+        m_dispatching = true;
+        while (!m_waiting.empty()) {
+            if (m_options.maxConcurrentWrites && m_writesInProgress >= m_options.maxConcurrentWrites) {
+                break;
+            }
+            if (!m_budget.available()) {
+                waitForBudget();
+                break;
+            }
+
+            Stream* stream = m_waiting.front();
+            Entry& entry = m_entries[stream];
+            if (entry.deficit <= 0) {
+                entry.deficit += static_cast < int64_t >(m_options.quantum * entry.weight);
+                if (entry.deficit <= 0) {
+                    // still paying back a big write, next round
+                    m_waiting.pop_front();
+                    m_waiting.push_back(stream);
+                    continue;
+                }
+            }
+            m_waiting.pop_front();
+            entry.waiting = false;
+            entry.writing = true;
+            ++m_writesInProgress;
+            size_t bytes = stream->startWrite();
+            m_budget.consume(bytes);
+            // a transport completing inline may have destroyed the stream
+            auto iter = m_entries.find(stream);
+            if (iter != m_entries.end()) {
+                iter->second.deficit -= static_cast < int64_t >(bytes);
+                iter->second.sentBytes += bytes;
+            }
+        }
+        m_dispatching = false;
+    }
+
+    void EgressScheduler::waitForBudget()
+    {
+        if (m_timerPending) {
+            return;
+        }
+        m_timerPending = true;
+        m_timer.expires_after(m_budget.delay());
+        m_timer.async_wait([this](const boost::system::error_code& ec)
+        {
+            if (ec) {
+                // scheduler is gone
+                return;
+            }
+            m_timerPending = false;
+            dispatch();
+        });
+    }
+}
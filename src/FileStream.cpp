@@ -9,8 +9,9 @@
 
 namespace daq::stream {
     /// \param writable If true, new file will be created. Existing one will be replaced!
-    FileStream::FileStream(boost::asio::io_context& ioc, const std::string &fileName, bool writable)
-        : m_ioc(ioc)
+    FileStream::FileStream(boost::asio::io_context& ioc, const std::string &fileName, bool writable, ReceiveBufferType receiveBufferType)
+        : Stream(receiveBufferType)
+        , m_ioc(ioc)
         , m_fileName(fileName)
         , m_fileStream(ioc)
         , m_writable(writable)
@@ -19,7 +20,7 @@ namespace daq::stream {
 
     void FileStream::asyncInit(CompletionCb initCb)
     {
-        m_initCompletionCb = initCb;
+        m_initCompletionCb = std::move(initCb);
         boost::system::error_code ec = init();
         // ec is on stack, provide it by value!
         auto completionCb = [this, ec]()
@@ -95,22 +96,41 @@ namespace daq::stream {
 
     void FileStream::asyncReadAtLeast(std::size_t bytesToRead, ReadCompletionCb readCompletionCb)
     {
-        boost::asio::async_read(m_fileStream, m_buffer, boost::asio::transfer_at_least(bytesToRead), readCompletionCb);
+        boost::asio::async_read(m_fileStream, receiveBuffer(), transferAtLeast(bytesToRead), readHandler(std::move(readCompletionCb)));
     }
 
     size_t FileStream::readAtLeast(std::size_t bytesToRead, boost::system::error_code &ec)
     {
-        return boost::asio::read(m_fileStream, m_buffer, boost::asio::transfer_at_least(bytesToRead), ec);
+        return boost::asio::read(m_fileStream, receiveBuffer(), transferAtLeast(bytesToRead), ec);
     }
 
-    void FileStream::asyncWrite(const boost::asio::const_buffer& data, WriteCompletionCb writeCompletionCb)
+    void FileStream::asyncWaitTransportReadable(CompletionCb waitCb)
     {
-        boost::asio::async_write(m_fileStream, data, writeCompletionCb);
+        auto completionCb = [waitCb = std::move(waitCb)](const boost::system::error_code& ec)
+        {
+            // epoll does not support regular files. They never block, hence are always readable.
+            if (ec == boost::asio::error::operation_not_supported) {
+                waitCb(boost::system::error_code());
+                return;
+            }
+            waitCb(ec);
+        };
+        m_fileStream.async_wait(boost::asio::posix::stream_descriptor::wait_read, readHandler(std::move(completionCb)));
+    }
+
+    size_t FileStream::readSomeInto(const boost::asio::mutable_buffer& buffer, boost::system::error_code& ec)
+    {
+        return m_fileStream.read_some(buffer, ec);
+    }
+
+    void FileStream::asyncReadAllInto(const MutableBufferView& buffers, ReadCompletionCb readCb)
+    {
+        boost::asio::async_read(m_fileStream, buffers, readHandler(std::move(readCb)));
     }
 
-    void FileStream::asyncWrite(const std::vector<boost::asio::const_buffer>& data, WriteCompletionCb writeCompletionCb)
+    void FileStream::asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb)
     {
-        boost::asio::async_write(m_fileStream, data, writeCompletionCb);
+        boost::asio::async_write(m_fileStream, data, writeHandler(std::move(writeCompletionCb)));
     }
 
     size_t FileStream::write(const boost::asio::const_buffer &data, boost::system::error_code &ec)
@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <limits>
+
+#include <boost/asio/error.hpp>
+
+#include "stream/FramedStream.hpp"
+
+namespace daq::stream {
+    static const size_t MaxVarintSize = 10;
+
+    static_assert(FramedStream::MaxHeaderSize <= WriteQueue::MaxPrefixSize, "the header has to fit into the write queue");
+
+    static size_t lengthFieldSize(FrameHeaderFormat::Length length)
+    {
+        switch (length) {
+        case FrameHeaderFormat::Length::UInt8:
+            return 1;
+        case FrameHeaderFormat::Length::UInt16:
+            return 2;
+        case FrameHeaderFormat::Length::UInt32:
+            return 4;
+        case FrameHeaderFormat::Length::UInt64:
+        case FrameHeaderFormat::Length::Varint:
+            break;
+        }
+        return 8;
+    }
+
+    /// A payload has to fit into the length field and must not be rejected by the receiver
+    static bool payloadFits(const FrameHeaderFormat& format, uint64_t payloadSize)
+    {
+        if (payloadSize > format.maxPayloadSize) {
+            return false;
+        }
+        size_t fieldSize = lengthFieldSize(format.length);
+        if (format.length == FrameHeaderFormat::Length::Varint || fieldSize >= sizeof(uint64_t)) {
+            return true;
+        }
+        return (payloadSize >> (8 * fieldSize)) == 0;
+    }
+
+    FramedStream::FramedStream(StreamSharedPtr stream, const FrameHeaderFormat& format)
+        : m_stream(std::move(stream))
+        , m_format(format)
+    {
+        // the frame length including the header has to fit into size_t and must not be taken for Stream::InvalidFrameLength
+        m_format.maxPayloadSize = std::min < uint64_t >(m_format.maxPayloadSize, std::numeric_limits < size_t >::max() - MaxHeaderSize - 1);
+    }
+
+    const StreamSharedPtr& FramedStream::stream() const
+    {
+        return m_stream;
+    }
+
+    const FrameHeaderFormat& FramedStream::format() const
+    {
+        return m_format;
+    }
+
+    size_t FramedStream::encodeHeader(const FrameHeaderFormat& format, uint8_t type, uint64_t payloadSize, uint8_t* header)
+    {
+        size_t headerSize = 0;
+        if (format.length == FrameHeaderFormat::Length::Varint) {
+            do {
+                uint8_t group = payloadSize & 0x7f;
+                payloadSize >>= 7;
+                if (payloadSize) {
+                    group |= 0x80;
+                }
+                header[headerSize++] = group;
+            } while (payloadSize);
+        } else {
+            headerSize = lengthFieldSize(format.length);
+            for (size_t index = 0; index < headerSize; ++index) {
+                uint8_t value = static_cast < uint8_t >(payloadSize >> (8 * index));
+                if (format.byteOrder == FrameHeaderFormat::ByteOrder::BigEndian) {
+                    header[headerSize - 1 - index] = value;
+                } else {
+                    header[index] = value;
+                }
+            }
+        }
+
+        if (format.typeByte) {
+            header[headerSize++] = type;
+        }
+        return headerSize;
+    }
+
+    size_t FramedStream::decodeHeader(const FrameHeaderFormat& format, const uint8_t* data, size_t size, uint64_t& payloadSize, uint8_t& type)
+    {
+        size_t headerSize = 0;
+        payloadSize = 0;
+        if (format.length == FrameHeaderFormat::Length::Varint) {
+            bool complete = false;
+            while (headerSize < size && headerSize < MaxVarintSize) {
+                uint8_t group = data[headerSize];
+                if (headerSize == MaxVarintSize - 1 && group > 1) {
+                    // the last group holds only the highest bit of 64
+                    return Stream::InvalidFrameLength;
+                }
+                payloadSize |= static_cast < uint64_t >(group & 0x7f) << (7 * headerSize);
+                ++headerSize;
+                if ((group & 0x80) == 0) {
+                    complete = true;
+                    break;
+                }
+            }
+            if (!complete) {
+                return headerSize == MaxVarintSize ? Stream::InvalidFrameLength : 0;
+            }
+        } else {
+            headerSize = lengthFieldSize(format.length);
+            if (size < headerSize) {
+                return 0;
+            }
+            for (size_t index = 0; index < headerSize; ++index) {
+                uint8_t value;
+                if (format.byteOrder == FrameHeaderFormat::ByteOrder::BigEndian) {
+                    value = data[headerSize - 1 - index];
+                } else {
+                    value = data[index];
+                }
+                payloadSize |= static_cast < uint64_t >(value) << (8 * index);
+            }
+        }
+
+        type = 0;
+        if (format.typeByte) {
+            if (size <= headerSize) {
+                return 0;
+            }
+            type = data[headerSize++];
+        }
+        return headerSize;
+    }
+
+    size_t FramedStream::frameLength(const uint8_t* data, size_t size) const
+    {
+        uint64_t payloadSize;
+        uint8_t type;
+        size_t headerSize = decodeHeader(m_format, data, size, payloadSize, type);
+        if (headerSize == 0 || headerSize == Stream::InvalidFrameLength) {
+            return headerSize;
+        }
+        if (payloadSize > m_format.maxPayloadSize) {
+            return Stream::InvalidFrameLength;
+        }
+        return headerSize + static_cast < size_t >(payloadSize);
+    }
+
+    void FramedStream::asyncReadMessages(MessagesCb messagesCb)
+    {
+        m_messagesCb = std::move(messagesCb);
+        auto framesCb = [this](const boost::system::error_code& ec, const ConstBufferView& frames)
+        {
+            onFrames(ec, frames);
+        };
+        // small enough to be stored without allocating memory
+        auto frameLengthExtractor = [this](const uint8_t* data, size_t size)
+        {
+            return frameLength(data, size);
+        };
+        m_stream->asyncReadFrames(frameLengthExtractor, framesCb);
+    }
+
+    void FramedStream::onFrames(const boost::system::error_code& ec, const ConstBufferView& frames)
+    {
+        m_messages.clear();
+        for (const boost::asio::const_buffer& frame : frames) {
+            const uint8_t* data = static_cast < const uint8_t* >(frame.data());
+            uint64_t payloadSize;
+            Message message;
+            size_t headerSize = decodeHeader(m_format, data, frame.size(), payloadSize, message.type);
+            message.payload = boost::asio::const_buffer(data + headerSize, frame.size() - headerSize);
+            m_messages.push_back(message);
+        }
+        // messagesCb might request the next messages, which replaces m_messagesCb
+        MessagesCb messagesCb = std::move(m_messagesCb);
+        messagesCb(ec, m_messages);
+    }
+
+    void FramedStream::asyncWriteMessage(const boost::asio::const_buffer& payload, Stream::WriteCompletionCb writeCompletionCb)
+    {
+        asyncWriteMessage(0, payload, std::move(writeCompletionCb));
+    }
+
+    void FramedStream::asyncWriteMessage(uint8_t type, const boost::asio::const_buffer& payload, Stream::WriteCompletionCb writeCompletionCb)
+    {
+        if (!payloadFits(m_format, payload.size())) {
+            writeCompletionCb(boost::asio::error::message_size, 0);
+            return;
+        }
+        // the header is copied into the queued write, writes may be queued while others are pending
+        std::array < uint8_t, MaxHeaderSize > header;
+        size_t headerSize = encodeHeader(m_format, type, payload.size(), header.data());
+        m_stream->asyncWritePrefixed(boost::asio::const_buffer(header.data(), headerSize), payload, std::move(writeCompletionCb));
+    }
+
+    size_t FramedStream::writeMessage(uint8_t type, const boost::asio::const_buffer& payload, boost::system::error_code& ec)
+    {
+        if (!payloadFits(m_format, payload.size())) {
+            ec = boost::asio::error::message_size;
+            return 0;
+        }
+        std::array < uint8_t, MaxHeaderSize > header;
+        size_t headerSize = encodeHeader(m_format, type, payload.size(), header.data());
+        ConstBufferVector buffers = { boost::asio::const_buffer(header.data(), headerSize), payload };
+        return m_stream->write(buffers, ec);
+    }
+}
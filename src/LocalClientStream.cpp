@@ -8,8 +8,8 @@
 #include "stream/LocalClientStream.hpp"
 
 namespace daq::stream {
-    LocalClientStream::LocalClientStream(boost::asio::io_context& ioc, const std::string &endPointFile)
-        : LocalStream(ioc)
+    LocalClientStream::LocalClientStream(boost::asio::io_context& ioc, const std::string &endPointFile, ReceiveBufferType receiveBufferType)
+        : LocalStream(ioc, receiveBufferType)
         , m_ioc(ioc)
         , m_endpointFile(endPointFile)
     {
@@ -17,7 +17,7 @@ namespace daq::stream {
 
     void LocalClientStream::asyncInit(CompletionCb completionCb)
     {
-        m_initCompletionCb = completionCb;
+        m_initCompletionCb = std::move(completionCb);
         if (m_socket.is_open()) {
             auto completionCb = [this]()
             {
@@ -31,7 +31,10 @@ namespace daq::stream {
         // See man page (man 7 unix) for details
         m_socket.async_connect(
                     boost::asio::local::stream_protocol::endpoint(std::string("\0", 1) + std::string(m_endpointFile)),
-                    std::bind(m_initCompletionCb, std::placeholders::_1));
+                    [this](const boost::system::error_code& ec)
+                    {
+                        m_initCompletionCb(ec);
+                    });
     }
 
     boost::system::error_code LocalClientStream::init()
@@ -34,6 +34,7 @@ namespace daq::stream {
     {
         syslog(LOG_INFO, "Stopping local server");
         m_localAcceptor.close();
+        onStop();
     }
 
     
@@ -50,7 +51,14 @@ namespace daq::stream {
             return;
         }
         // A new stream is created and initialized asynchronously. On completion the final callback provides the error code and the stream itself.
-        auto stream = std::make_shared < LocalServerStream > (std::move(streamSocket));
+        auto stream = std::make_shared < LocalServerStream > (std::move(streamSocket), receiveBufferType());
+        addStream(stream);
+        if (receiveBufferPool()) {
+            stream->setReceiveBufferPool(receiveBufferPool());
+        }
+        if (m_egressScheduler) {
+            stream->setEgressScheduler(m_egressScheduler);
+        }
         auto completionCb = [&, stream](const boost::system::error_code& ec)
         {
             if(ec) {
@@ -8,8 +8,8 @@
 #include "stream/LocalServerStream.hpp"
 
 namespace daq::stream {
-    LocalServerStream::LocalServerStream(boost::asio::local::stream_protocol::socket&& socket)
-        : LocalStream(std::move(socket))
+    LocalServerStream::LocalServerStream(boost::asio::local::stream_protocol::socket&& socket, ReceiveBufferType receiveBufferType)
+        : LocalStream(std::move(socket), receiveBufferType)
     {
     }
 
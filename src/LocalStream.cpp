@@ -10,35 +10,47 @@
 #include "stream/LocalStream.hpp"
 
 namespace daq::stream {
-    LocalStream::LocalStream(boost::asio::io_context& ioc)
-        : m_socket(ioc)
+    LocalStream::LocalStream(boost::asio::io_context& ioc, ReceiveBufferType receiveBufferType)
+        : Stream(receiveBufferType)
+        , m_socket(ioc)
     {
     }
     
-    LocalStream::LocalStream(boost::asio::local::stream_protocol::socket&& socket)
-        : m_socket(std::move(socket))
+    LocalStream::LocalStream(boost::asio::local::stream_protocol::socket&& socket, ReceiveBufferType receiveBufferType)
+        : Stream(receiveBufferType)
+        , m_socket(std::move(socket))
     {
     }
 
 
     void LocalStream::asyncReadAtLeast(std::size_t bytesToRead, ReadCompletionCb readCompletionCb)
     {
-        boost::asio::async_read(m_socket, m_buffer, boost::asio::transfer_at_least(bytesToRead), readCompletionCb);
+        boost::asio::async_read(m_socket, receiveBuffer(), transferAtLeast(bytesToRead), readHandler(std::move(readCompletionCb)));
     }
 
     size_t LocalStream::readAtLeast(std::size_t bytesToRead, boost::system::error_code &ec)
     {
-        return boost::asio::read(m_socket, m_buffer, boost::asio::transfer_at_least(bytesToRead), ec);
+        return boost::asio::read(m_socket, receiveBuffer(), transferAtLeast(bytesToRead), ec);
     }
 
-    void LocalStream::asyncWrite(const boost::asio::const_buffer& data, WriteCompletionCb writeCompletionCb)
+    void LocalStream::asyncWaitTransportReadable(CompletionCb waitCb)
     {
-        boost::asio::async_write(m_socket, data, writeCompletionCb);
+        m_socket.async_wait(boost::asio::local::stream_protocol::socket::wait_read, readHandler(std::move(waitCb)));
     }
 
-    void LocalStream::asyncWrite(const ConstBufferVector& data, WriteCompletionCb writeCompletionCb)
+    size_t LocalStream::readSomeInto(const boost::asio::mutable_buffer& buffer, boost::system::error_code& ec)
     {
-        boost::asio::async_write(m_socket, data, writeCompletionCb);
+        return m_socket.read_some(buffer, ec);
+    }
+
+    void LocalStream::asyncReadAllInto(const MutableBufferView& buffers, ReadCompletionCb readCb)
+    {
+        boost::asio::async_read(m_socket, buffers, readHandler(std::move(readCb)));
+    }
+
+    void LocalStream::asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb)
+    {
+        boost::asio::async_write(m_socket, data, writeHandler(std::move(writeCompletionCb)));
     }
 
     size_t LocalStream::write(const boost::asio::const_buffer &data, boost::system::error_code &ec)
@@ -0,0 +1,56 @@
+#include <string>
+
+#include <boost/asio/local/stream_protocol.hpp>
+
+#include "stream/LocalWebsocketClientStream.hpp"
+
+namespace daq::stream {
+    /// Sent as host of the websocket upgrade request
+    static const std::string LocalHost = "localhost";
+
+    LocalWebsocketClientStream::LocalWebsocketClientStream(boost::asio::io_context& ioc, const std::string& endPointFile, const std::string& path, ReceiveBufferType receiveBufferType)
+        : WebsocketClientStream(ioc, LocalHost, "", path, receiveBufferType)
+        , m_endpointFile(endPointFile)
+    {
+    }
+
+    void LocalWebsocketClientStream::asyncInit(CompletionCb completionCb)
+    {
+        m_initCompletionCb = std::move(completionCb);
+        if (isOpen()) {
+            auto completion = [this]()
+            {
+                m_initCompletionCb(boost::system::error_code());
+            };
+            m_ioc.dispatch(completion);
+            return;
+        }
+        asyncConnect(endpoints());
+    }
+
+    boost::system::error_code LocalWebsocketClientStream::init()
+    {
+        if (isOpen()) {
+            return boost::system::error_code();
+        }
+        return connect(endpoints());
+    }
+
+    std::string LocalWebsocketClientStream::endPointUrl() const
+    {
+        return m_endpointFile;
+    }
+
+    std::string LocalWebsocketClientStream::remoteHost() const
+    {
+        return "";
+    }
+
+    LocalWebsocketClientStream::Endpoints LocalWebsocketClientStream::endpoints() const
+    {
+        // placing a '\0' at the beginning of the endpoint name creates an abstract unix domain socket.
+        // See man page (man 7 unix) for details
+        boost::asio::local::stream_protocol::endpoint endpoint(std::string("\0", 1) + m_endpointFile);
+        return Endpoints{ endpoint };
+    }
+}
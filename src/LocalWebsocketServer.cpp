@@ -0,0 +1,53 @@
+#include <functional>
+
+#include <boost/asio/local/stream_protocol.hpp>
+
+#include "utils/syslog.h"
+#include "stream/LocalWebsocketServer.hpp"
+
+namespace daq::stream {
+    LocalWebsocketServer::LocalWebsocketServer(boost::asio::io_context& readerIoContext, NewStreamCb newStreamCb, const std::string& localEndpointFile)
+        : WebsocketServer(readerIoContext, newStreamCb)
+        , m_localEndpointFile(localEndpointFile)
+        // placing a '\0' at the beginning of the endpoint name creates an abstract unix domain socket.
+        , m_localAcceptor(readerIoContext, std::string("\0", 1) + std::string(localEndpointFile))
+    {
+    }
+
+    LocalWebsocketServer::~LocalWebsocketServer()
+    {
+        stop();
+    }
+
+    int LocalWebsocketServer::start()
+    {
+        syslog(LOG_INFO, "Starting local websocket server");
+        onStart();
+        startAccept();
+        return 0;
+    }
+
+    void LocalWebsocketServer::stop()
+    {
+        syslog(LOG_INFO, "Stopping local websocket server");
+        m_localAcceptor.close();
+        // closes the streams if requested
+        WebsocketServer::stop();
+    }
+
+    void LocalWebsocketServer::startAccept()
+    {
+        using namespace std::placeholders;
+        m_localAcceptor.async_accept(std::bind(&LocalWebsocketServer::onAccept, this, _1, _2));
+    }
+
+    void LocalWebsocketServer::onAccept(const boost::system::error_code& ec, boost::asio::local::stream_protocol::socket&& streamSocket)
+    {
+        if (ec) {
+            // also happens when stopping!
+            return;
+        }
+        upgrade(boost::asio::generic::stream_protocol::socket(std::move(streamSocket)));
+        startAccept();
+    }
+}
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <boost/system/system_error.hpp>
+
+#include "stream/MirroredRingBuffer.hpp"
+
+namespace daq::stream {
+    const size_t MirroredRingBuffer::DefaultCapacity = 1024 * 1024;
+
+    static size_t roundUpToPageSize(size_t size)
+    {
+        static const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        if (size == 0) {
+            return pageSize;
+        }
+        return ((size + pageSize - 1) / pageSize) * pageSize;
+    }
+
+    static boost::system::system_error systemError(const char* what)
+    {
+        return boost::system::system_error(errno, boost::system::generic_category(), what);
+    }
+
+    /// \return File descriptor of an anonymous shared memory object
+    static int createMemoryFile()
+    {
+#ifdef __linux__
+        int fd = ::memfd_create("stream-ring", MFD_CLOEXEC);
+        if (fd == -1) {
+            throw systemError("memfd_create");
+        }
+#else
+        // no memfd on this platform. Use a shared memory object that is unlinked immediately.
+        static std::atomic<unsigned int> counter(0);
+        std::string name = "/stream-ring-" + std::to_string(::getpid()) + "-" + std::to_string(counter++);
+        int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd == -1) {
+            throw systemError("shm_open");
+        }
+        ::shm_unlink(name.c_str());
+#endif
+        return fd;
+    }
+
+    MirroredRingBuffer::MirroredRingBuffer(size_t capacity)
+        : m_memory(nullptr)
+        , m_capacity(roundUpToPageSize(capacity))
+        , m_readPos(0)
+        , m_size(0)
+        , m_prepared(0)
+    {
+        m_memory = map(m_capacity);
+    }
+
+    MirroredRingBuffer::~MirroredRingBuffer()
+    {
+        unmap(m_memory, m_capacity);
+    }
+
+    uint8_t* MirroredRingBuffer::map(size_t capacity)
+    {
+        int fd = createMemoryFile();
+        if (::ftruncate(fd, static_cast<off_t>(capacity)) == -1) {
+            auto error = systemError("ftruncate");
+            ::close(fd);
+            throw error;
+        }
+
+        // reserve address space for both mappings, then place the file twice into it.
+        void* reserved = ::mmap(nullptr, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (reserved == MAP_FAILED) {
+            auto error = systemError("mmap");
+            ::close(fd);
+            throw error;
+        }
+
+        uint8_t* memory = static_cast<uint8_t*>(reserved);
+        for (size_t offset : { size_t(0), capacity }) {
+            void* mapped = ::mmap(memory + offset, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+            if (mapped == MAP_FAILED) {
+                auto error = systemError("mmap");
+                ::munmap(reserved, 2 * capacity);
+                ::close(fd);
+                throw error;
+            }
+        }
+        // the mappings keep the memory alive
+        ::close(fd);
+        return memory;
+    }
+
+    void MirroredRingBuffer::unmap(uint8_t* memory, size_t capacity)
+    {
+        if (memory) {
+            ::munmap(memory, 2 * capacity);
+        }
+    }
+
+    void MirroredRingBuffer::grow(size_t requiredCapacity)
+    {
+        size_t newCapacity = roundUpToPageSize(std::max(requiredCapacity, 2 * m_capacity));
+        uint8_t* newMemory = map(newCapacity);
+        memcpy(newMemory, m_memory + m_readPos, m_size);
+        unmap(m_memory, m_capacity);
+        m_memory = newMemory;
+        m_capacity = newCapacity;
+        m_readPos = 0;
+    }
+
+    size_t MirroredRingBuffer::size() const
+    {
+        return m_size;
+    }
+
+    size_t MirroredRingBuffer::capacity() const
+    {
+        return m_capacity;
+    }
+
+    size_t MirroredRingBuffer::maxSize() const
+    {
+        return std::numeric_limits<size_t>::max() / 4;
+    }
+
+    const uint8_t* MirroredRingBuffer::data() const
+    {
+        return m_memory + m_readPos;
+    }
+
+    boost::asio::mutable_buffer MirroredRingBuffer::prepare(size_t size)
+    {
+        if (size > m_capacity - m_size) {
+            grow(m_size + size);
+        }
+        m_prepared = size;
+        // thanks to the second mapping this is contiguous even when wrapping around the end of the ring
+        return boost::asio::mutable_buffer(m_memory + m_readPos + m_size, size);
+    }
+
+    void MirroredRingBuffer::commit(size_t size)
+    {
+        m_size += std::min(size, m_prepared);
+        m_prepared = 0;
+    }
+
+    void MirroredRingBuffer::consume(size_t size)
+    {
+        size = std::min(size, m_size);
+        m_size -= size;
+        if (m_size == 0) {
+            // start over at the beginning to stay within the same pages
+            m_readPos = 0;
+        } else {
+            m_readPos = (m_readPos + size) % m_capacity;
+        }
+    }
+}
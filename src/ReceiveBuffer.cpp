@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "stream/ReceiveBuffer.hpp"
+
+namespace daq::stream {
+    ReadSizer::ReadSizer()
+        : m_currentReadSize(m_policy.minReadSize)
+        , m_prepared(0)
+        , m_limit(std::numeric_limits < size_t >::max())
+    {
+    }
+
+    void ReadSizer::setPolicy(const ReadSizePolicy& policy)
+    {
+        m_policy = policy;
+        m_policy.minReadSize = std::max < size_t > (m_policy.minReadSize, 1);
+        m_policy.maxReadSize = std::max(m_policy.maxReadSize, m_policy.minReadSize);
+        m_currentReadSize = m_policy.minReadSize;
+    }
+
+    const ReadSizePolicy& ReadSizer::policy() const
+    {
+        return m_policy;
+    }
+
+    size_t ReadSizer::nextReadSize(size_t freeCapacity) const
+    {
+        if (m_policy.adaptive) {
+            return std::min(m_currentReadSize, m_limit);
+        }
+        return std::min({ std::max(m_policy.minReadSize, freeCapacity), m_policy.maxReadSize, m_limit });
+    }
+
+    size_t ReadSizer::maxReadSize() const
+    {
+        if (m_policy.adaptive) {
+            return std::min(m_currentReadSize, m_limit);
+        }
+        return std::min(m_policy.maxReadSize, m_limit);
+    }
+
+    void ReadSizer::setLimit(size_t limit)
+    {
+        m_limit = std::max < size_t >(limit, 1);
+    }
+
+    void ReadSizer::onPrepare(size_t prepared)
+    {
+        m_prepared = prepared;
+    }
+
+    void ReadSizer::onCommit(size_t bytesRead)
+    {
+        if (!m_policy.adaptive || m_prepared == 0) {
+            return;
+        }
+        if (bytesRead >= m_prepared) {
+            // there is probably more waiting to be read
+            m_currentReadSize = std::min(m_currentReadSize * 2, m_policy.maxReadSize);
+        } else if (bytesRead < m_prepared / 4) {
+            m_currentReadSize = std::max(m_currentReadSize / 2, m_policy.minReadSize);
+        }
+        m_prepared = 0;
+    }
+
+    BufferSlice ReceiveBuffer::detach(size_t size)
+    {
+        size = std::min(size, this->size());
+        std::shared_ptr < uint8_t > memory(new uint8_t[size], std::default_delete < uint8_t[] >());
+        memcpy(memory.get(), data(), size);
+        consume(size);
+        return BufferSlice(memory, memory.get(), size);
+    }
+
+    StreambufReceiveBuffer::StreambufReceiveBuffer(boost::asio::streambuf& streambuf)
+        : m_streambuf(streambuf)
+    {
+    }
+
+    size_t StreambufReceiveBuffer::size() const
+    {
+        return m_streambuf.size();
+    }
+
+    size_t StreambufReceiveBuffer::capacity() const
+    {
+        return m_streambuf.capacity();
+    }
+
+    size_t StreambufReceiveBuffer::maxSize() const
+    {
+        return m_streambuf.max_size();
+    }
+
+    const uint8_t* StreambufReceiveBuffer::data() const
+    {
+        return boost::asio::buffer_cast<const uint8_t*>(m_streambuf.data());
+    }
+
+    boost::asio::mutable_buffer StreambufReceiveBuffer::prepare(size_t size)
+    {
+        return m_streambuf.prepare(size);
+    }
+
+    void StreambufReceiveBuffer::commit(size_t size)
+    {
+        m_streambuf.commit(size);
+    }
+
+    void StreambufReceiveBuffer::consume(size_t size)
+    {
+        m_streambuf.consume(size);
+    }
+
+    PooledReceiveBuffer::PooledReceiveBuffer(BufferPoolSharedPtr pool)
+        : m_pool(std::move(pool))
+        , m_chunk(m_pool->acquire(m_pool->chunkSize()))
+        , m_chunkSize(m_pool->chunkSize())
+        , m_readPos(0)
+        , m_size(0)
+        , m_prepared(0)
+        , m_detached(false)
+    {
+    }
+
+    void PooledReceiveBuffer::setPool(BufferPoolSharedPtr pool)
+    {
+        m_pool = std::move(pool);
+        changeChunk(0);
+    }
+
+    size_t PooledReceiveBuffer::size() const
+    {
+        return m_size;
+    }
+
+    size_t PooledReceiveBuffer::capacity() const
+    {
+        return m_chunkSize - m_readPos;
+    }
+
+    size_t PooledReceiveBuffer::maxSize() const
+    {
+        return std::numeric_limits<size_t>::max() / 4;
+    }
+
+    const uint8_t* PooledReceiveBuffer::data() const
+    {
+        return m_chunk.get() + m_readPos;
+    }
+
+    void PooledReceiveBuffer::makeRoom(size_t size)
+    {
+        // The reference count of a chunk tells nothing about memory accesses by the threads that released their slices.
+        // Reusing a chunk is left to the pool, whose lock orders the release before the next acquire.
+        if (!m_detached && m_size + size <= m_chunkSize) {
+            memmove(m_chunk.get(), m_chunk.get() + m_readPos, m_size);
+            m_readPos = 0;
+        } else {
+            changeChunk(size);
+        }
+    }
+
+    void PooledReceiveBuffer::changeChunk(size_t size)
+    {
+        size_t newChunkSize = std::max(m_size + size, m_pool->chunkSize());
+        std::shared_ptr < uint8_t > newChunk = m_pool->acquire(newChunkSize);
+        memcpy(newChunk.get(), m_chunk.get() + m_readPos, m_size);
+        m_chunk = std::move(newChunk);
+        m_chunkSize = newChunkSize;
+        m_readPos = 0;
+        m_detached = false;
+    }
+
+    boost::asio::mutable_buffer PooledReceiveBuffer::prepare(size_t size)
+    {
+        if (m_readPos + m_size + size > m_chunkSize) {
+            makeRoom(size);
+        }
+        m_prepared = size;
+        return boost::asio::mutable_buffer(m_chunk.get() + m_readPos + m_size, size);
+    }
+
+    void PooledReceiveBuffer::commit(size_t size)
+    {
+        m_size += std::min(size, m_prepared);
+        m_prepared = 0;
+    }
+
+    void PooledReceiveBuffer::consume(size_t size)
+    {
+        size = std::min(size, m_size);
+        m_size -= size;
+        if (m_size == 0 && !m_detached) {
+            m_readPos = 0;
+        } else {
+            m_readPos += size;
+        }
+    }
+
+    BufferSlice PooledReceiveBuffer::detach(size_t size)
+    {
+        size = std::min(size, m_size);
+        BufferSlice slice(m_chunk, data(), size);
+        m_detached = true;
+        consume(size);
+        return slice;
+    }
+}
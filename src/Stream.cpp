@@ -1,46 +1,245 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <boost/asio/error.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#ifndef _WIN32
+#include "stream/MirroredRingBuffer.hpp"
+#endif
 #include "stream/Stream.hpp"
+#include "stream/TokenBucket.hpp"
 
 namespace daq::stream {
 
+static std::unique_ptr < ReceiveBuffer > createReceiveBuffer(ReceiveBufferType receiveBufferType, boost::asio::streambuf& streambuf)
+{
+    switch (receiveBufferType) {
+    case ReceiveBufferType::MirroredRing:
+#ifndef _WIN32
+        return std::make_unique < MirroredRingBuffer >();
+#else
+        // not supported, fall back to the streambuf
+        break;
+#endif
+    case ReceiveBufferType::Pooled:
+        return std::make_unique < PooledReceiveBuffer >(BufferPool::create());
+    case ReceiveBufferType::Streambuf:
+        break;
+    }
+    return std::make_unique < StreambufReceiveBuffer >(streambuf);
+}
+
+struct Stream::RateLimiter {
+    explicit RateLimiter(boost::asio::io_context& ioContext)
+        : timer(ioContext)
+    {
+    }
+
+    TokenBucket bucket;
+    boost::asio::steady_timer timer;
+};
+
+const std::size_t Stream::InvalidFrameLength = std::numeric_limits < std::size_t >::max();
+
+Stream::Stream(ReceiveBufferType receiveBufferType)
+    : m_receiveBufferType(receiveBufferType)
+    , m_receiveBuffer(createReceiveBuffer(receiveBufferType, m_buffer))
+    , m_readHandlerMemory(std::make_shared < HandlerMemory >())
+    , m_writeHandlerMemory(std::make_shared < HandlerMemory >())
+    , m_maxInlineDepth(0)
+    , m_inlineDepth(0)
+    , m_runningDeferredReads(false)
+    , m_limitedReadSize(0)
+    , m_limitedBytesRead(0)
+    , m_writeLanes(1)
+    , m_writesInProgress(0)
+    , m_writingLane(0)
+    , m_chunkInProgress(0)
+    , m_writing(false)
+    , m_waitingForTurn(false)
+    , m_writingText(false)
+    , m_highWatermark(0)
+    , m_lowWatermark(0)
+    , m_aboveHighWatermark(false)
+    , m_droppedWrites(0)
+    , m_droppedBytes(0)
+    , m_completingDroppedWrites(false)
+    , m_destructionGuard(nullptr)
+    , m_deliveringFrames(false)
+    , m_framesRequested(false)
+    , m_deliveringMessage(false)
+    , m_messageRequested(false)
+{
+}
+
+Stream::~Stream()
+{
+    for (DestructionGuard* guard = m_destructionGuard; guard; guard = guard->outer) {
+        guard->destroyed = true;
+    }
+    if (m_egressScheduler) {
+        m_egressScheduler->detach(*this);
+    }
+}
+
+ReceiveBufferRef Stream::receiveBuffer()
+{
+    return ReceiveBufferRef(*m_receiveBuffer, m_readSizer);
+}
+
+ReadAtLeast Stream::transferAtLeast(std::size_t bytesToRead) const
+{
+    return ReadAtLeast(bytesToRead, m_readSizer);
+}
+
+size_t Stream::maxReadSize() const
+{
+    return m_readSizer.maxReadSize();
+}
+
+void Stream::setReadSizePolicy(const ReadSizePolicy& readSizePolicy)
+{
+    m_readSizer.setPolicy(readSizePolicy);
+}
+
+const ReadSizePolicy& Stream::readSizePolicy() const
+{
+    return m_readSizer.policy();
+}
+
 void Stream::copyDataAndConsume(void* dest, size_t size)
 {
-    memcpy(dest, boost::asio::buffer_cast<const void*>(m_buffer.data()), size);
-    m_buffer.consume(size);
+    memcpy(dest, m_receiveBuffer->data(), size);
+    m_receiveBuffer->consume(size);
+}
+
+BufferSlice Stream::detach(size_t size)
+{
+    return m_receiveBuffer->detach(size);
+}
+
+void Stream::setReceiveBufferPool(BufferPoolSharedPtr pool)
+{
+    if (m_receiveBufferType == ReceiveBufferType::Pooled) {
+        static_cast < PooledReceiveBuffer& >(*m_receiveBuffer).setPool(std::move(pool));
+    }
 }
 
 size_t Stream::size() const
 {
-    return m_buffer.size();
+    return m_receiveBuffer->size();
 }
 
 const uint8_t* Stream::data() const
 {
-    return boost::asio::buffer_cast<const uint8_t*>(m_buffer.data());
+    return m_receiveBuffer->data();
 }
 
 void Stream::consume(size_t size)
 {
-    m_buffer.consume(size);
+    m_receiveBuffer->consume(size);
+}
+
+void Stream::setMaxInlineDepth(size_t maxInlineDepth)
+{
+    m_maxInlineDepth = maxInlineDepth;
+}
+
+size_t Stream::maxInlineDepth() const
+{
+    return m_maxInlineDepth;
+}
+
+Stream::DestructionGuard::DestructionGuard(Stream& stream)
+    : stream(stream)
+    , outer(stream.m_destructionGuard)
+    , destroyed(false)
+{
+    stream.m_destructionGuard = this;
+}
+
+Stream::DestructionGuard::~DestructionGuard()
+{
+    if (!destroyed) {
+        stream.m_destructionGuard = outer;
+    }
+}
+
+bool Stream::enterInline()
+{
+    if (m_maxInlineDepth && m_inlineDepth >= m_maxInlineDepth) {
+        return false;
+    }
+    ++m_inlineDepth;
+    return true;
+}
+
+void Stream::leaveInline()
+{
+    --m_inlineDepth;
+    if (m_inlineDepth == 0 && !m_runningDeferredReads) {
+        runDeferredReads();
+    }
+}
+
+void Stream::runDeferredReads()
+{
+    // Trampoline: The stack got unwound to the outermost callback. Requests deferred at maximum depth are executed from here.
+    m_runningDeferredReads = true;
+    // a deferred callback might destroy the stream
+    DestructionGuard guard(*this);
+    while (m_deferredRead.readCb || m_deferredRead.readSomeCb) {
+        DeferredRead deferredRead = std::move(m_deferredRead);
+        m_deferredRead = DeferredRead();
+        if (deferredRead.readCb) {
+            asyncRead(std::move(deferredRead.readCb), deferredRead.size);
+        } else {
+            asyncReadSome(std::move(deferredRead.readSomeCb));
+        }
+        if (guard.destroyed) {
+            return;
+        }
+    }
+    m_runningDeferredReads = false;
 }
 
 void Stream::asyncRead(CompletionCb readCb, std::size_t size)
 {
-    size_t remainingData = m_buffer.size();
+    size_t remainingData = m_receiveBuffer->size();
     if (remainingData >= size)
     {
         // all required data is already in the buffer
+        if (!enterInline()) {
+            m_deferredRead.readCb = std::move(readCb);
+            m_deferredRead.size = size;
+            return;
+        }
+        DestructionGuard guard(*this);
         readCb(boost::system::error_code());
+        if (guard.destroyed) {
+            return;
+        }
+        leaveInline();
     }
     else
     {
         // read at least the required amount of data into the buffer
-        asyncReadAtLeast(size-remainingData, std::bind(readCb, std::placeholders::_1));
+        // Kept here, wrapping it into the handler would exceed the space of the handler and allocate memory
+        m_readCb = std::move(readCb);
+        auto completionCb = [this](const boost::system::error_code& ec, std::size_t)
+        {
+            CompletionCb readCb = std::move(m_readCb);
+            readCb(ec);
+        };
+        readTransport(size-remainingData, completionCb);
     }
 }
 
 boost::system::error_code Stream::read(std::size_t size)
 {
-    size_t remainingData = m_buffer.size();
+    size_t remainingData = m_receiveBuffer->size();
     if (remainingData >= size)
     {
         // all required data is already in the buffer
@@ -57,16 +256,717 @@ boost::system::error_code Stream::read(std::size_t size)
 
 void Stream::asyncReadSome(ReadCompletionCb readCb)
 {
-    size_t remainingData = m_buffer.size();
-    if (remainingData)
+    size_t remainingData = m_receiveBuffer->size();
+    if (remainingData) {
+        if (!enterInline()) {
+            m_deferredRead.readSomeCb = std::move(readCb);
+            return;
+        }
+        DestructionGuard guard(*this);
         readCb(boost::system::error_code(), remainingData);
-    else
-        asyncReadAtLeast(1, readCb);
+        if (guard.destroyed) {
+            return;
+        }
+        leaveInline();
+    } else {
+        readTransport(1, std::move(readCb));
+    }
+}
+
+void Stream::asyncWaitReadable(CompletionCb waitCb)
+{
+    if (m_receiveBuffer->size()) {
+        waitCb(boost::system::error_code());
+    } else {
+        asyncWaitTransportReadable(std::move(waitCb));
+    }
+}
+
+size_t Stream::readInto(const boost::asio::mutable_buffer& buffer, boost::system::error_code& ec)
+{
+    ec.clear();
+    size_t remainingData = m_receiveBuffer->size();
+    if (remainingData) {
+        size_t size = std::min(remainingData, buffer.size());
+        copyDataAndConsume(buffer.data(), size);
+        return size;
+    }
+    return readSomeInto(buffer, ec);
+}
+
+void Stream::asyncWaitTransportReadable(CompletionCb waitCb)
+{
+    waitCb(boost::asio::error::operation_not_supported);
+}
+
+size_t Stream::readSomeInto(const boost::asio::mutable_buffer&, boost::system::error_code& ec)
+{
+    ec = boost::asio::error::operation_not_supported;
+    return 0;
+}
+
+Stream::FrameLengthExtractor Stream::fixedFrameLength(std::size_t frameSize)
+{
+    return [frameSize](const uint8_t*, std::size_t size) -> size_t
+    {
+        return size >= frameSize ? frameSize : 0;
+    };
+}
+
+void Stream::asyncReadFrames(FrameLengthExtractor frameLengthExtractor, FramesCompletionCb framesCb)
+{
+    m_frameLengthExtractor = std::move(frameLengthExtractor);
+    m_framesCb = std::move(framesCb);
+    if (m_deliveringFrames) {
+        // executed by deliverFrames() after the current frames got consumed
+        m_framesRequested = true;
+        return;
+    }
+    deliverFrames();
+}
+
+void Stream::deliverFrames()
+{
+    do {
+        m_framesRequested = false;
+        const uint8_t* data = m_receiveBuffer->data();
+        size_t available = m_receiveBuffer->size();
+        size_t offset = 0;
+        size_t missing = 1;
+        bool invalid = false;
+        m_frames.clear();
+        while (offset < available) {
+            size_t frameLength = m_frameLengthExtractor(data + offset, available - offset);
+            if (frameLength == 0) {
+                break;
+            }
+            if (frameLength == InvalidFrameLength) {
+                invalid = true;
+                break;
+            }
+            if (frameLength > available - offset) {
+                missing = frameLength - (available - offset);
+                break;
+            }
+            m_frames.push_back(boost::asio::const_buffer(data + offset, frameLength));
+            offset += frameLength;
+        }
+
+        if (m_frames.empty() && invalid) {
+            FramesCompletionCb framesCb = std::move(m_framesCb);
+            framesCb(boost::asio::error::message_size, ConstBufferView());
+            return;
+        }
+
+        if (m_frames.empty()) {
+            auto readCb = [this](const boost::system::error_code& ec, std::size_t)
+            {
+                if (ec) {
+                    FramesCompletionCb framesCb = std::move(m_framesCb);
+                    framesCb(ec, ConstBufferView());
+                    return;
+                }
+                deliverFrames();
+            };
+            readTransport(missing, readCb);
+            return;
+        }
+
+        // framesCb might request the next frames, which replaces m_framesCb
+        FramesCompletionCb framesCb = std::move(m_framesCb);
+        m_deliveringFrames = true;
+        DestructionGuard guard(*this);
+        framesCb(boost::system::error_code(), ConstBufferView(m_frames.data(), m_frames.data() + m_frames.size()));
+        if (guard.destroyed) {
+            return;
+        }
+        m_deliveringFrames = false;
+        m_receiveBuffer->consume(offset);
+    } while (m_framesRequested);
+}
+
+void Stream::asyncReadMessage(MessageCompletionCb messageCb)
+{
+    m_messageCb = std::move(messageCb);
+    if (m_deliveringMessage) {
+        // executed by deliverMessage() after the current message got consumed
+        m_messageRequested = true;
+        return;
+    }
+    readMessage();
+}
+
+void Stream::readMessage()
+{
+    if (m_receiveBuffer->size()) {
+        MessageCompletionCb messageCb = std::move(m_messageCb);
+        messageCb(boost::asio::error::invalid_argument, ConstBufferView(), false);
+        return;
+    }
+    asyncReadMessageTransport([this](const boost::system::error_code& ec, std::size_t bytesRead)
+    {
+        deliverMessage(ec, bytesRead);
+    });
+}
+
+void Stream::deliverMessage(const boost::system::error_code& ec, std::size_t bytesRead)
+{
+    MessageCompletionCb messageCb = std::move(m_messageCb);
+    if (ec) {
+        messageCb(ec, ConstBufferView(), false);
+        return;
+    }
+    m_message = boost::asio::const_buffer(m_receiveBuffer->data(), bytesRead);
+    m_deliveringMessage = true;
+    DestructionGuard guard(*this);
+    messageCb(ec, ConstBufferView(&m_message, &m_message + 1), messageBinary());
+    if (guard.destroyed) {
+        return;
+    }
+    m_deliveringMessage = false;
+    m_receiveBuffer->consume(bytesRead);
+    if (m_messageRequested) {
+        m_messageRequested = false;
+        readMessage();
+    }
+}
+
+void Stream::asyncReadMessageTransport(ReadCompletionCb readCb)
+{
+    readCb(boost::asio::error::operation_not_supported, 0);
+}
+
+bool Stream::messageBinary() const
+{
+    return true;
+}
+
+bool Stream::messageOriented() const
+{
+    return false;
+}
+
+void Stream::asyncReadInto(const MutableBufferVector& buffers, ReadCompletionCb readCb)
+{
+    // drain buffered data first
+    size_t copied = 0;
+    auto iter = buffers.begin();
+    boost::asio::mutable_buffer partlyFilled;
+    for (; iter != buffers.end(); ++iter) {
+        size_t remainingData = m_receiveBuffer->size();
+        if (remainingData == 0) {
+            break;
+        }
+        size_t size = std::min(remainingData, iter->size());
+        copyDataAndConsume(iter->data(), size);
+        copied += size;
+        if (size < iter->size()) {
+            partlyFilled = *iter + size;
+            ++iter;
+            break;
+        }
+    }
+
+    m_readIntoBuffers.clear();
+    if (partlyFilled.size()) {
+        m_readIntoBuffers.push_back(partlyFilled);
+    }
+    m_readIntoBuffers.insert(m_readIntoBuffers.end(), iter, buffers.end());
+    if (boost::asio::buffer_size(m_readIntoBuffers) == 0) {
+        readCb(boost::system::error_code(), copied);
+        return;
+    }
+
+    auto completionCb = [readCb = std::move(readCb), copied](const boost::system::error_code& ec, std::size_t bytesRead)
+    {
+        readCb(ec, copied + bytesRead);
+    };
+    MutableBufferView view(m_readIntoBuffers.data(), m_readIntoBuffers.data() + m_readIntoBuffers.size());
+    if (m_readRateLimiter) {
+        // the direct read of the transport would bypass the limit
+        Stream::asyncReadAllInto(view, std::move(completionCb));
+    } else {
+        asyncReadAllInto(view, std::move(completionCb));
+    }
+}
+
+void Stream::asyncReadAllInto(const MutableBufferView& buffers, ReadCompletionCb readCb)
+{
+    size_t size = boost::asio::buffer_size(buffers);
+    auto completionCb = [this, buffers, size, readCb = std::move(readCb)](const boost::system::error_code& ec)
+    {
+        if (ec) {
+            readCb(ec, 0);
+            return;
+        }
+        boost::asio::buffer_copy(buffers, boost::asio::const_buffer(m_receiveBuffer->data(), size));
+        m_receiveBuffer->consume(size);
+        readCb(ec, size);
+    };
+    asyncRead(std::move(completionCb), size);
+}
+
+WriteQueue& Stream::writeLane(size_t priority)
+{
+    return m_writeLanes[std::min(priority, m_writeLanes.size() - 1)];
+}
+
+size_t Stream::firstDroppable(size_t lane) const
+{
+    if (m_writing && lane == m_writingLane) {
+        return std::max(m_writesInProgress, m_writeLanes[lane].partiallySent());
+    }
+    return m_writeLanes[lane].partiallySent();
+}
+
+bool Stream::admitWrite(size_t bytes)
+{
+    size_t maxQueuedBytes = m_writeQueueOptions.maxQueuedBytes;
+    if (!maxQueuedBytes) {
+        return true;
+    }
+    switch (m_writeQueueOptions.overflowPolicy) {
+    case WriteOverflowPolicy::DropNewest:
+        return queuedBytes() + bytes <= maxQueuedBytes;
+    case WriteOverflowPolicy::DropOldest:
+        // lowest priority first
+        for (size_t lane = 0; lane < m_writeLanes.size(); ++lane) {
+            while (queuedBytes() + bytes > maxQueuedBytes && m_writeLanes[lane].count() > firstDroppable(lane)) {
+                dropQueuedWrite(lane, firstDroppable(lane));
+            }
+        }
+        return true;
+    case WriteOverflowPolicy::Block:
+    case WriteOverflowPolicy::KeepLatestPerKey:
+        break;
+    }
+    return true;
+}
+
+template < class Data >
+void Stream::queueWrite(size_t priority, const Data& data, WriteCompletionCb writeCompletionCb)
+{
+    size_t bytes = boost::asio::buffer_size(data);
+    if (!admitWrite(bytes)) {
+        dropWrite(std::move(writeCompletionCb), bytes);
+        completeDroppedWrites();
+        return;
+    }
+    writeLane(priority).push(data, std::move(writeCompletionCb));
+    if (!completeDroppedWrites()) {
+        return;
+    }
+    onWriteQueued();
+}
+
+template < class Data >
+void Stream::queueMessage(const Data& data, bool binary, WriteCompletionCb writeCompletionCb)
+{
+    size_t bytes = boost::asio::buffer_size(data);
+    if (!admitWrite(bytes)) {
+        dropWrite(std::move(writeCompletionCb), bytes);
+        completeDroppedWrites();
+        return;
+    }
+    m_writeLanes[0].pushMessage(data, !binary, std::move(writeCompletionCb));
+    if (!completeDroppedWrites()) {
+        return;
+    }
+    onWriteQueued();
+}
+
+void Stream::onWriteQueued()
+{
+    if (m_highWatermark && !m_aboveHighWatermark && queuedBytes() >= m_highWatermark) {
+        m_aboveHighWatermark = true;
+        if (m_highWatermarkCb) {
+            m_highWatermarkCb(queuedBytes());
+        }
+    }
+    if (!m_writing) {
+        requestWrite();
+    }
+}
+
+void Stream::dropWrite(WriteCompletionCb writeCompletionCb, size_t bytes)
+{
+    ++m_droppedWrites;
+    m_droppedBytes += bytes;
+    // completed by completeDroppedWrites() once the write queue is consistent again
+    m_droppedCompletions.push_back(std::move(writeCompletionCb));
+}
+
+bool Stream::completeDroppedWrites()
+{
+    if (m_completingDroppedWrites) {
+        // a completion callback wrote again, the outer call completes the writes it dropped
+        return true;
+    }
+    m_completingDroppedWrites = true;
+    // a completion callback might write again or destroy the stream
+    DestructionGuard guard(*this);
+    for (size_t index = 0; index < m_droppedCompletions.size(); ++index) {
+        WriteCompletionCb writeCompletionCb = std::move(m_droppedCompletions[index]);
+        writeCompletionCb(boost::asio::error::no_buffer_space, 0);
+        if (guard.destroyed) {
+            return false;
+        }
+    }
+    // the memory is kept for the next drops
+    m_droppedCompletions.clear();
+    m_completingDroppedWrites = false;
+    return true;
+}
+
+void Stream::dropQueuedWrite(size_t lane, size_t position)
+{
+    size_t bytes;
+    WriteCompletionCb writeCompletionCb = m_writeLanes[lane].remove(position, bytes);
+    dropWrite(std::move(writeCompletionCb), bytes);
+}
+
+void Stream::asyncWrite(const boost::asio::const_buffer& dataBuffer, WriteCompletionCb writeCompletionCb)
+{
+    queueWrite(0, dataBuffer, std::move(writeCompletionCb));
+}
+
+void Stream::asyncWrite(const ConstBufferVector& data, WriteCompletionCb writeCompletionCb)
+{
+    queueWrite(0, data, std::move(writeCompletionCb));
+}
+
+void Stream::asyncWriteBuffers(const ConstBufferView& data, WriteCompletionCb writeCompletionCb)
+{
+    queueWrite(0, data, std::move(writeCompletionCb));
+}
+
+void Stream::asyncWritePriority(size_t priority, const boost::asio::const_buffer& dataBuffer, WriteCompletionCb writeCompletionCb)
+{
+    queueWrite(priority, dataBuffer, std::move(writeCompletionCb));
+}
+
+void Stream::asyncWritePriority(size_t priority, const ConstBufferVector& data, WriteCompletionCb writeCompletionCb)
+{
+    queueWrite(priority, data, std::move(writeCompletionCb));
+}
+
+void Stream::asyncWritePrefixed(const boost::asio::const_buffer& header, const boost::asio::const_buffer& dataBuffer, WriteCompletionCb writeCompletionCb)
+{
+    if (header.size() > WriteQueue::MaxPrefixSize) {
+        writeCompletionCb(boost::asio::error::invalid_argument, 0);
+        return;
+    }
+    size_t bytes = header.size() + dataBuffer.size();
+    if (!admitWrite(bytes)) {
+        dropWrite(std::move(writeCompletionCb), bytes);
+        completeDroppedWrites();
+        return;
+    }
+    m_writeLanes[0].pushPrefixed(header, dataBuffer, std::move(writeCompletionCb));
+    if (!completeDroppedWrites()) {
+        return;
+    }
+    onWriteQueued();
+}
+
+void Stream::asyncWriteKeyed(uint64_t key, const boost::asio::const_buffer& dataBuffer, WriteCompletionCb writeCompletionCb)
+{
+    if (m_writeQueueOptions.overflowPolicy != WriteOverflowPolicy::KeepLatestPerKey) {
+        queueWrite(0, dataBuffer, std::move(writeCompletionCb));
+        return;
+    }
+
+    WriteQueue& lane = m_writeLanes[0];
+    size_t position = lane.find(key, firstDroppable(0));
+    if (position < lane.count()) {
+        dropQueuedWrite(0, position);
+    }
+    lane.pushKeyed(key, dataBuffer, std::move(writeCompletionCb));
+    if (!completeDroppedWrites()) {
+        return;
+    }
+    onWriteQueued();
+}
+
+void Stream::asyncWriteMessage(const boost::asio::const_buffer& dataBuffer, bool binary, WriteCompletionCb writeCompletionCb)
+{
+    queueMessage(dataBuffer, binary, std::move(writeCompletionCb));
+}
+
+void Stream::asyncWriteMessage(const ConstBufferVector& data, bool binary, WriteCompletionCb writeCompletionCb)
+{
+    queueMessage(data, binary, std::move(writeCompletionCb));
+}
+
+bool Stream::writingText() const
+{
+    return m_writingText;
+}
+
+void Stream::setWriteQueueOptions(const WriteQueueOptions& options)
+{
+    m_writeQueueOptions = options;
+    m_writeQueueOptions.maxCoalescedBuffers = std::max < size_t >(m_writeQueueOptions.maxCoalescedBuffers, 1);
+    if (messageOriented()) {
+        m_writeQueueOptions.maxChunkSize = 0;
+    }
+    m_writeQueueOptions.priorityLanes = std::max(m_writeQueueOptions.priorityLanes, m_writeLanes.size());
+    m_writeLanes.resize(m_writeQueueOptions.priorityLanes);
+}
+
+const WriteQueueOptions& Stream::writeQueueOptions() const
+{
+    return m_writeQueueOptions;
+}
+
+size_t Stream::queuedBytes() const
+{
+    size_t bytes = 0;
+    for (const auto& lane : m_writeLanes) {
+        bytes += lane.bytes();
+    }
+    return bytes;
+}
+
+void Stream::setWriteWatermarks(size_t highWatermark, size_t lowWatermark, WatermarkCb highWatermarkCb, WatermarkCb lowWatermarkCb)
+{
+    m_highWatermark = highWatermark;
+    m_lowWatermark = std::min(lowWatermark, highWatermark);
+    m_highWatermarkCb = std::move(highWatermarkCb);
+    m_lowWatermarkCb = std::move(lowWatermarkCb);
+    m_aboveHighWatermark = false;
+}
+
+bool Stream::aboveHighWatermark() const
+{
+    return m_aboveHighWatermark;
+}
+
+uint64_t Stream::droppedWrites() const
+{
+    return m_droppedWrites;
+}
+
+uint64_t Stream::droppedBytes() const
+{
+    return m_droppedBytes;
+}
+
+void Stream::setEgressScheduler(EgressSchedulerSharedPtr egressScheduler)
+{
+    if (m_egressScheduler) {
+        m_egressScheduler->detach(*this);
+    }
+    m_egressScheduler = std::move(egressScheduler);
+    if (m_egressScheduler) {
+        m_egressScheduler->attach(*this);
+    }
+    if (m_waitingForTurn) {
+        // ask the new scheduler, or write directly without one
+        requestWrite();
+    }
+}
+
+const EgressSchedulerSharedPtr& Stream::egressScheduler() const
+{
+    return m_egressScheduler;
+}
+
+void Stream::requestWrite()
+{
+    m_writing = true;
+    if (m_writeRateLimiter && !m_writeRateLimiter->bucket.available()) {
+        if (m_egressScheduler) {
+            // other streams may use the turn while this one waits
+            m_egressScheduler->onWritten(*this);
+        }
+        waitForBudget(m_writeRateLimiter, &Stream::requestWrite);
+        return;
+    }
+    if (m_egressScheduler) {
+        m_waitingForTurn = true;
+        m_egressScheduler->requestWrite(*this);
+    } else {
+        startWrite();
+    }
+}
+
+size_t Stream::startWrite()
+{
+    m_waitingForTurn = false;
+    // the lane with the highest priority goes first
+    m_writingLane = m_writeLanes.size() - 1;
+    while (m_writeLanes[m_writingLane].empty()) {
+        --m_writingLane;
+    }
+    if (!m_writeQueueOptions.interleaveChunks) {
+        // other lanes must not cut into the data of a write sent partially
+        for (size_t lane = 0; lane < m_writeLanes.size(); ++lane) {
+            if (m_writeLanes[lane].partiallySent()) {
+                m_writingLane = lane;
+                break;
+            }
+        }
+    }
+    m_writesInProgress = m_writeLanes[m_writingLane].gather(m_writeQueueOptions, !messageOriented(), m_writeGather, m_chunkInProgress);
+    if (m_chunkInProgress) {
+        // the write being chunked must not be dropped
+        m_writesInProgress = 1;
+    }
+    m_writingText = m_writeLanes[m_writingLane].frontIsText();
+    ConstBufferView data(m_writeGather.data(), m_writeGather.data() + m_writeGather.size());
+    asyncWriteTransport(data, [this](const boost::system::error_code& ec, std::size_t bytesWritten)
+    {
+        onWritten(ec, bytesWritten);
+    });
+    size_t bytes = boost::asio::buffer_size(m_writeGather);
+    if (m_writeRateLimiter) {
+        m_writeRateLimiter->bucket.consume(bytes);
+    }
+    return bytes;
+}
+
+void Stream::onWritten(const boost::system::error_code& ec, std::size_t bytesWritten)
+{
+    DestructionGuard guard(*this);
+    if (ec) {
+        // after a failure, the queued writes of all lanes fail as well, starting with the lane being written
+        for (size_t i = 0; i < m_writeLanes.size(); ++i) {
+            // callbacks may add lanes, no reference is kept
+            size_t lane = (m_writingLane + i) % m_writeLanes.size();
+            while (!m_writeLanes[lane].empty()) {
+                size_t bytes;
+                WriteCompletionCb writeCb = m_writeLanes[lane].pop(bytes);
+                // tell how much of this write made it
+                bytes = std::min(bytes, bytesWritten);
+                bytesWritten -= bytes;
+                writeCb(ec, bytes);
+                if (guard.destroyed) {
+                    return;
+                }
+            }
+        }
+    } else if (m_chunkInProgress) {
+        m_writeLanes[m_writingLane].advance(m_chunkInProgress);
+    } else {
+        while (m_writesInProgress) {
+            --m_writesInProgress;
+            size_t bytes;
+            WriteCompletionCb writeCb = m_writeLanes[m_writingLane].pop(bytes);
+            // writes requested by the callback are queued until all completed writes are reported
+            writeCb(ec, bytes);
+            if (guard.destroyed) {
+                return;
+            }
+        }
+    }
+    m_writesInProgress = 0;
+    m_chunkInProgress = 0;
+
+    if (m_aboveHighWatermark && queuedBytes() <= m_lowWatermark) {
+        m_aboveHighWatermark = false;
+        if (m_lowWatermarkCb) {
+            m_lowWatermarkCb(queuedBytes());
+            if (guard.destroyed) {
+                return;
+            }
+        }
+    }
+
+    for (const auto& lane : m_writeLanes) {
+        if (!lane.empty()) {
+            requestWrite();
+            return;
+        }
+    }
+    m_writing = false;
+    if (m_egressScheduler) {
+        m_egressScheduler->onWritten(*this);
+    }
+}
+
+void Stream::setRateLimit(RateLimiterSharedPtr& rateLimiter, boost::asio::io_context& ioContext, uint64_t bytesPerSecond, size_t burstBytes)
+{
+    if (!rateLimiter) {
+        if (bytesPerSecond == 0) {
+            return;
+        }
+        rateLimiter = std::make_shared < RateLimiter >(ioContext);
+    }
+    // kept when unlimited, a transport operation might refer to it
+    rateLimiter->bucket.setRate(bytesPerSecond, burstBytes);
+    // a waiting operation checks the new budget
+    rateLimiter->timer.cancel();
+}
+
+void Stream::setReadRateLimit(boost::asio::io_context& ioContext, uint64_t bytesPerSecond, size_t burstBytes)
+{
+    setRateLimit(m_readRateLimiter, ioContext, bytesPerSecond, burstBytes);
+}
+
+void Stream::setWriteRateLimit(boost::asio::io_context& ioContext, uint64_t bytesPerSecond, size_t burstBytes)
+{
+    setRateLimit(m_writeRateLimiter, ioContext, bytesPerSecond, burstBytes);
+}
+
+void Stream::waitForBudget(const RateLimiterSharedPtr& rateLimiter, void (Stream::*continuation)(), size_t bytes)
+{
+    rateLimiter->timer.expires_after(bytes ? rateLimiter->bucket.delay(bytes) : rateLimiter->bucket.delay());
+    std::weak_ptr < RateLimiter > weakRateLimiter = rateLimiter;
+    rateLimiter->timer.async_wait([this, weakRateLimiter, continuation](const boost::system::error_code&)
+    {
+        if (weakRateLimiter.expired()) {
+            // the stream is gone
+            return;
+        }
+        // also when cancelled by a new rate, continuation checks the budget again
+        (this->*continuation)();
+    });
+}
+
+void Stream::readTransport(std::size_t bytesToRead, ReadCompletionCb readCb)
+{
+    if (!m_readRateLimiter) {
+        asyncReadAtLeast(bytesToRead, std::move(readCb));
+        return;
+    }
+    m_limitedReadSize = bytesToRead;
+    m_limitedBytesRead = 0;
+    m_limitedReadCb = std::move(readCb);
+    startLimitedRead();
+}
+
+void Stream::startLimitedRead()
+{
+    // neither the amount waited for nor a single read may exceed the budget,
+    // wait for enough budget to avoid tiny reads
+    TokenBucket& bucket = m_readRateLimiter->bucket;
+    size_t missing = m_limitedReadSize - m_limitedBytesRead;
+    size_t wanted = std::min(std::max(missing, m_readSizer.policy().minReadSize), bucket.burstBytes());
+    size_t budget = bucket.budget();
+    if (budget < wanted) {
+        waitForBudget(m_readRateLimiter, &Stream::startLimitedRead, wanted);
+        return;
+    }
+    m_readSizer.setLimit(budget);
+    auto completionCb = [this](const boost::system::error_code& ec, std::size_t bytesRead)
+    {
+        m_readSizer.setLimit(std::numeric_limits < size_t >::max());
+        m_readRateLimiter->bucket.consume(bytesRead);
+        m_limitedBytesRead += bytesRead;
+        if (!ec && m_limitedBytesRead < m_limitedReadSize) {
+            startLimitedRead();
+            return;
+        }
+        ReadCompletionCb readCb = std::move(m_limitedReadCb);
+        readCb(ec, m_limitedBytesRead);
+    };
+    asyncReadAtLeast(std::min(missing, budget), completionCb);
 }
 
 size_t Stream::readSome(boost::system::error_code& ec)
 {
-    size_t remainingData = m_buffer.size();
+    size_t remainingData = m_receiveBuffer->size();
     if (remainingData) {
         ec = boost::system::error_code();
         return remainingData;
@@ -13,8 +13,8 @@ namespace daq::stream {
 
     const std::chrono::milliseconds TcpClientStream::DefaultConnectTimeout(5000);
 
-    TcpClientStream::TcpClientStream(boost::asio::io_context& ioc, const std::string &host, const std::string &port)
-        : TcpStream(ioc)
+    TcpClientStream::TcpClientStream(boost::asio::io_context& ioc, const std::string &host, const std::string &port, ReceiveBufferType receiveBufferType)
+        : TcpStream(ioc, receiveBufferType)
         , m_ioc(ioc)
         , m_host(host)
         , m_port(port)
@@ -26,7 +26,7 @@ namespace daq::stream {
 
     void TcpClientStream::asyncInit(CompletionCb completionCb)
     {
-        m_initCompletionCb = completionCb;
+        m_initCompletionCb = std::move(completionCb);
         if (m_socket.is_open()) {
             auto completion = [this]()
             {
@@ -45,7 +45,7 @@ namespace daq::stream {
     void TcpClientStream::asyncInit(CompletionCb completionCb, std::chrono::milliseconds connectTimeout)
     {
         m_connectTimeout = connectTimeout;
-        asyncInit(completionCb);
+        asyncInit(std::move(completionCb));
     }
 
     boost::system::error_code TcpClientStream::init()
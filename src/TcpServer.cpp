@@ -34,6 +34,7 @@ namespace daq::stream {
     {
         syslog(LOG_INFO, "Stopping tcp server");
         m_tcpAcceptor.close();
+        onStop();
     }
 
     void TcpServer::startTcpAccept()
@@ -44,7 +45,14 @@ namespace daq::stream {
                 return;
             }
             // here we create a new stream and initialize it. Afterwards we call a callback function to provide the error code and the stream itself.
-            auto stream = std::make_shared < TcpServerStream > (std::move(streamSocket));
+            auto stream = std::make_shared < TcpServerStream > (std::move(streamSocket), receiveBufferType());
+            addStream(stream);
+            if (receiveBufferPool()) {
+                stream->setReceiveBufferPool(receiveBufferPool());
+            }
+            if (m_egressScheduler) {
+                stream->setEgressScheduler(m_egressScheduler);
+            }
             auto completionCb = [&, stream](const boost::system::error_code& ec)
             {
                 if(ec) {
@@ -8,8 +8,8 @@
 
 
 namespace daq::stream {
-    TcpServerStream::TcpServerStream(boost::asio::ip::tcp::socket&& socket)
-        : TcpStream(std::move(socket))
+    TcpServerStream::TcpServerStream(boost::asio::ip::tcp::socket&& socket, ReceiveBufferType receiveBufferType)
+        : TcpStream(std::move(socket), receiveBufferType)
     {
     }
     
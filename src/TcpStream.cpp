@@ -21,34 +21,46 @@
 
 namespace daq::stream {
 
-    TcpStream::TcpStream(boost::asio::io_context& ioc)
-        : m_socket(ioc)
+    TcpStream::TcpStream(boost::asio::io_context& ioc, ReceiveBufferType receiveBufferType)
+        : Stream(receiveBufferType)
+        , m_socket(ioc)
     {
     }
 
-    TcpStream::TcpStream(boost::asio::ip::tcp::socket&& socket)
-        : m_socket(std::move(socket))
+    TcpStream::TcpStream(boost::asio::ip::tcp::socket&& socket, ReceiveBufferType receiveBufferType)
+        : Stream(receiveBufferType)
+        , m_socket(std::move(socket))
     {
     }
 
     void TcpStream::asyncReadAtLeast(std::size_t bytesToRead, ReadCompletionCb readCompletionCb)
     {
-        boost::asio::async_read(m_socket, m_buffer, boost::asio::transfer_at_least(bytesToRead), readCompletionCb);
+        boost::asio::async_read(m_socket, receiveBuffer(), transferAtLeast(bytesToRead), readHandler(std::move(readCompletionCb)));
     }
 
     size_t TcpStream::readAtLeast(std::size_t bytesToRead, boost::system::error_code &ec)
     {
-        return boost::asio::read(m_socket, m_buffer, boost::asio::transfer_at_least(bytesToRead), ec);
+        return boost::asio::read(m_socket, receiveBuffer(), transferAtLeast(bytesToRead), ec);
     }
 
-    void TcpStream::asyncWrite(const boost::asio::const_buffer& data, Stream::WriteCompletionCb writeCompletionCb)
+    void TcpStream::asyncWaitTransportReadable(CompletionCb waitCb)
     {
-        boost::asio::async_write(m_socket, data, writeCompletionCb);
+        m_socket.async_wait(boost::asio::ip::tcp::socket::wait_read, readHandler(std::move(waitCb)));
     }
 
-    void TcpStream::asyncWrite(const ConstBufferVector& data, WriteCompletionCb writeCompletionCb)
+    size_t TcpStream::readSomeInto(const boost::asio::mutable_buffer& buffer, boost::system::error_code& ec)
     {
-        boost::asio::async_write(m_socket, data, writeCompletionCb);
+        return m_socket.read_some(buffer, ec);
+    }
+
+    void TcpStream::asyncReadAllInto(const MutableBufferView& buffers, ReadCompletionCb readCb)
+    {
+        boost::asio::async_read(m_socket, buffers, readHandler(std::move(readCb)));
+    }
+
+    void TcpStream::asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb)
+    {
+        boost::asio::async_write(m_socket, data, writeHandler(std::move(writeCompletionCb)));
     }
 
     size_t TcpStream::write(const boost::asio::const_buffer &data, boost::system::error_code &ec)
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <limits>
+
+#include "stream/TokenBucket.hpp"
+
+namespace daq::stream {
+    TokenBucket::TokenBucket(uint64_t bytesPerSecond, size_t burstBytes, Clock::time_point now)
+        : m_bytesPerSecond(0)
+        , m_burstBytes(0)
+        , m_tokens(0)
+        , m_lastRefill(now)
+    {
+        setRate(bytesPerSecond, burstBytes, now);
+    }
+
+    void TokenBucket::setRate(uint64_t bytesPerSecond, size_t burstBytes, Clock::time_point now)
+    {
+        refill(now);
+        bool wasUnlimited = unlimited();
+        m_bytesPerSecond = bytesPerSecond;
+        m_burstBytes = static_cast < double >(burstBytes ? burstBytes : bytesPerSecond);
+        // a new limit starts with the full burst
+        m_tokens = wasUnlimited ? m_burstBytes : std::min(m_tokens, m_burstBytes);
+    }
+
+    uint64_t TokenBucket::bytesPerSecond() const
+    {
+        return m_bytesPerSecond;
+    }
+
+    bool TokenBucket::unlimited() const
+    {
+        return m_bytesPerSecond == 0;
+    }
+
+    size_t TokenBucket::burstBytes() const
+    {
+        return static_cast < size_t >(m_burstBytes);
+    }
+
+    bool TokenBucket::available(Clock::time_point now)
+    {
+        if (unlimited()) {
+            return true;
+        }
+        refill(now);
+        return m_tokens > 0;
+    }
+
+    size_t TokenBucket::budget(Clock::time_point now)
+    {
+        if (unlimited()) {
+            return std::numeric_limits < size_t >::max();
+        }
+        if (!available(now)) {
+            return 0;
+        }
+        return std::max < size_t >(static_cast < size_t >(m_tokens), 1);
+    }
+
+    void TokenBucket::consume(size_t bytes, Clock::time_point now)
+    {
+        if (unlimited()) {
+            return;
+        }
+        refill(now);
+        m_tokens -= static_cast < double >(bytes);
+    }
+
+    TokenBucket::Clock::duration TokenBucket::delay(Clock::time_point now)
+    {
+        if (available(now)) {
+            return Clock::duration::zero();
+        }
+        // one byte more than the debt to become available
+        std::chrono::duration < double > seconds((1.0 - m_tokens) / static_cast < double >(m_bytesPerSecond));
+        return std::chrono::duration_cast < Clock::duration >(seconds) + Clock::duration(1);
+    }
+
+    TokenBucket::Clock::duration TokenBucket::delay(size_t bytes, Clock::time_point now)
+    {
+        if (budget(now) >= bytes) {
+            return Clock::duration::zero();
+        }
+        std::chrono::duration < double > seconds((static_cast < double >(bytes) - m_tokens) / static_cast < double >(m_bytesPerSecond));
+        return std::chrono::duration_cast < Clock::duration >(seconds) + Clock::duration(1);
+    }
+
+    void TokenBucket::refill(Clock::time_point now)
+    {
+        if (now <= m_lastRefill) {
+            return;
+        }
+        std::chrono::duration < double > elapsed = now - m_lastRefill;
+        m_lastRefill = now;
+        m_tokens = std::min(m_burstBytes, m_tokens + elapsed.count() * static_cast < double >(m_bytesPerSecond));
+    }
+}
@@ -1,15 +1,16 @@
+#include <algorithm>
 #include <cstdlib>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
 
-#include <boost/asio/read.hpp>
 #include <boost/asio/write.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/websocket.hpp>
 
 #include "stream/Defines.hpp"
+#include "stream/WebsocketRead.hpp"
 #include "stream/WebsocketClientStream.hpp"
 #include "stream/utils/boost_compatibility_utils.hpp"
 
@@ -17,8 +18,19 @@
 namespace daq::stream {
 const std::chrono::milliseconds WebsocketClientStream::DefaultConnectTimeout(5000);
 
-WebsocketClientStream::WebsocketClientStream(boost::asio::io_context& ioc, const std::string &host, const std::string& port, const std::string &path)
-    : m_ioc(ioc)
+/// The transport takes generic endpoints
+static std::vector < boost::asio::generic::stream_protocol::endpoint > toEndpoints(const boost::asio::ip::tcp::resolver::results_type& results)
+{
+    std::vector < boost::asio::generic::stream_protocol::endpoint > endpoints;
+    for (const auto& entry : results) {
+        endpoints.emplace_back(entry.endpoint());
+    }
+    return endpoints;
+}
+
+WebsocketClientStream::WebsocketClientStream(boost::asio::io_context& ioc, const std::string &host, const std::string& port, const std::string &path, ReceiveBufferType receiveBufferType)
+    : Stream(receiveBufferType)
+    , m_ioc(ioc)
     , m_host(host)
     , m_port(port)
     , m_path(path)
@@ -26,12 +38,16 @@ WebsocketClientStream::WebsocketClientStream(boost::asio::io_context& ioc, const
     , m_resolver(ioc)
     , m_asyncOperationTimer(ioc)
     , m_asyncTimeout(DefaultConnectTimeout)
+    , m_dynamicBuffer(receiveBuffer())
+    , m_handshakeBytesRead(0)
+    , m_handshakeBytesWritten(0)
+    , m_rttMeter(std::make_shared < WebsocketRttMeter >(m_stream))
 {
 }
 
 void WebsocketClientStream::asyncInit(CompletionCb completionCb)
 {
-    m_initCompletionCb = completionCb;
+    m_initCompletionCb = std::move(completionCb);
     if (m_stream.is_open()) {
         auto completion = [this]()
         {
@@ -52,7 +68,7 @@ void WebsocketClientStream::asyncInit(CompletionCb completionCb)
 void WebsocketClientStream::asyncInit(CompletionCb completionCb, std::chrono::milliseconds initTimeout)
 {
     m_asyncTimeout = initTimeout;
-    asyncInit(completionCb);
+    asyncInit(std::move(completionCb));
 }
 
 boost::system::error_code WebsocketClientStream::init()
@@ -66,31 +82,51 @@ boost::system::error_code WebsocketClientStream::init()
     if (ec) {
         return ec;
     }
+    return connect(toEndpoints(results));
+}
 
-    boost::beast::get_lowest_layer(m_stream).connect(results, ec);
+boost::system::error_code WebsocketClientStream::connect(const Endpoints& endpoints)
+{
+    boost::system::error_code ec;
+    boost::beast::get_lowest_layer(m_stream).connect(endpoints, ec);
     if (ec) {
         return ec;
     }
     setOptions();
 
     boost_compatibility_utils::handshake(m_stream, m_host, m_path, ec);
+    if (!ec) {
+        onHandshakeDone();
+    }
     return ec;
 }
 
+bool WebsocketClientStream::isOpen() const
+{
+    return m_stream.is_open();
+}
+
 void WebsocketClientStream::onResolve(const boost::beast::error_code& ec, boost::asio::ip::tcp::resolver::results_type results)
 {
     if(ec) {
         m_initCompletionCb(ec);
         return;
     }
+    asyncConnect(toEndpoints(results));
+}
 
+void WebsocketClientStream::asyncConnect(const Endpoints& endpoints)
+{
     m_asyncOperationTimer.expires_from_now(boost::posix_time::milliseconds(m_asyncTimeout.count()));
     m_asyncOperationTimer.async_wait(std::bind(&WebsocketClientStream::asyncTimeoutCb, this, std::placeholders::_1));
 
-    // Make the connection on the IP address we got from the lookup
+    // Connect to the first endpoint reachable
     boost::beast::get_lowest_layer(m_stream).async_connect(
-                results,
-                std::bind(&WebsocketClientStream::onConnect, this, std::placeholders::_1));
+                endpoints,
+                [this](const boost::beast::error_code& ec, const boost::asio::generic::stream_protocol::endpoint&)
+                {
+                    onConnect(ec);
+                });
 }
 
 void WebsocketClientStream::onConnect(const boost::beast::error_code& ec)
@@ -117,20 +153,56 @@ void WebsocketClientStream::onConnect(const boost::beast::error_code& ec)
 void WebsocketClientStream::onUpgrade(const boost::beast::error_code &ec)
 {
     m_asyncOperationTimer.cancel();
+    if (!ec) {
+        onHandshakeDone();
+    }
     m_initCompletionCb(ec);
 }
 
+void WebsocketClientStream::onHandshakeDone()
+{
+    m_trafficStats = WebsocketTrafficStats();
+    m_handshakeBytesRead = m_stream.next_layer().rate_policy().bytesRead();
+    m_handshakeBytesWritten = m_stream.next_layer().rate_policy().bytesWritten();
+}
+
 
 void WebsocketClientStream::asyncReadAtLeast(std::size_t bytesToRead, ReadCompletionCb readAtLeastCb)
 {
-    boost::asio::async_read(m_stream, m_buffer, boost::asio::transfer_at_least(bytesToRead), readAtLeastCb);
+    auto completionCb = [this, readAtLeastCb = std::move(readAtLeastCb)](const boost::system::error_code& ec, std::size_t bytesRead)
+    {
+        m_trafficStats.uncompressedBytesReceived += bytesRead;
+        readAtLeastCb(ec, bytesRead);
+    };
+    asyncWebsocketReadAtLeast(m_stream, m_dynamicBuffer, bytesToRead, maxReadSize(), std::move(completionCb));
 }
 
 size_t WebsocketClientStream::readAtLeast(std::size_t bytesToRead, boost::system::error_code &ec)
 {
-    return boost::asio::read(m_stream, m_buffer, boost::asio::transfer_at_least(bytesToRead), ec);
+    size_t bytesRead = websocketReadAtLeast(m_stream, m_dynamicBuffer, bytesToRead, maxReadSize(), ec);
+    m_trafficStats.uncompressedBytesReceived += bytesRead;
+    return bytesRead;
+}
+
+
+void WebsocketClientStream::asyncReadMessageTransport(ReadCompletionCb readCb)
+{
+    m_stream.async_read(m_dynamicBuffer, [this, readCb = std::move(readCb)](const boost::system::error_code& ec, std::size_t bytesRead)
+    {
+        m_trafficStats.uncompressedBytesReceived += bytesRead;
+        readCb(ec, bytesRead);
+    });
 }
 
+bool WebsocketClientStream::messageBinary() const
+{
+    return m_stream.got_binary();
+}
+
+bool WebsocketClientStream::messageOriented() const
+{
+    return true;
+}
 
 void WebsocketClientStream::asyncTimeoutCb(const boost::system::error_code &ec)
 {
@@ -147,6 +219,8 @@ void WebsocketClientStream::setOptions()
     boost::beast::get_lowest_layer(m_stream).expires_never();
 
     m_stream.binary(true);
+    applyWebsocketOptions(m_stream, m_websocketOptions);
+    m_stream.set_option(permessageDeflate(m_deflateOptions, boost::beast::role_type::client));
 
     // Set suggested timeout settings for the websocket
     m_stream.set_option(boost::beast::websocket::stream_base::timeout::suggested(
@@ -162,24 +236,85 @@ void WebsocketClientStream::setOptions()
             }));
 }
 
-void WebsocketClientStream::asyncWrite(const boost::asio::const_buffer& data, Stream::WriteCompletionCb writeCompletionCb)
+void WebsocketClientStream::asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb)
 {
-    m_stream.async_write(data, writeCompletionCb);
+    m_stream.binary(!writingText());
+    size_t size = boost::asio::buffer_size(data);
+    adaptWriteBuffer(size);
+    compressIfWorthIt(size);
+    m_trafficStats.uncompressedBytesSent += size;
+    m_stream.async_write(data, std::move(writeCompletionCb));
 }
 
-void WebsocketClientStream::asyncWrite(const ConstBufferVector& data, Stream::WriteCompletionCb writeCompletionCb)
+size_t WebsocketClientStream::write(const boost::asio::const_buffer &data, boost::system::error_code &ec)
 {
-    m_stream.async_write(data, writeCompletionCb);
+    m_stream.binary(true);
+    adaptWriteBuffer(data.size());
+    compressIfWorthIt(data.size());
+    size_t bytesWritten = m_stream.write(data, ec);
+    m_trafficStats.uncompressedBytesSent += bytesWritten;
+    return bytesWritten;
 }
 
-size_t WebsocketClientStream::write(const boost::asio::const_buffer &data, boost::system::error_code &ec)
+size_t WebsocketClientStream::write(const ConstBufferVector &data, boost::system::error_code &ec)
 {
-    return m_stream.write(data, ec);
+    m_stream.binary(true);
+    adaptWriteBuffer(boost::asio::buffer_size(data));
+    compressIfWorthIt(boost::asio::buffer_size(data));
+    size_t bytesWritten = m_stream.write(data, ec);
+    m_trafficStats.uncompressedBytesSent += bytesWritten;
+    return bytesWritten;
 }
 
-size_t WebsocketClientStream::write(const ConstBufferVector &data, boost::system::error_code &ec)
+void WebsocketClientStream::setDeflateOptions(const WebsocketDeflateOptions& deflateOptions)
+{
+    m_deflateOptions = supportedDeflateOptions(deflateOptions);
+}
+
+WebsocketTrafficStats WebsocketClientStream::trafficStats() const
+{
+    WebsocketTrafficStats trafficStats = m_trafficStats;
+    trafficStats.compressedBytesSent = m_stream.next_layer().rate_policy().bytesWritten() - m_handshakeBytesWritten;
+    trafficStats.compressedBytesReceived = m_stream.next_layer().rate_policy().bytesRead() - m_handshakeBytesRead;
+    return trafficStats;
+}
+
+void WebsocketClientStream::compressIfWorthIt(size_t messageSize)
+{
+    compressNextMessage(m_stream, messageSize >= m_deflateOptions.minMessageSize);
+}
+
+void WebsocketClientStream::setWebsocketOptions(const WebsocketOptions& websocketOptions)
+{
+    m_websocketOptions = websocketOptions;
+    m_writeBufferSizer.setOptions(websocketOptions);
+    applyWebsocketOptions(m_stream, websocketOptions);
+    if (websocketOptions.readBufferSize) {
+        ReadSizePolicy policy = readSizePolicy();
+        policy.maxReadSize = websocketOptions.readBufferSize;
+        policy.minReadSize = std::min(policy.minReadSize, websocketOptions.readBufferSize);
+        setReadSizePolicy(policy);
+    }
+}
+
+const WebsocketOptions& WebsocketClientStream::websocketOptions() const
+{
+    return m_websocketOptions;
+}
+
+void WebsocketClientStream::setPingInterval(std::chrono::milliseconds interval)
+{
+    m_rttMeter->setInterval(interval);
+}
+
+WebsocketRttStats WebsocketClientStream::rttStats() const
+{
+    return m_rttMeter->stats();
+}
+
+void WebsocketClientStream::adaptWriteBuffer(size_t messageSize)
 {
-    return m_stream.write(data, ec);
+    m_stream.write_buffer_bytes(m_writeBufferSizer.onMessage(messageSize));
 }
 
 /// Before closing, handshake timeout is reduced. Otherwise timeout on dead connection would be the long 30s default!
@@ -193,7 +328,7 @@ static boost::beast::websocket::stream_base::timeout reducedHandshakeTimeout()
 void WebsocketClientStream::asyncClose(CompletionCb closeCb)
 {
     m_stream.set_option(reducedHandshakeTimeout());
-    m_stream.async_close(boost::beast::websocket::close_code::none, closeCb);
+    m_stream.async_close(boost::beast::websocket::close_code::none, std::move(closeCb));
 }
 
 boost::system::error_code WebsocketClientStream::close()
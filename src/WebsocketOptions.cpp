@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <type_traits>
+
+#include "utils/syslog.h"
+#include "stream/WebsocketOptions.hpp"
+
+namespace daq::stream {
+    template < class WebsocketType >
+    static auto compressNextMessage(WebsocketType& websocket, bool compress, int) -> decltype(websocket.compress(compress), bool())
+    {
+        websocket.compress(compress);
+        return true;
+    }
+
+    template < class WebsocketType >
+    static bool compressNextMessage(WebsocketType&, bool, long)
+    {
+        return false;
+    }
+
+    template < class WebsocketType >
+    static auto hasCompress(int) -> decltype(std::declval < WebsocketType& >().compress(true), std::true_type());
+
+    template < class WebsocketType >
+    static std::false_type hasCompress(long);
+
+    boost::beast::websocket::permessage_deflate permessageDeflate(const WebsocketDeflateOptions& options, boost::beast::role_type role)
+    {
+        boost::beast::websocket::permessage_deflate permessageDeflate;
+        permessageDeflate.server_enable = options.enabled && role == boost::beast::role_type::server;
+        permessageDeflate.client_enable = options.enabled && role == boost::beast::role_type::client;
+        permessageDeflate.server_max_window_bits = options.serverMaxWindowBits;
+        permessageDeflate.client_max_window_bits = options.clientMaxWindowBits;
+        permessageDeflate.server_no_context_takeover = options.serverNoContextTakeover;
+        permessageDeflate.client_no_context_takeover = options.clientNoContextTakeover;
+        permessageDeflate.compLevel = options.compressionLevel;
+        permessageDeflate.memLevel = options.memoryLevel;
+        return permessageDeflate;
+    }
+
+    bool compressNextMessage(Websocket& websocket, bool compress)
+    {
+        // picks the first overload if Beast has websocket::stream::compress()
+        return compressNextMessage(websocket, compress, 0);
+    }
+
+    bool compressNextMessage(TcpWebsocket& websocket, bool compress)
+    {
+        return compressNextMessage(websocket, compress, 0);
+    }
+
+    bool perMessageCompressionSupported()
+    {
+        return decltype(hasCompress < Websocket >(0))::value;
+    }
+
+    WebsocketDeflateOptions supportedDeflateOptions(const WebsocketDeflateOptions& options)
+    {
+        WebsocketDeflateOptions supported = options;
+        if (supported.minMessageSize && !perMessageCompressionSupported()) {
+            syslog(LOG_WARNING, "Websocket deflate option minMessageSize is not supported by this Beast version, every message is compressed");
+            supported.minMessageSize = 0;
+        }
+        return supported;
+    }
+
+    /// Smallest write buffer Beast accepts
+    static const size_t MinWriteBufferBytes = 8;
+
+    template < class WebsocketType >
+    static void applyOptions(WebsocketType& websocket, const WebsocketOptions& options)
+    {
+        websocket.write_buffer_bytes(std::max(options.writeBufferSize, MinWriteBufferBytes));
+        websocket.auto_fragment(options.autoFragment);
+        websocket.read_message_max(options.readMessageMax);
+    }
+
+    void applyWebsocketOptions(Websocket& websocket, const WebsocketOptions& options)
+    {
+        applyOptions(websocket, options);
+    }
+
+    void applyWebsocketOptions(TcpWebsocket& websocket, const WebsocketOptions& options)
+    {
+        applyOptions(websocket, options);
+    }
+
+    const size_t WebsocketWriteBufferSizer::ShrinkAfterMessages = 16;
+
+    WebsocketWriteBufferSizer::WebsocketWriteBufferSizer()
+        : m_adaptive(false)
+        , m_minWriteBufferSize(0)
+        , m_maxWriteBufferSize(0)
+        , m_writeBufferSize(0)
+        , m_smallMessages(0)
+    {
+        setOptions(WebsocketOptions());
+    }
+
+    void WebsocketWriteBufferSizer::setOptions(const WebsocketOptions& options)
+    {
+        m_adaptive = options.adaptiveWriteBuffer;
+        m_minWriteBufferSize = std::max(options.minWriteBufferSize, MinWriteBufferBytes);
+        m_maxWriteBufferSize = std::max(options.maxWriteBufferSize, m_minWriteBufferSize);
+        m_writeBufferSize = std::max(options.writeBufferSize, MinWriteBufferBytes);
+        if (m_adaptive) {
+            m_writeBufferSize = std::clamp(m_writeBufferSize, m_minWriteBufferSize, m_maxWriteBufferSize);
+        }
+        m_smallMessages = 0;
+    }
+
+    size_t WebsocketWriteBufferSizer::onMessage(size_t messageSize)
+    {
+        if (!m_adaptive) {
+            return m_writeBufferSize;
+        }
+        if (messageSize > m_writeBufferSize) {
+            // grow in powers of two to not follow every small change of the message size
+            while (m_writeBufferSize < messageSize && m_writeBufferSize < m_maxWriteBufferSize) {
+                m_writeBufferSize = std::min(m_writeBufferSize * 2, m_maxWriteBufferSize);
+            }
+            m_smallMessages = 0;
+        } else if (messageSize <= m_writeBufferSize / 4) {
+            if (++m_smallMessages >= ShrinkAfterMessages) {
+                m_writeBufferSize = std::max(m_writeBufferSize / 2, m_minWriteBufferSize);
+                m_smallMessages = 0;
+            }
+        } else {
+            m_smallMessages = 0;
+        }
+        return m_writeBufferSize;
+    }
+
+    size_t WebsocketWriteBufferSizer::writeBufferSize() const
+    {
+        return m_writeBufferSize;
+    }
+}
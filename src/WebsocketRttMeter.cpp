@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cstring>
+
+#include "stream/WebsocketRttMeter.hpp"
+
+namespace daq::stream {
+    /// Tells our pings from those of the idle timeout of Beast and of the remote side
+    static const char PingTag[] = { 'r', 't', 't', ':' };
+
+    RttEstimator::RttEstimator()
+        : m_samples(0)
+        , m_smoothedRtt(0)
+        , m_jitter(0)
+        , m_minRtt(0)
+        , m_maxRtt(0)
+        , m_lastRtt(0)
+    {
+    }
+
+    void RttEstimator::addSample(std::chrono::microseconds rtt)
+    {
+        m_lastRtt = rtt;
+        if (m_samples++ == 0) {
+            m_smoothedRtt = rtt;
+            m_jitter = rtt / 2;
+            m_minRtt = rtt;
+            m_maxRtt = rtt;
+            return;
+        }
+        std::chrono::microseconds deviation = m_smoothedRtt > rtt ? m_smoothedRtt - rtt : rtt - m_smoothedRtt;
+        // gains of 1/4 and 1/8 as recommended by RFC 6298
+        m_jitter = (3 * m_jitter + deviation) / 4;
+        m_smoothedRtt = (7 * m_smoothedRtt + rtt) / 8;
+        m_minRtt = std::min(m_minRtt, rtt);
+        m_maxRtt = std::max(m_maxRtt, rtt);
+    }
+
+    uint64_t RttEstimator::samples() const
+    {
+        return m_samples;
+    }
+
+    std::chrono::microseconds RttEstimator::smoothedRtt() const
+    {
+        return m_smoothedRtt;
+    }
+
+    std::chrono::microseconds RttEstimator::jitter() const
+    {
+        return m_jitter;
+    }
+
+    std::chrono::microseconds RttEstimator::minRtt() const
+    {
+        return m_minRtt;
+    }
+
+    std::chrono::microseconds RttEstimator::maxRtt() const
+    {
+        return m_maxRtt;
+    }
+
+    std::chrono::microseconds RttEstimator::lastRtt() const
+    {
+        return m_lastRtt;
+    }
+
+    WebsocketRttMeter::WebsocketRttMeter(Websocket& websocket)
+        : m_websocket(&websocket)
+        , m_timer(websocket.get_executor())
+        , m_interval(0)
+        , m_timerPending(false)
+        , m_pingPending(false)
+        , m_pingsSent(0)
+        , m_pongsReceived(0)
+    {
+    }
+
+    WebsocketRttMeter::WebsocketRttMeter(TcpWebsocket& websocket)
+        : m_websocket(&websocket)
+        , m_timer(websocket.get_executor())
+        , m_interval(0)
+        , m_timerPending(false)
+        , m_pingPending(false)
+        , m_pingsSent(0)
+        , m_pongsReceived(0)
+    {
+    }
+
+    void WebsocketRttMeter::setInterval(std::chrono::milliseconds interval)
+    {
+        m_interval = interval;
+        if (m_interval.count() == 0) {
+            m_timer.cancel();
+            return;
+        }
+
+        std::weak_ptr < WebsocketRttMeter > weakMeter = weak_from_this();
+        auto controlCb = [weakMeter](boost::beast::websocket::frame_type kind, boost::beast::string_view payload)
+        {
+            if (auto meter = weakMeter.lock()) {
+                meter->onControlFrame(kind, payload);
+            }
+        };
+        std::visit([&](auto websocket) { websocket->control_callback(controlCb); }, m_websocket);
+
+        if (m_timerPending) {
+            // the timer handler sends a ping right away and continues with the new interval
+            m_timer.cancel();
+        } else if (!m_pingPending) {
+            sendPing();
+        }
+    }
+
+    std::chrono::milliseconds WebsocketRttMeter::interval() const
+    {
+        return m_interval;
+    }
+
+    WebsocketRttStats WebsocketRttMeter::stats() const
+    {
+        WebsocketRttStats stats;
+        stats.smoothedRtt = m_estimator.smoothedRtt();
+        stats.jitter = m_estimator.jitter();
+        stats.minRtt = m_estimator.minRtt();
+        stats.maxRtt = m_estimator.maxRtt();
+        stats.lastRtt = m_estimator.lastRtt();
+        stats.pingsSent = m_pingsSent;
+        stats.pongsReceived = m_pongsReceived;
+        stats.lastPongTime = m_lastPongTime;
+        return stats;
+    }
+
+    void WebsocketRttMeter::onControlFrame(boost::beast::websocket::frame_type kind, boost::beast::string_view payload)
+    {
+        int64_t sendTime;
+        if (kind != boost::beast::websocket::frame_type::pong ||
+            payload.size() != sizeof(PingTag) + sizeof(sendTime) ||
+            std::memcmp(payload.data(), PingTag, sizeof(PingTag)) != 0) {
+            return;
+        }
+        std::memcpy(&sendTime, payload.data() + sizeof(PingTag), sizeof(sendTime));
+
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::microseconds rtt = std::chrono::duration_cast < std::chrono::microseconds >(now.time_since_epoch()) - std::chrono::microseconds(sendTime);
+        if (rtt.count() < 0) {
+            // not sent by this process
+            return;
+        }
+        m_estimator.addSample(rtt);
+        ++m_pongsReceived;
+        m_lastPongTime = now;
+    }
+
+    void WebsocketRttMeter::sendPing()
+    {
+        // the payload is echoed by the pong, the send time is all we need to remember
+        int64_t sendTime = std::chrono::duration_cast < std::chrono::microseconds >(std::chrono::steady_clock::now().time_since_epoch()).count();
+        boost::beast::websocket::ping_data payload;
+        payload.append(PingTag, sizeof(PingTag));
+        payload.append(reinterpret_cast < const char* >(&sendTime), sizeof(sendTime));
+
+        m_pingPending = true;
+        ++m_pingsSent;
+        std::weak_ptr < WebsocketRttMeter > weakMeter = weak_from_this();
+        auto pingCb = [weakMeter](const boost::system::error_code& ec)
+        {
+            if (auto meter = weakMeter.lock()) {
+                meter->onPingSent(ec);
+            }
+        };
+        std::visit([&](auto websocket) { websocket->async_ping(payload, pingCb); }, m_websocket);
+    }
+
+    void WebsocketRttMeter::onPingSent(const boost::system::error_code& ec)
+    {
+        m_pingPending = false;
+        if (ec || m_interval.count() == 0) {
+            return;
+        }
+        m_timerPending = true;
+        m_timer.expires_after(m_interval);
+        std::weak_ptr < WebsocketRttMeter > weakMeter = weak_from_this();
+        m_timer.async_wait([weakMeter](const boost::system::error_code& ec)
+        {
+            if (auto meter = weakMeter.lock()) {
+                meter->onTimer(ec);
+            }
+        });
+    }
+
+    void WebsocketRttMeter::onTimer(const boost::system::error_code&)
+    {
+        m_timerPending = false;
+        // also when cancelled by a new interval
+        if (m_interval.count() == 0) {
+            return;
+        }
+        sendPing();
+    }
+}
@@ -19,9 +19,17 @@ namespace daq::stream {
         , m_tcpDataPort(tcpDataPort)
         , m_tcpAcceptorV4(readerIoContext)
         , m_tcpAcceptorV6(readerIoContext)
+        , m_pingInterval(0)
+        , m_shutdownMode(WebsocketCloseMode::Handshake)
+        , m_stopped(false)
     {
     }
     
+    WebsocketServer::WebsocketServer(boost::asio::io_context& readerIoContext, NewStreamCb newStreamCb)
+        : WebsocketServer(readerIoContext, newStreamCb, 0)
+    {
+    }
+
     WebsocketServer::~WebsocketServer()
     {
         stop();
@@ -30,6 +38,7 @@ namespace daq::stream {
     int WebsocketServer::start()
     {
         syslog(LOG_INFO, "Starting websocket server");
+        onStart();
     
         boost::system::error_code ec;
         m_tcpAcceptorV4.open(ip::tcp::v4(), ec);
@@ -59,6 +68,59 @@ namespace daq::stream {
         syslog(LOG_INFO, "Stopping websocket server");
         m_tcpAcceptorV4.close();
         m_tcpAcceptorV6.close();
+        // handshakes still in progress get closed on completion
+        m_stopped = true;
+        if (closeStreamsOnStop()) {
+            for (const auto& stream : streams()) {
+                std::static_pointer_cast < WebsocketServerStream >(stream)->setCloseMode(m_shutdownMode);
+            }
+        }
+        onStop();
+    }
+
+    void WebsocketServer::onStart()
+    {
+        m_stopped = false;
+    }
+
+    void WebsocketServer::setDeflateOptions(const WebsocketDeflateOptions& deflateOptions)
+    {
+        m_deflateOptions = supportedDeflateOptions(deflateOptions);
+    }
+
+    const WebsocketDeflateOptions& WebsocketServer::deflateOptions() const
+    {
+        return m_deflateOptions;
+    }
+
+    void WebsocketServer::setWebsocketOptions(const WebsocketOptions& websocketOptions)
+    {
+        m_websocketOptions = websocketOptions;
+    }
+
+    const WebsocketOptions& WebsocketServer::websocketOptions() const
+    {
+        return m_websocketOptions;
+    }
+
+    void WebsocketServer::setPingInterval(std::chrono::milliseconds interval)
+    {
+        m_pingInterval = interval;
+    }
+
+    std::chrono::milliseconds WebsocketServer::pingInterval() const
+    {
+        return m_pingInterval;
+    }
+
+    void WebsocketServer::setShutdownMode(WebsocketCloseMode shutdownMode)
+    {
+        m_shutdownMode = shutdownMode;
+    }
+
+    WebsocketCloseMode WebsocketServer::shutdownMode() const
+    {
+        return m_shutdownMode;
     }
 
     void WebsocketServer::startTcpAccept(ip::tcp::acceptor& tcpAcceptor)
@@ -76,27 +138,48 @@ namespace daq::stream {
             return;
         }
 
-        {
-            std::shared_ptr<boost::beast::websocket::stream<boost::beast::tcp_stream>> websocket = std::make_shared<boost::beast::websocket::stream<boost::beast::tcp_stream>>(std::move(tcpSocket));
-            websocket->write_buffer_bytes(65536);
-            // Parameter websocket has to be passed per value to force another instance of the shared pointer!
-            boost_compatibility_utils::async_accept(*websocket, [&, websocket](const boost::system::error_code& err)
-            {
-                onUpgrade(err, websocket);
-            });
-        }
-
+        upgrade(boost::asio::generic::stream_protocol::socket(std::move(tcpSocket)));
         startTcpAccept(tcpAcceptor);
     }
 
-    void WebsocketServer::onUpgrade(const boost::system::error_code& ec, std::shared_ptr < boost::beast::websocket::stream <boost::beast::tcp_stream > > websocket)
+    void WebsocketServer::upgrade(boost::asio::generic::stream_protocol::socket&& socket)
+    {
+        std::shared_ptr<Websocket> websocket = std::make_shared<Websocket>(std::move(socket));
+        applyWebsocketOptions(*websocket, m_websocketOptions);
+        // has to be set before the handshake which negotiates compression
+        websocket->set_option(permessageDeflate(m_deflateOptions, boost::beast::role_type::server));
+        // Parameter websocket has to be passed per value to force another instance of the shared pointer!
+        boost_compatibility_utils::async_accept(*websocket, [&, websocket](const boost::system::error_code& err)
+        {
+            onUpgrade(err, websocket);
+        });
+    }
+
+    void WebsocketServer::onUpgrade(const boost::system::error_code& ec, std::shared_ptr < Websocket > websocket)
     {
         if (ec) {
             syslog(LOG_ERR, "Upgrade to websocket failed: %s", ec.message().c_str());
             return;
         }
 
-        auto stream = std::make_shared < WebsocketServerStream > (websocket);
+        auto stream = std::make_shared < WebsocketServerStream > (websocket, receiveBufferType());
+        if (m_stopped) {
+            // the handshake outlasted the server, the stream is closed instead of being handed out
+            stream->setCloseMode(m_shutdownMode);
+            stream->asyncClose([stream](const boost::system::error_code&)
+            {
+            });
+            return;
+        }
+        addStream(stream);
+        if (receiveBufferPool()) {
+            stream->setReceiveBufferPool(receiveBufferPool());
+        }
+        stream->setDeflateOptions(m_deflateOptions);
+        stream->setWebsocketOptions(m_websocketOptions);
+        if (m_egressScheduler) {
+            stream->setEgressScheduler(m_egressScheduler);
+        }
 
         auto initCb = [&, stream](const boost::system::error_code& ec)
         {
@@ -104,6 +187,9 @@ namespace daq::stream {
                 syslog(LOG_ERR, "Websocket worker init failed: %s", ec.message().c_str());
                 return;
             }
+            if (m_pingInterval.count() > 0) {
+                stream->setPingInterval(m_pingInterval);
+            }
             try {
                 m_newStreamCb(stream);
             } catch(...) {
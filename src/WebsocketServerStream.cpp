@@ -1,16 +1,54 @@
 #include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <iostream>
 
-#include <boost/asio/read.hpp>
+#include "boost/asio/ip/tcp.hpp"
+#include "boost/asio/local/stream_protocol.hpp"
 #include "boost/beast/websocket/stream.hpp"
 
 #include "stream/Defines.hpp"
+#include "stream/WebsocketRead.hpp"
 #include "stream/WebsocketServerStream.hpp"
 
 namespace daq::stream {
-    WebsocketServerStream::WebsocketServerStream(std::shared_ptr<boost::beast::websocket::stream<boost::beast::tcp_stream> > websocket)
-        : m_websocket(websocket)
+    /// \return nullptr for a TcpWebsocket, its transport does not count bytes
+    static const TransportByteCounter* byteCounter(const Websocket& websocket)
     {
+        return &websocket.next_layer().rate_policy();
+    }
+
+    static const TransportByteCounter* byteCounter(const TcpWebsocket&)
+    {
+        return nullptr;
+    }
+
+    WebsocketServerStream::WebsocketServerStream(std::shared_ptr<Websocket> websocket, ReceiveBufferType receiveBufferType)
+        : Stream(receiveBufferType)
+        , m_websocket(websocket)
+        , m_dynamicBuffer(receiveBuffer())
+        , m_handshakeBytesRead(websocket->next_layer().rate_policy().bytesRead())
+        , m_handshakeBytesWritten(websocket->next_layer().rate_policy().bytesWritten())
+        , m_rttMeter(std::make_shared < WebsocketRttMeter >(*websocket))
+        , m_closeMode(WebsocketCloseMode::Handshake)
+    {
+    }
+
+    WebsocketServerStream::WebsocketServerStream(std::shared_ptr<TcpWebsocket> websocket, ReceiveBufferType receiveBufferType)
+        : Stream(receiveBufferType)
+        , m_websocket(websocket)
+        , m_dynamicBuffer(receiveBuffer())
+        , m_handshakeBytesRead(0)
+        , m_handshakeBytesWritten(0)
+        , m_rttMeter(std::make_shared < WebsocketRttMeter >(*websocket))
+        , m_closeMode(WebsocketCloseMode::Handshake)
+    {
+    }
+
+    template < class Operation >
+    decltype(auto) WebsocketServerStream::visitWebsocket(Operation&& operation) const
+    {
+        return std::visit([&](const auto& websocket) -> decltype(auto) { return operation(*websocket); }, m_websocket);
     }
     
     void WebsocketServerStream::asyncInit(CompletionCb completionCb)
@@ -35,66 +73,226 @@ namespace daq::stream {
     
     void WebsocketServerStream::asyncClose(CompletionCb closeCb)
     {
-        m_websocket->set_option(reducedHandshakeTimeout());
-        m_websocket->async_close(boost::beast::websocket::close_code::none, closeCb);
+        if (m_closeMode != WebsocketCloseMode::Handshake) {
+            closeCb(closeWithoutHandshake());
+            return;
+        }
+        visitWebsocket([&](auto& websocket)
+        {
+            websocket.set_option(reducedHandshakeTimeout());
+            websocket.async_close(boost::beast::websocket::close_code::none, std::move(closeCb));
+        });
     }
 
     boost::system::error_code WebsocketServerStream::close()
     {
+        if (m_closeMode != WebsocketCloseMode::Handshake) {
+            return closeWithoutHandshake();
+        }
         boost::system::error_code ec;
-        m_websocket->set_option(reducedHandshakeTimeout());
-        m_websocket->close(boost::beast::websocket::close_code::none, ec);
+        visitWebsocket([&](auto& websocket)
+        {
+            websocket.set_option(reducedHandshakeTimeout());
+            websocket.close(boost::beast::websocket::close_code::none, ec);
+        });
         return ec;
     }
     
-    std::string WebsocketServerStream::endPointUrl() const
+    void WebsocketServerStream::setCloseMode(WebsocketCloseMode closeMode)
+    {
+        m_closeMode = closeMode;
+    }
+
+    WebsocketCloseMode WebsocketServerStream::closeMode() const
+    {
+        return m_closeMode;
+    }
+
+    boost::system::error_code WebsocketServerStream::closeWithoutHandshake()
+    {
+        // no further pings, one already started counts as write in progress
+        m_rttMeter->setInterval(std::chrono::milliseconds(0));
+        return visitWebsocket([&](auto& websocket)
+        {
+            auto& socket = websocket.next_layer().socket();
+            bool abort = m_closeMode == WebsocketCloseMode::Abort;
+            // the frame must not land inside another one, Beast might be writing a message, a ping or a pong
+            const TransportByteCounter* counter = byteCounter(websocket);
+            bool writing = !counter || counter->writing();
+            if (m_closeMode == WebsocketCloseMode::CloseFrame && websocket.is_open() && !writing) {
+                // frame of the server role: FIN and opcode close, no mask, 2 bytes of payload carrying the close code
+                uint16_t code = boost::beast::websocket::close_code::going_away;
+                const uint8_t closeFrame[] = { 0x88, 0x02, static_cast < uint8_t >(code >> 8), static_cast < uint8_t >(code & 0xff) };
+                // best effort, a full send buffer is not waited for
+                boost::system::error_code sendEc;
+                socket.non_blocking(true, sendEc);
+                size_t bytesSent = 0;
+                if (!sendEc) {
+                    bytesSent = socket.send(boost::asio::buffer(closeFrame), 0, sendEc);
+                }
+                if (bytesSent != 0 && bytesSent != sizeof(closeFrame)) {
+                    // the truncated frame is discarded by resetting the connection
+                    abort = true;
+                }
+            }
+
+            boost::system::error_code ec;
+            if (abort) {
+                // no lingering in the close states of TCP
+                socket.set_option(boost::asio::socket_base::linger(true, 0), ec);
+            }
+            boost::system::error_code closeEc;
+            socket.close(closeEc);
+            // also aborts the pending operations of Beast
+            websocket.next_layer().close();
+            return ec ? ec : closeEc;
+        });
+    }
+
+    /// \return false if the remote endpoint is no TCP one but a Unix domain socket
+    static bool remoteTcpEndpoint(const Websocket& websocket, boost::asio::ip::tcp::endpoint& tcpEndpoint)
+    {
+        boost::asio::generic::stream_protocol::endpoint remoteEndpoint = websocket.next_layer().socket().remote_endpoint();
+        int family = remoteEndpoint.protocol().family();
+        if (family != boost::asio::ip::tcp::v4().family() && family != boost::asio::ip::tcp::v6().family()) {
+            return false;
+        }
+        std::memcpy(tcpEndpoint.data(), remoteEndpoint.data(), remoteEndpoint.size());
+        tcpEndpoint.resize(remoteEndpoint.size());
+        return true;
+    }
+
+    static bool remoteTcpEndpoint(const TcpWebsocket& websocket, boost::asio::ip::tcp::endpoint& tcpEndpoint)
+    {
+        tcpEndpoint = websocket.next_layer().socket().remote_endpoint();
+        return true;
+    }
+
+    /// Unix domain peers usually connect without a path of their own, they are told apart by the socket handle.
+    /// \return Path of the local endpoint followed by the socket handle, empty if it is no Unix domain socket
+    static std::string localStreamId(Websocket& websocket)
     {
-        std::string streamId = m_websocket->next_layer().socket().remote_endpoint().address().to_string();
-        std::replace( streamId.begin(), streamId.end(), '.', '_');
-        streamId += std::string("_") + std::to_string(m_websocket->next_layer().socket().remote_endpoint().port());
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        auto& socket = websocket.next_layer().socket();
+        boost::asio::generic::stream_protocol::endpoint localEndpoint = socket.local_endpoint();
+        if (localEndpoint.protocol().family() != boost::asio::local::stream_protocol().family()) {
+            return "";
+        }
+        boost::asio::local::stream_protocol::endpoint unixEndpoint;
+        std::memcpy(unixEndpoint.data(), localEndpoint.data(), localEndpoint.size());
+        unixEndpoint.resize(localEndpoint.size());
+
+        // the path of an abstract socket starts with '\0'
+        std::string streamId = "local_";
+        for (char character : unixEndpoint.path()) {
+            if (character != '\0') {
+                streamId += std::isalnum(static_cast < unsigned char >(character)) ? character : '_';
+            }
+        }
+        streamId += std::string("_") + std::to_string(socket.native_handle());
         return streamId;
+#else
+        return "";
+#endif
+    }
+
+    static std::string localStreamId(TcpWebsocket&)
+    {
+        return "";
+    }
+
+    std::string WebsocketServerStream::endPointUrl() const
+    {
+        return visitWebsocket([](auto& websocket)
+        {
+            boost::asio::ip::tcp::endpoint remoteEndpoint;
+            if (!remoteTcpEndpoint(websocket, remoteEndpoint)) {
+                return localStreamId(websocket);
+            }
+            std::string streamId = remoteEndpoint.address().to_string();
+            std::replace( streamId.begin(), streamId.end(), '.', '_');
+            streamId += std::string("_") + std::to_string(remoteEndpoint.port());
+            return streamId;
+        });
     }
 
     std::string WebsocketServerStream::remoteHost() const
     {
-        std::string remoteHost = m_websocket->next_layer().socket().remote_endpoint().address().to_string();
-        return remoteHost;
+        return visitWebsocket([](auto& websocket)
+        {
+            boost::asio::ip::tcp::endpoint remoteEndpoint;
+            if (!remoteTcpEndpoint(websocket, remoteEndpoint)) {
+                // local client
+                return std::string();
+            }
+            std::string remoteHost = remoteEndpoint.address().to_string();
+            return remoteHost;
+        });
     }
     
     void WebsocketServerStream::asyncReadAtLeast(std::size_t bytesToRead, ReadCompletionCb readAtLeastCb)
     {
-        boost::asio::async_read(*m_websocket, m_buffer, boost::asio::transfer_at_least(bytesToRead), readAtLeastCb);
+        auto completionCb = [this, readAtLeastCb = std::move(readAtLeastCb)](const boost::system::error_code& ec, std::size_t bytesRead)
+        {
+            m_trafficStats.uncompressedBytesReceived += bytesRead;
+            readAtLeastCb(ec, bytesRead);
+        };
+        visitWebsocket([&](auto& websocket)
+        {
+            asyncWebsocketReadAtLeast(websocket, m_dynamicBuffer, bytesToRead, maxReadSize(), std::move(completionCb));
+        });
     }
 
     size_t WebsocketServerStream::readAtLeast(std::size_t bytesToRead, boost::system::error_code &ec)
     {
-        return boost::asio::read(*m_websocket, m_buffer, boost::asio::transfer_at_least(bytesToRead), ec);
+        size_t bytesRead = visitWebsocket([&](auto& websocket)
+        {
+            return websocketReadAtLeast(websocket, m_dynamicBuffer, bytesToRead, maxReadSize(), ec);
+        });
+        m_trafficStats.uncompressedBytesReceived += bytesRead;
+        return bytesRead;
     }
     
-    void WebsocketServerStream::asyncWrite(const boost::asio::const_buffer& data, WriteCompletionCb writeCompletionCb)
+    void WebsocketServerStream::asyncReadMessageTransport(ReadCompletionCb readCb)
     {
-#if defined(__GNUC__)
-#pragma GCC diagnostic push
-        // we want to ignore a warning coming from boost beast
-#pragma GCC diagnostic warning "-Wstrict-overflow"
-#endif
-    	
-        m_websocket->async_write(data, writeCompletionCb);
+        auto completionCb = [this, readCb = std::move(readCb)](const boost::system::error_code& ec, std::size_t bytesRead)
+        {
+            m_trafficStats.uncompressedBytesReceived += bytesRead;
+            readCb(ec, bytesRead);
+        };
+        visitWebsocket([&](auto& websocket)
+        {
+            websocket.async_read(m_dynamicBuffer, std::move(completionCb));
+        });
+    }
 
-#if defined(__GNUC__)
-#pragma GCC diagnostic pop
-#endif
+    bool WebsocketServerStream::messageBinary() const
+    {
+        return visitWebsocket([](auto& websocket) { return websocket.got_binary(); });
     }
-    
-    void WebsocketServerStream::asyncWrite(const ConstBufferVector& data, WriteCompletionCb writeCompletionCb)
+
+    bool WebsocketServerStream::messageOriented() const
+    {
+        return true;
+    }
+
+    void WebsocketServerStream::asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb)
     {
+        visitWebsocket([&](auto& websocket) { websocket.binary(!writingText()); });
+        size_t size = boost::asio::buffer_size(data);
+        adaptWriteBuffer(size);
+        compressIfWorthIt(size);
+        m_trafficStats.uncompressedBytesSent += size;
 #if defined(__GNUC__)
 #pragma GCC diagnostic push
         // we want to ignore a warning coming from boost beast
 #pragma GCC diagnostic warning "-Wstrict-overflow"
 #endif
-    	
-        m_websocket->async_write(data, writeCompletionCb);
+
+        visitWebsocket([&](auto& websocket)
+        {
+            websocket.async_write(data, std::move(writeCompletionCb));
+        });
 
 #if defined(__GNUC__)
 #pragma GCC diagnostic pop
@@ -103,19 +301,87 @@ namespace daq::stream {
 
     size_t WebsocketServerStream::write(const boost::asio::const_buffer &data, boost::system::error_code &ec)
     {
-        return m_websocket->write(data, ec);
+        adaptWriteBuffer(data.size());
+        compressIfWorthIt(data.size());
+        size_t bytesWritten = visitWebsocket([&](auto& websocket)
+        {
+            websocket.binary(true);
+            return websocket.write(data, ec);
+        });
+        m_trafficStats.uncompressedBytesSent += bytesWritten;
+        return bytesWritten;
     }
 
     size_t WebsocketServerStream::write(const ConstBufferVector &data, boost::system::error_code &ec)
     {
-        return m_websocket->write(data, ec);
+        adaptWriteBuffer(boost::asio::buffer_size(data));
+        compressIfWorthIt(boost::asio::buffer_size(data));
+        size_t bytesWritten = visitWebsocket([&](auto& websocket)
+        {
+            websocket.binary(true);
+            return websocket.write(data, ec);
+        });
+        m_trafficStats.uncompressedBytesSent += bytesWritten;
+        return bytesWritten;
     }
-    void WebsocketServerStream::setOptions()
+
+    void WebsocketServerStream::setDeflateOptions(const WebsocketDeflateOptions& deflateOptions)
+    {
+        m_deflateOptions = supportedDeflateOptions(deflateOptions);
+    }
+
+    WebsocketTrafficStats WebsocketServerStream::trafficStats() const
+    {
+        WebsocketTrafficStats trafficStats = m_trafficStats;
+        const TransportByteCounter* counter = visitWebsocket([](auto& websocket) { return byteCounter(websocket); });
+        if (counter) {
+            trafficStats.compressedBytesSent = counter->bytesWritten() - m_handshakeBytesWritten;
+            trafficStats.compressedBytesReceived = counter->bytesRead() - m_handshakeBytesRead;
+        }
+        return trafficStats;
+    }
+
+    void WebsocketServerStream::compressIfWorthIt(size_t messageSize)
+    {
+        visitWebsocket([&](auto& websocket) { compressNextMessage(websocket, messageSize >= m_deflateOptions.minMessageSize); });
+    }
+
+    void WebsocketServerStream::setWebsocketOptions(const WebsocketOptions& websocketOptions)
+    {
+        m_websocketOptions = websocketOptions;
+        m_writeBufferSizer.setOptions(websocketOptions);
+        visitWebsocket([&](auto& websocket) { applyWebsocketOptions(websocket, websocketOptions); });
+        if (websocketOptions.readBufferSize) {
+            ReadSizePolicy policy = readSizePolicy();
+            policy.maxReadSize = websocketOptions.readBufferSize;
+            policy.minReadSize = std::min(policy.minReadSize, websocketOptions.readBufferSize);
+            setReadSizePolicy(policy);
+        }
+    }
+
+    const WebsocketOptions& WebsocketServerStream::websocketOptions() const
+    {
+        return m_websocketOptions;
+    }
+
+    void WebsocketServerStream::setPingInterval(std::chrono::milliseconds interval)
+    {
+        m_rttMeter->setInterval(interval);
+    }
+
+    WebsocketRttStats WebsocketServerStream::rttStats() const
+    {
+        return m_rttMeter->stats();
+    }
+
+    void WebsocketServerStream::adaptWriteBuffer(size_t messageSize)
     {
-        m_websocket->binary(true);
-        //m_stream->auto_fragment(true);
-        m_websocket->set_option(boost::beast::websocket::stream_base::timeout::suggested(boost::beast::role_type::server));
+        size_t writeBufferSize = m_writeBufferSizer.onMessage(messageSize);
+        visitWebsocket([&](auto& websocket) { websocket.write_buffer_bytes(writeBufferSize); });
+    }
 
+    void WebsocketServerStream::setOptions()
+    {
         // Set a decorator to change the Server of the handshake
         auto autodecoratorHandler = [](boost::beast::websocket::response_type& res)
         {
@@ -123,6 +389,14 @@ namespace daq::stream {
                     std::string(BOOST_BEAST_VERSION_STRING) +
                     " stream-server");
         };
-        m_websocket->set_option(boost::beast::websocket::stream_base::decorator(autodecoratorHandler));
+        visitWebsocket([&](auto& websocket)
+        {
+            websocket.binary(true);
+            // Being unmasked, the server role writes the payload straight from the caller's memory behind a frame header built by Beast.
+            // Without fragmenting (default), each message is a single header plus a single gather write, no matter how big it is.
+            applyWebsocketOptions(websocket, m_websocketOptions);
+            websocket.set_option(boost::beast::websocket::stream_base::timeout::suggested(boost::beast::role_type::server));
+            websocket.set_option(boost::beast::websocket::stream_base::decorator(autodecoratorHandler));
+        });
     }
 }
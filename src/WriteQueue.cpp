@@ -0,0 +1,254 @@
+#include <utility>
+
+#include "stream/WriteQueue.hpp"
+
+namespace daq::stream {
+    ConstBufferView WriteQueue::Request::sequence() const
+    {
+        switch (kind) {
+        case Kind::Buffers:
+            return ConstBufferView(buffers.data(), buffers.data() + buffers.size());
+        case Kind::View:
+            return view;
+        case Kind::Prefixed:
+            return ConstBufferView(prefixed.data(), prefixed.data() + prefixed.size());
+        case Kind::Buffer:
+            break;
+        }
+        return ConstBufferView(&buffer, &buffer + 1);
+    }
+
+    WriteQueue::WriteQueue()
+        : m_requests(8)
+        , m_head(0)
+        , m_count(0)
+        , m_bytes(0)
+    {
+        for (auto& request : m_requests) {
+            request = std::make_unique < Request >();
+        }
+    }
+
+    WriteQueue::Request& WriteQueue::emplace()
+    {
+        if (m_count == m_requests.size()) {
+            // unroll the ring into a bigger one
+            std::vector < std::unique_ptr < Request > > requests(2 * m_requests.size());
+            for (size_t index = 0; index < requests.size(); ++index) {
+                if (index < m_count) {
+                    requests[index] = std::move(m_requests[(m_head + index) % m_requests.size()]);
+                } else {
+                    requests[index] = std::make_unique < Request >();
+                }
+            }
+            m_requests = std::move(requests);
+            m_head = 0;
+        }
+        Request& request = *m_requests[(m_head + m_count) % m_requests.size()];
+        ++m_count;
+        return request;
+    }
+
+    WriteQueue::Request& WriteQueue::at(size_t position)
+    {
+        return *m_requests[(m_head + position) % m_requests.size()];
+    }
+
+    const WriteQueue::Request& WriteQueue::at(size_t position) const
+    {
+        return *m_requests[(m_head + position) % m_requests.size()];
+    }
+
+    void WriteQueue::push(const boost::asio::const_buffer& data, WriteCompletionCb writeCb)
+    {
+        Request& request = emplace();
+        request.kind = Request::Kind::Buffer;
+        request.buffer = data;
+        request.bytes = data.size();
+        request.writeCb = std::move(writeCb);
+        m_bytes += request.bytes;
+    }
+
+    void WriteQueue::push(const std::vector < boost::asio::const_buffer >& data, WriteCompletionCb writeCb)
+    {
+        Request& request = emplace();
+        request.kind = Request::Kind::Buffers;
+        request.buffers = data;
+        request.bytes = boost::asio::buffer_size(data);
+        request.writeCb = std::move(writeCb);
+        m_bytes += request.bytes;
+    }
+
+    void WriteQueue::push(const ConstBufferView& data, WriteCompletionCb writeCb)
+    {
+        Request& request = emplace();
+        request.kind = Request::Kind::View;
+        request.view = data;
+        request.bytes = boost::asio::buffer_size(data);
+        request.writeCb = std::move(writeCb);
+        m_bytes += request.bytes;
+    }
+
+    void WriteQueue::pushPrefixed(const boost::asio::const_buffer& prefix, const boost::asio::const_buffer& data, WriteCompletionCb writeCb)
+    {
+        Request& request = emplace();
+        request.kind = Request::Kind::Prefixed;
+        boost::asio::buffer_copy(boost::asio::buffer(request.prefix), prefix);
+        request.prefixed[0] = boost::asio::buffer(request.prefix.data(), prefix.size());
+        request.prefixed[1] = data;
+        request.bytes = prefix.size() + data.size();
+        request.writeCb = std::move(writeCb);
+        m_bytes += request.bytes;
+    }
+
+    void WriteQueue::pushKeyed(uint64_t key, const boost::asio::const_buffer& data, WriteCompletionCb writeCb)
+    {
+        push(data, std::move(writeCb));
+        Request& request = at(m_count - 1);
+        request.keyed = true;
+        request.key = key;
+    }
+
+    void WriteQueue::pushMessage(const boost::asio::const_buffer& data, bool text, WriteCompletionCb writeCb)
+    {
+        push(data, std::move(writeCb));
+        Request& request = at(m_count - 1);
+        request.message = true;
+        request.text = text;
+    }
+
+    void WriteQueue::pushMessage(const std::vector < boost::asio::const_buffer >& data, bool text, WriteCompletionCb writeCb)
+    {
+        push(data, std::move(writeCb));
+        Request& request = at(m_count - 1);
+        request.message = true;
+        request.text = text;
+    }
+
+    bool WriteQueue::empty() const
+    {
+        return m_count == 0;
+    }
+
+    size_t WriteQueue::count() const
+    {
+        return m_count;
+    }
+
+    size_t WriteQueue::bytes() const
+    {
+        return m_bytes;
+    }
+
+    size_t WriteQueue::partiallySent() const
+    {
+        return (m_count && at(0).sent) ? 1 : 0;
+    }
+
+    void WriteQueue::append(const ConstBufferView& sequence, size_t offset, size_t size, std::vector < boost::asio::const_buffer >& gather)
+    {
+        for (const auto& buffer : sequence) {
+            if (size == 0) {
+                break;
+            }
+            if (offset >= buffer.size()) {
+                offset -= buffer.size();
+                continue;
+            }
+            boost::asio::const_buffer part = boost::asio::buffer(buffer + offset, size);
+            gather.push_back(part);
+            size -= part.size();
+            offset = 0;
+        }
+    }
+
+    size_t WriteQueue::gather(const WriteQueueOptions& options, bool coalesce, std::vector < boost::asio::const_buffer >& gather, size_t& chunkSize) const
+    {
+        gather.clear();
+        chunkSize = 0;
+        size_t bytes = 0;
+        size_t collected = 0;
+        while (collected < m_count) {
+            const Request& request = at(collected);
+            size_t remaining = request.bytes - request.sent;
+            if (request.message) {
+                if (collected == 0) {
+                    ConstBufferView sequence = request.sequence();
+                    gather.insert(gather.end(), sequence.begin(), sequence.end());
+                    ++collected;
+                }
+                break;
+            }
+            if (options.maxChunkSize && remaining > options.maxChunkSize) {
+                if (collected == 0) {
+                    append(request.sequence(), request.sent, options.maxChunkSize, gather);
+                    chunkSize = options.maxChunkSize;
+                }
+                // a big write behind others gets chunked when it is at the front
+                break;
+            }
+            ConstBufferView sequence = request.sequence();
+            if (collected > 0 &&
+                (!coalesce || bytes + remaining > options.maxCoalescedBytes || gather.size() + sequence.count() > options.maxCoalescedBuffers)) {
+                break;
+            }
+            if (request.sent) {
+                append(sequence, request.sent, remaining, gather);
+            } else {
+                gather.insert(gather.end(), sequence.begin(), sequence.end());
+            }
+            bytes += remaining;
+            ++collected;
+        }
+        return collected;
+    }
+
+    bool WriteQueue::frontIsText() const
+    {
+        return m_count && at(0).text;
+    }
+
+    void WriteQueue::advance(size_t chunkSize)
+    {
+        at(0).sent += chunkSize;
+        m_bytes -= chunkSize;
+    }
+
+    WriteQueue::WriteCompletionCb WriteQueue::pop(size_t& bytes)
+    {
+        Request& request = at(0);
+        bytes = request.bytes;
+        WriteCompletionCb writeCb = std::move(request.writeCb);
+        request.buffer = boost::asio::const_buffer();
+        request.buffers.clear();
+        request.view = ConstBufferView();
+        request.keyed = false;
+        request.message = false;
+        request.text = false;
+        m_bytes -= request.bytes - request.sent;
+        request.sent = 0;
+        m_head = (m_head + 1) % m_requests.size();
+        --m_count;
+        return writeCb;
+    }
+
+    WriteQueue::WriteCompletionCb WriteQueue::remove(size_t position, size_t& bytes)
+    {
+        // move the request to the front, the ones before it move back by one
+        for (; position > 0; --position) {
+            std::swap(m_requests[(m_head + position) % m_requests.size()], m_requests[(m_head + position - 1) % m_requests.size()]);
+        }
+        return pop(bytes);
+    }
+
+    size_t WriteQueue::find(uint64_t key, size_t first) const
+    {
+        for (size_t position = first; position < m_count; ++position) {
+            const Request& request = at(position);
+            if (request.keyed && request.key == key) {
+                return position;
+            }
+        }
+        return m_count;
+    }
+}
@@ -0,0 +1,342 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+
+#include <gtest/gtest.h>
+
+#include "stream/FramedStream.hpp"
+#include "stream/Stream.hpp"
+#include "stream/TcpClientStream.hpp"
+#include "stream/TcpServer.hpp"
+#ifndef _WIN32
+#include "stream/LocalClientStream.hpp"
+#include "stream/LocalServer.hpp"
+#endif
+
+/// Counts all allocations done through the global operator new
+static std::atomic < size_t > allocationCount(0);
+
+static void* countedAllocate(std::size_t size)
+{
+    ++allocationCount;
+    void* pointer = std::malloc(size ? size : 1);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new(std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    ++allocationCount;
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    ++allocationCount;
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+namespace daq::stream {
+    /// Client and server stream exchange messages of fixed size. The server echoes each message it receives.
+    /// Everything runs on a single io context driven by the test.
+    class PingPong {
+    public:
+        static const size_t MessageSize = 64;
+
+        /// \param messages Write by asyncWriteMessage() instead of asyncWrite()
+        PingPong(boost::asio::io_context& ioc, Stream& client, Stream& server, bool messages = false)
+            : m_ioc(ioc)
+            , m_client(client)
+            , m_server(server)
+            , m_request(MessageSize, 0x55)
+            , m_echo(MessageSize)
+            , m_roundTrips(0)
+            , m_messages(messages)
+        {
+        }
+
+        void start()
+        {
+            serverRead();
+            clientWrite();
+        }
+
+        /// Executes handlers until the given number of round trips is complete
+        void run(size_t roundTrips)
+        {
+            size_t target = m_roundTrips + roundTrips;
+            while (m_roundTrips < target) {
+                ASSERT_EQ(m_ec, boost::system::error_code());
+                m_ioc.run_one();
+            }
+        }
+
+    private:
+        void write(Stream& stream, const std::vector < uint8_t >& data, Stream::WriteCompletionCb writeCb)
+        {
+            if (m_messages) {
+                stream.asyncWriteMessage(boost::asio::buffer(data), true, std::move(writeCb));
+            } else {
+                stream.asyncWrite(boost::asio::buffer(data), std::move(writeCb));
+            }
+        }
+
+        void clientWrite()
+        {
+            write(m_client, m_request, [this](const boost::system::error_code& ec, std::size_t)
+            {
+                if (ec) {
+                    m_ec = ec;
+                    return;
+                }
+                m_client.asyncRead([this](const boost::system::error_code& ec)
+                {
+                    if (ec) {
+                        m_ec = ec;
+                        return;
+                    }
+                    m_client.consume(MessageSize);
+                    ++m_roundTrips;
+                    clientWrite();
+                }, MessageSize);
+            });
+        }
+
+        void serverRead()
+        {
+            m_server.asyncRead([this](const boost::system::error_code& ec)
+            {
+                if (ec) {
+                    m_ec = ec;
+                    return;
+                }
+                m_server.copyDataAndConsume(m_echo.data(), MessageSize);
+                write(m_server, m_echo, [this](const boost::system::error_code& ec, std::size_t)
+                {
+                    if (ec) {
+                        m_ec = ec;
+                        return;
+                    }
+                    serverRead();
+                });
+            }, MessageSize);
+        }
+
+        boost::asio::io_context& m_ioc;
+        Stream& m_client;
+        Stream& m_server;
+        std::vector < uint8_t > m_request;
+        std::vector < uint8_t > m_echo;
+        size_t m_roundTrips;
+        bool m_messages;
+        boost::system::error_code m_ec;
+    };
+
+    /// Like PingPong but with length prefixed messages of FramedStream on both sides
+    class FramedPingPong {
+    public:
+        static const size_t PayloadSize = 64;
+
+        FramedPingPong(boost::asio::io_context& ioc, StreamSharedPtr client, StreamSharedPtr server)
+            : m_ioc(ioc)
+            , m_client(std::move(client))
+            , m_server(std::move(server))
+            , m_request(PayloadSize, 0x55)
+            , m_echo(PayloadSize)
+            , m_roundTrips(0)
+        {
+        }
+
+        void start()
+        {
+            serverRead();
+            clientWrite();
+        }
+
+        /// Executes handlers until the given number of round trips is complete
+        void run(size_t roundTrips)
+        {
+            size_t target = m_roundTrips + roundTrips;
+            while (m_roundTrips < target) {
+                ASSERT_EQ(m_ec, boost::system::error_code());
+                m_ioc.run_one();
+            }
+        }
+
+    private:
+        void clientWrite()
+        {
+            m_client.asyncWriteMessage(boost::asio::buffer(m_request), [this](const boost::system::error_code& ec, std::size_t)
+            {
+                if (ec) {
+                    m_ec = ec;
+                    return;
+                }
+                m_client.asyncReadMessages([this](const boost::system::error_code& ec, const FramedStream::Messages&)
+                {
+                    if (ec) {
+                        m_ec = ec;
+                        return;
+                    }
+                    ++m_roundTrips;
+                    clientWrite();
+                });
+            });
+        }
+
+        void serverRead()
+        {
+            m_server.asyncReadMessages([this](const boost::system::error_code& ec, const FramedStream::Messages& messages)
+            {
+                if (ec) {
+                    m_ec = ec;
+                    return;
+                }
+                boost::asio::buffer_copy(boost::asio::buffer(m_echo), messages.front().payload);
+                m_server.asyncWriteMessage(boost::asio::buffer(m_echo), [this](const boost::system::error_code& ec, std::size_t)
+                {
+                    if (ec) {
+                        m_ec = ec;
+                        return;
+                    }
+                    serverRead();
+                });
+            });
+        }
+
+        boost::asio::io_context& m_ioc;
+        FramedStream m_client;
+        FramedStream m_server;
+        std::vector < uint8_t > m_request;
+        std::vector < uint8_t > m_echo;
+        size_t m_roundTrips;
+        boost::system::error_code m_ec;
+    };
+
+    static const size_t WarmupRoundTrips = 16;
+    static const size_t MeasuredRoundTrips = 1000;
+
+    static size_t allocationsOfSteadyState(boost::asio::io_context& ioc, Stream& client, Stream& server, bool messages = false)
+    {
+        PingPong pingPong(ioc, client, server, messages);
+        pingPong.start();
+        pingPong.run(WarmupRoundTrips);
+
+        size_t before = allocationCount;
+        pingPong.run(MeasuredRoundTrips);
+        return allocationCount - before;
+    }
+
+    TEST(AllocationTest, tcp_steady_state)
+    {
+        boost::asio::io_context ioc;
+        StreamSharedPtr serverStream;
+        TcpServer server(ioc, [&](StreamSharedPtr newStream) { serverStream = newStream; }, 5010);
+        ASSERT_EQ(server.start(), 0);
+
+        TcpClientStream client(ioc, "127.0.0.1", "5010");
+        ASSERT_EQ(client.init(), boost::system::error_code());
+        while (!serverStream) {
+            ioc.run_one();
+        }
+
+        ASSERT_EQ(allocationsOfSteadyState(ioc, client, *serverStream), 0);
+        server.stop();
+    }
+
+    /// A single buffer message, e.g. of BroadcastHub::publish(), is queued without allocating
+    TEST(AllocationTest, message_steady_state)
+    {
+        boost::asio::io_context ioc;
+        StreamSharedPtr serverStream;
+        TcpServer server(ioc, [&](StreamSharedPtr newStream) { serverStream = newStream; }, 5017);
+        ASSERT_EQ(server.start(), 0);
+
+        TcpClientStream client(ioc, "127.0.0.1", "5017");
+        ASSERT_EQ(client.init(), boost::system::error_code());
+        while (!serverStream) {
+            ioc.run_one();
+        }
+
+        ASSERT_EQ(allocationsOfSteadyState(ioc, client, *serverStream, true), 0);
+        server.stop();
+    }
+
+#ifndef _WIN32
+    TEST(AllocationTest, local_steady_state)
+    {
+        boost::asio::io_context ioc;
+        StreamSharedPtr serverStream;
+        LocalServer server(ioc, [&](StreamSharedPtr newStream) { serverStream = newStream; }, "allocationTestEndpoint");
+        ASSERT_EQ(server.start(), 0);
+
+        LocalClientStream client(ioc, "allocationTestEndpoint");
+        ASSERT_EQ(client.init(), boost::system::error_code());
+        while (!serverStream) {
+            ioc.run_one();
+        }
+
+        ASSERT_EQ(allocationsOfSteadyState(ioc, client, *serverStream), 0);
+        server.stop();
+    }
+#endif
+
+    /// Header and payload of framed messages are queued without allocating
+    TEST(AllocationTest, framed_steady_state)
+    {
+        boost::asio::io_context ioc;
+        StreamSharedPtr serverStream;
+        TcpServer server(ioc, [&](StreamSharedPtr newStream) { serverStream = newStream; }, 5015);
+        ASSERT_EQ(server.start(), 0);
+
+        auto client = std::make_shared < TcpClientStream >(ioc, "127.0.0.1", "5015");
+        ASSERT_EQ(client->init(), boost::system::error_code());
+        while (!serverStream) {
+            ioc.run_one();
+        }
+
+        FramedPingPong pingPong(ioc, client, serverStream);
+        pingPong.start();
+        pingPong.run(WarmupRoundTrips);
+
+        size_t before = allocationCount;
+        pingPong.run(MeasuredRoundTrips);
+        ASSERT_EQ(allocationCount - before, 0);
+        server.stop();
+    }
+}
@@ -0,0 +1,229 @@
+#include <exception>
+#include <string>
+#include <utility>
+#include <vector>
+
+// boost 1.74 awaitable.hpp uses std::exchange without including <utility>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <gtest/gtest.h>
+
+#include "stream/Awaitable.hpp"
+#include "stream/TcpClientStream.hpp"
+#include "stream/TcpServer.hpp"
+#include "stream/WebsocketClientStream.hpp"
+#include "stream/WebsocketServer.hpp"
+#include "TestStream.hpp"
+
+
+namespace daq::stream {
+    /// Coroutine type that starts immediately and is not awaited by anyone
+    struct DetachedTask {
+        struct promise_type {
+            DetachedTask get_return_object()
+            {
+                return {};
+            }
+
+            std::suspend_never initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            std::suspend_never final_suspend() noexcept
+            {
+                return {};
+            }
+
+            void return_void()
+            {
+            }
+
+            void unhandled_exception()
+            {
+                std::terminate();
+            }
+        };
+    };
+
+    /// Server echoing everything received on each new stream
+    class EchoSession {
+    public:
+        void start(StreamSharedPtr stream)
+        {
+            m_stream = stream;
+            read();
+        }
+
+    private:
+        void read()
+        {
+            m_stream->asyncReadSome([this](const boost::system::error_code& ec, std::size_t bytesRead)
+            {
+                if (ec) {
+                    return;
+                }
+                m_stream->asyncWrite(boost::asio::buffer(m_stream->data(), bytesRead), [this, bytesRead](const boost::system::error_code& ec, std::size_t)
+                {
+                    if (ec) {
+                        return;
+                    }
+                    m_stream->consume(bytesRead);
+                    read();
+                });
+            });
+        }
+
+        StreamSharedPtr m_stream;
+    };
+
+    static const uint16_t tcpPort = 5011;
+    static const uint16_t websocketPort = 5012;
+
+    static DetachedTask echoRoundTrip(Stream& client, std::string message, std::string& received, bool& done)
+    {
+        boost::system::error_code ec = co_await awaitInit(client);
+        EXPECT_EQ(ec, boost::system::error_code());
+
+        IoResult writeResult = co_await awaitWrite(client, boost::asio::buffer(message));
+        EXPECT_EQ(writeResult.ec, boost::system::error_code());
+        EXPECT_EQ(writeResult.bytesTransferred, message.size());
+
+        ec = co_await awaitRead(client, message.size());
+        EXPECT_EQ(ec, boost::system::error_code());
+        received.assign(reinterpret_cast < const char* >(client.data()), message.size());
+        client.consume(message.size());
+
+        ConstBufferVector buffers = { boost::asio::buffer(message), boost::asio::buffer(message) };
+        writeResult = co_await awaitWrite(client, buffers);
+        EXPECT_EQ(writeResult.bytesTransferred, 2 * message.size());
+        ec = co_await awaitRead(client, 2 * message.size());
+        EXPECT_EQ(ec, boost::system::error_code());
+        // the data is buffered already, this completes without suspending
+        IoResult readResult = co_await awaitReadSome(client);
+        EXPECT_EQ(readResult.ec, boost::system::error_code());
+        EXPECT_EQ(readResult.bytesTransferred, 2 * message.size());
+        client.consume(2 * message.size());
+
+        ec = co_await awaitClose(client);
+        EXPECT_EQ(ec, boost::system::error_code());
+        done = true;
+    }
+
+    TEST(AwaitableTest, tcp_awaiters)
+    {
+        boost::asio::io_context ioc;
+        EchoSession session;
+        TcpServer server(ioc, [&](StreamSharedPtr newStream) { session.start(newStream); }, tcpPort);
+        server.start();
+
+        TcpClientStream client(ioc, "127.0.0.1", std::to_string(tcpPort));
+        std::string received;
+        bool done = false;
+        echoRoundTrip(client, "hello coroutine", received, done);
+        while (!done) {
+            ioc.run_one();
+        }
+        ASSERT_EQ(received, "hello coroutine");
+        server.stop();
+    }
+
+    TEST(AwaitableTest, websocket_awaiters)
+    {
+        boost::asio::io_context ioc;
+        EchoSession session;
+        WebsocketServer server(ioc, [&](StreamSharedPtr newStream) { session.start(newStream); }, websocketPort);
+        server.start();
+
+        WebsocketClientStream client(ioc, "127.0.0.1", std::to_string(websocketPort));
+        std::string received;
+        bool done = false;
+        echoRoundTrip(client, "hello websocket", received, done);
+        while (!done) {
+            ioc.run_one();
+        }
+        ASSERT_EQ(received, "hello websocket");
+        server.stop();
+    }
+
+    TEST(AwaitableTest, tcp_use_awaitable)
+    {
+        boost::asio::io_context ioc;
+        EchoSession session;
+        TcpServer server(ioc, [&](StreamSharedPtr newStream) { session.start(newStream); }, tcpPort);
+        server.start();
+
+        TcpClientStream client(ioc, "127.0.0.1", std::to_string(tcpPort));
+        const std::string message = "hello asio";
+        std::string received;
+        bool done = false;
+        auto roundTrip = [&]() -> boost::asio::awaitable < void >
+        {
+            co_await asyncInit(client, boost::asio::use_awaitable);
+            size_t bytesWritten = co_await asyncWrite(client, boost::asio::buffer(message), boost::asio::use_awaitable);
+            EXPECT_EQ(bytesWritten, message.size());
+            co_await asyncRead(client, message.size(), boost::asio::use_awaitable);
+            size_t bytesRead = co_await asyncReadSome(client, boost::asio::use_awaitable);
+            received.assign(reinterpret_cast < const char* >(client.data()), bytesRead);
+            client.consume(bytesRead);
+            co_await asyncClose(client, boost::asio::use_awaitable);
+            done = true;
+        };
+        boost::asio::co_spawn(ioc, roundTrip, boost::asio::detached);
+        while (!done) {
+            ioc.run_one();
+        }
+        ASSERT_EQ(received, message);
+        server.stop();
+    }
+
+    /// Buffered data completes the read at once. The handler is still executed by its executor, not inside the initiating function.
+    TEST(AwaitableTest, buffered_use_awaitable)
+    {
+        boost::asio::io_context ioc;
+        TestStream stream;
+        const std::string message = "buffered";
+        stream.append(boost::asio::buffer(message));
+
+        std::string received;
+        bool onIoContext = false;
+        auto read = [&]() -> boost::asio::awaitable < void >
+        {
+            co_await asyncRead(stream, message.size(), boost::asio::use_awaitable);
+            onIoContext = ioc.get_executor().running_in_this_thread();
+            received.assign(reinterpret_cast < const char* >(stream.data()), message.size());
+            stream.consume(message.size());
+        };
+        boost::asio::co_spawn(ioc, read, boost::asio::detached);
+        ioc.run();
+        ASSERT_EQ(received, message);
+        ASSERT_TRUE(onIoContext);
+    }
+
+    TEST(AwaitableTest, buffered_strand_handler)
+    {
+        boost::asio::io_context ioc;
+        auto strand = boost::asio::make_strand(ioc);
+        TestStream stream;
+        stream.append(boost::asio::buffer("buffered", 8));
+
+        bool completed = false;
+        bool onStrand = false;
+        asyncReadSome(stream, boost::asio::bind_executor(strand, [&](const boost::system::error_code& ec, std::size_t bytesRead)
+        {
+            EXPECT_EQ(ec, boost::system::error_code());
+            EXPECT_EQ(bytesRead, 8);
+            completed = true;
+            onStrand = strand.running_in_this_thread();
+        }));
+        ASSERT_FALSE(completed);
+        ioc.run();
+        ASSERT_TRUE(completed);
+        ASSERT_TRUE(onStrand);
+    }
+}
@@ -0,0 +1,218 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+
+#include <gtest/gtest.h>
+
+#include "stream/BroadcastHub.hpp"
+#include "stream/Stream.hpp"
+#include "stream/TcpServerStream.hpp"
+#include "TestStream.hpp"
+
+
+namespace daq::stream {
+    /// Keeps the transport writes until the test completes them
+    class SubscriberStream : public TestStream
+    {
+    public:
+        SubscriberStream()
+        {
+            m_holdWrites = true;
+        }
+
+        void asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb) override
+        {
+            // copied, the memory of a message is released after its last write completed
+            for (const auto& buffer : data) {
+                m_written.push_back(std::string(static_cast < const char* >(buffer.data()), buffer.size()));
+            }
+            TestStream::asyncWriteTransport(data, std::move(writeCompletionCb));
+        }
+
+        /// Data of all transport writes
+        std::vector < std::string > m_written;
+    };
+
+    /// Counts the transport writes of a real tcp connection
+    class CountingTcpStream : public TcpServerStream
+    {
+    public:
+        using TcpServerStream::TcpServerStream;
+
+        void asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb) override
+        {
+            m_transportWrites.push_back(static_cast < size_t >(data.end() - data.begin()));
+            TcpServerStream::asyncWriteTransport(data, std::move(writeCompletionCb));
+        }
+
+        /// Number of buffers of each transport write
+        std::vector < size_t > m_transportWrites;
+    };
+
+    static BufferSlice message(const std::string& text)
+    {
+        std::shared_ptr < uint8_t > memory(new uint8_t[text.size()], std::default_delete < uint8_t[] >());
+        std::copy(text.begin(), text.end(), memory.get());
+        return BufferSlice(memory, memory.get(), text.size());
+    }
+
+    /// All subscribers send the memory of the message itself, it is released after the last one wrote it
+    TEST(BroadcastHubTest, fan_out_without_copy)
+    {
+        BroadcastHub hub;
+        auto first = std::make_shared < SubscriberStream >();
+        auto second = std::make_shared < SubscriberStream >();
+        hub.subscribe(first);
+        hub.subscribe(second);
+        ASSERT_EQ(hub.subscriberCount(), 2);
+
+        std::shared_ptr < uint8_t > memory(new uint8_t[5], std::default_delete < uint8_t[] >());
+        std::weak_ptr < uint8_t > released = memory;
+        hub.publish(BufferSlice(memory, memory.get(), 5));
+        ASSERT_EQ(first->m_transportWrites[0][0].data(), memory.get());
+        ASSERT_EQ(second->m_transportWrites[0][0].data(), memory.get());
+        memory.reset();
+
+        first->completeWrite();
+        ASSERT_FALSE(released.expired());
+        second->completeWrite();
+        ASSERT_TRUE(released.expired());
+        ASSERT_EQ(hub.stats(*first).sentMessages, 1);
+        ASSERT_EQ(hub.stats(*second).sentMessages, 1);
+    }
+
+    /// Lag is counted per subscriber, a slow one skips messages beyond the limit
+    TEST(BroadcastHubTest, lag)
+    {
+        BroadcastHubOptions options;
+        options.maxLagMessages = 2;
+        BroadcastHub hub(options);
+        auto fast = std::make_shared < SubscriberStream >();
+        auto slow = std::make_shared < SubscriberStream >();
+        hub.subscribe(fast);
+        hub.subscribe(slow);
+
+        for (const std::string text : { "a", "b", "c" }) {
+            hub.publish(message(text));
+            while (fast->writing()) {
+                fast->completeWrite();
+            }
+        }
+        ASSERT_EQ(hub.stats(*fast).lagMessages, 0);
+        ASSERT_EQ(hub.stats(*fast).sentMessages, 3);
+        ASSERT_EQ(hub.stats(*slow).lagMessages, 2);
+        ASSERT_EQ(hub.stats(*slow).lagBytes, 2);
+        ASSERT_EQ(hub.stats(*slow).skippedMessages, 1);
+        ASSERT_EQ(hub.maxLagMessages(), 2);
+
+        while (slow->writing()) {
+            slow->completeWrite();
+        }
+        ASSERT_EQ(slow->m_written, std::vector < std::string >({ "a", "b" }));
+        ASSERT_EQ(hub.maxLagMessages(), 0);
+    }
+
+    /// A new subscriber gets the cached messages first
+    TEST(BroadcastHubTest, late_join_cache)
+    {
+        BroadcastHubOptions options;
+        options.lateJoinMessages = 2;
+        BroadcastHub hub(options);
+        for (const std::string text : { "a", "b", "c" }) {
+            hub.publish(message(text));
+        }
+
+        auto late = std::make_shared < SubscriberStream >();
+        hub.subscribe(late);
+        hub.publish(message("d"));
+        while (late->writing()) {
+            late->completeWrite();
+        }
+        ASSERT_EQ(late->m_written, std::vector < std::string >({ "b", "c", "d" }));
+        // the messages queued while the first one is written are combined into one gather write
+        ASSERT_EQ(late->m_transportWrites.size(), 2);
+    }
+
+    /// Destroyed, failed and unsubscribed streams do not get further messages
+    TEST(BroadcastHubTest, remove_subscribers)
+    {
+        BroadcastHub hub;
+        auto failing = std::make_shared < SubscriberStream >();
+        auto leaving = std::make_shared < SubscriberStream >();
+        auto staying = std::make_shared < SubscriberStream >();
+        hub.subscribe(failing);
+        hub.subscribe(leaving);
+        hub.subscribe(staying);
+        {
+            auto destroyed = std::make_shared < SubscriberStream >();
+            hub.subscribe(destroyed);
+        }
+
+        hub.publish(message("a"));
+        failing->completeWrite(boost::asio::error::broken_pipe);
+        hub.unsubscribe(*leaving);
+        hub.publish(message("b"));
+        ASSERT_EQ(hub.subscriberCount(), 1);
+        ASSERT_EQ(failing->m_transportWrites.size(), 1);
+        ASSERT_EQ(leaving->m_transportWrites.size(), 1);
+        ASSERT_EQ(staying->m_transportWrites.size(), 1);
+        staying->completeWrite();
+        ASSERT_EQ(staying->m_written, std::vector < std::string >({ "a", "b" }));
+    }
+
+    /// Messages dropped by the overflow policy of a slow subscriber are skipped, the subscriber stays
+    TEST(BroadcastHubTest, drop_oldest_subscriber)
+    {
+        BroadcastHub hub;
+        auto slow = std::make_shared < SubscriberStream >();
+        WriteQueueOptions options;
+        options.overflowPolicy = WriteOverflowPolicy::DropOldest;
+        options.maxQueuedBytes = 2;
+        slow->setWriteQueueOptions(options);
+        hub.subscribe(slow);
+
+        for (const std::string text : { "a", "b", "c", "d" }) {
+            hub.publish(message(text));
+        }
+        // a is being sent, b and c made room for d
+        ASSERT_EQ(hub.subscriberCount(), 1);
+        ASSERT_EQ(hub.stats(*slow).skippedMessages, 2);
+        ASSERT_EQ(hub.stats(*slow).lagMessages, 2);
+
+        while (slow->writing()) {
+            slow->completeWrite();
+        }
+        hub.publish(message("e"));
+        slow->completeWrite();
+        ASSERT_EQ(slow->m_written, std::vector < std::string >({ "a", "d", "e" }));
+        ASSERT_EQ(hub.subscriberCount(), 1);
+        ASSERT_EQ(hub.stats(*slow).sentMessages, 3);
+    }
+
+    /// A tcp subscriber combines the messages queued while a write is in progress
+    TEST(BroadcastHubTest, tcp_subscriber_coalesced)
+    {
+        boost::asio::io_context ioc;
+        boost::asio::ip::tcp::acceptor acceptor(ioc, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+        boost::asio::ip::tcp::socket client(ioc);
+        client.connect(acceptor.local_endpoint());
+        auto subscriber = std::make_shared < CountingTcpStream >(acceptor.accept());
+
+        BroadcastHub hub;
+        hub.subscribe(subscriber);
+        for (const std::string text : { "a", "b", "c", "d" }) {
+            hub.publish(message(text));
+        }
+        ioc.run();
+        ASSERT_EQ(hub.stats(*subscriber).sentMessages, 4);
+        ASSERT_EQ(subscriber->m_transportWrites, std::vector < size_t >({ 1, 3 }));
+
+        std::string received(4, 0);
+        boost::asio::read(client, boost::asio::buffer(received));
+        ASSERT_EQ(received, "abcd");
+    }
+}
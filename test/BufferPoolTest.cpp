@@ -0,0 +1,162 @@
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "stream/ReceiveBuffer.hpp"
+
+
+namespace daq::stream {
+    static void write(ReceiveBuffer& buffer, const std::vector < uint8_t >& data)
+    {
+        boost::asio::mutable_buffer prepared = buffer.prepare(data.size());
+        ASSERT_EQ(prepared.size(), data.size());
+        memcpy(prepared.data(), data.data(), data.size());
+        buffer.commit(data.size());
+    }
+
+    static std::vector < uint8_t > pattern(size_t size, uint8_t start)
+    {
+        std::vector < uint8_t > data(size);
+        std::iota(data.begin(), data.end(), start);
+        return data;
+    }
+
+    TEST(BufferPoolTest, chunks_are_reused)
+    {
+        BufferPoolSharedPtr pool = BufferPool::create(1024, 2);
+        const uint8_t* first;
+        {
+            std::shared_ptr < uint8_t > chunk = pool->acquire(100);
+            first = chunk.get();
+            ASSERT_EQ(pool->pooledChunks(), 0);
+        }
+        ASSERT_EQ(pool->pooledChunks(), 1);
+        ASSERT_EQ(pool->acquire(1024).get(), first);
+
+        // oversized requests are not pooled
+        pool->acquire(2048);
+        ASSERT_EQ(pool->pooledChunks(), 1);
+
+        // no more than the maximum is kept
+        {
+            auto chunk1 = pool->acquire(1);
+            auto chunk2 = pool->acquire(1);
+            auto chunk3 = pool->acquire(1);
+        }
+        ASSERT_EQ(pool->pooledChunks(), 2);
+    }
+
+    TEST(BufferPoolTest, slice_keeps_pool_alive)
+    {
+        BufferSlice slice;
+        {
+            BufferPoolSharedPtr pool = BufferPool::create(16);
+            std::shared_ptr < uint8_t > chunk = pool->acquire(16);
+            memset(chunk.get(), 7, 16);
+            slice = BufferSlice(chunk, chunk.get() + 4, 8);
+        }
+        ASSERT_EQ(slice.size(), 8);
+        ASSERT_EQ(slice.data()[7], 7);
+        ASSERT_EQ(slice.subSlice(2, 3).data(), slice.data() + 2);
+    }
+
+    /// detaching does not copy, detached data is never overwritten
+    TEST(PooledReceiveBufferTest, detach)
+    {
+        BufferPoolSharedPtr pool = BufferPool::create(1024);
+        PooledReceiveBuffer buffer(pool);
+        std::vector < uint8_t > data = pattern(600, 0);
+        write(buffer, data);
+
+        const uint8_t* start = buffer.data();
+        BufferSlice slice = buffer.detach(500);
+        ASSERT_EQ(slice.data(), start);
+        ASSERT_EQ(buffer.size(), 100);
+
+        // does not fit behind the data anymore, the rest moves to a fresh chunk
+        std::vector < uint8_t > moreData = pattern(800, 3);
+        write(buffer, moreData);
+        ASSERT_EQ(buffer.size(), 900);
+        ASSERT_EQ(memcmp(buffer.data(), data.data() + 500, 100), 0);
+        ASSERT_EQ(memcmp(buffer.data() + 100, moreData.data(), moreData.size()), 0);
+        ASSERT_EQ(memcmp(slice.data(), data.data(), slice.size()), 0);
+
+        // the first chunk returns to the pool when the slice is released
+        ASSERT_EQ(pool->pooledChunks(), 0);
+        slice = BufferSlice();
+        ASSERT_EQ(pool->pooledChunks(), 1);
+    }
+
+    /// without detached slices the chunk is reused in place
+    TEST(PooledReceiveBufferTest, consume_reuses_chunk)
+    {
+        PooledReceiveBuffer buffer(BufferPool::create(1024));
+        write(buffer, pattern(600, 0));
+        const uint8_t* start = buffer.data();
+        buffer.consume(500);
+        write(buffer, pattern(800, 3));
+        ASSERT_EQ(buffer.data(), start);
+        ASSERT_EQ(buffer.size(), 900);
+
+        // bigger than a chunk
+        write(buffer, pattern(2000, 5));
+        ASSERT_EQ(buffer.size(), 2900);
+    }
+
+    /// a chunk that had a slice detached is not reused in place, even after the slice got released
+    TEST(PooledReceiveBufferTest, released_slice_not_reused_in_place)
+    {
+        BufferPoolSharedPtr pool = BufferPool::create(1024);
+        PooledReceiveBuffer buffer(pool);
+        std::vector < uint8_t > data = pattern(600, 0);
+        write(buffer, data);
+        const uint8_t* start = buffer.data();
+        buffer.detach(600);
+        ASSERT_EQ(buffer.size(), 0);
+
+        // the released chunk comes back through the pool only
+        write(buffer, pattern(800, 3));
+        ASSERT_NE(buffer.data(), start);
+        ASSERT_EQ(pool->pooledChunks(), 1);
+    }
+
+    /// streams share a pool by switching to it
+    TEST(PooledReceiveBufferTest, set_pool)
+    {
+        BufferPoolSharedPtr shared = BufferPool::create(1024);
+        PooledReceiveBuffer first(BufferPool::create(1024));
+        PooledReceiveBuffer second(BufferPool::create(1024));
+        std::vector < uint8_t > data = pattern(100, 0);
+        write(first, data);
+        first.setPool(shared);
+        second.setPool(shared);
+        ASSERT_EQ(first.size(), 100);
+        ASSERT_EQ(memcmp(first.data(), data.data(), data.size()), 0);
+
+        BufferSlice slice = first.detach(100);
+        const uint8_t* releasedChunk = slice.data();
+        write(first, pattern(1000, 3));
+        slice = BufferSlice();
+        ASSERT_EQ(shared->pooledChunks(), 1);
+
+        // the chunk released by the first buffer is taken by the second one
+        write(second, pattern(1000, 5));
+        second.detach(1000);
+        write(second, pattern(100, 7));
+        ASSERT_EQ(second.data(), releasedChunk);
+    }
+
+    TEST(ReceiveBufferTest, detach_copies)
+    {
+        boost::asio::streambuf streambuf;
+        StreambufReceiveBuffer buffer(streambuf);
+        std::vector < uint8_t > data = pattern(100, 0);
+        write(buffer, data);
+        BufferSlice slice = buffer.detach(200);
+        ASSERT_EQ(slice.size(), 100);
+        ASSERT_EQ(buffer.size(), 0);
+        ASSERT_EQ(memcmp(slice.data(), data.data(), data.size()), 0);
+    }
+}
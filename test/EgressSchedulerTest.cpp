@@ -0,0 +1,254 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+
+#include <gtest/gtest.h>
+
+#include "stream/EgressScheduler.hpp"
+#include "stream/Stream.hpp"
+#include "stream/TokenBucket.hpp"
+#include "TestStream.hpp"
+
+
+namespace daq::stream {
+    /// Transport writes complete when the test tells so. All transport writes are recorded in one log shared by the streams.
+    class ScheduledStream : public TestStream
+    {
+    public:
+        ScheduledStream(char name, std::string& log)
+            : m_name(name)
+            , m_log(log)
+        {
+            m_holdWrites = true;
+        }
+
+        void asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb) override
+        {
+            m_log += m_name;
+            TestStream::asyncWriteTransport(data, std::move(writeCompletionCb));
+        }
+
+    private:
+        char m_name;
+        std::string& m_log;
+    };
+
+    static void noop(const boost::system::error_code&, std::size_t)
+    {
+    }
+
+    /// Complete writes in the order the scheduler granted them
+    static void completeAll(std::vector < ScheduledStream* > streams)
+    {
+        bool any = true;
+        while (any) {
+            any = false;
+            for (auto stream : streams) {
+                if (stream->writing()) {
+                    stream->completeWrite();
+                    any = true;
+                }
+            }
+        }
+    }
+
+    TEST(TokenBucketTest, rate_and_debt)
+    {
+        using Clock = TokenBucket::Clock;
+        Clock::time_point start = Clock::now();
+        TokenBucket bucket(1000, 100, start);
+        ASSERT_TRUE(bucket.available(start));
+        ASSERT_EQ(bucket.budget(start), 100);
+        // more than the burst is allowed, the debt has to be paid back
+        bucket.consume(600, start);
+        ASSERT_FALSE(bucket.available(start));
+        ASSERT_GE(bucket.delay(start), std::chrono::milliseconds(500));
+        ASSERT_LE(bucket.delay(start), std::chrono::milliseconds(502));
+        ASSERT_EQ(bucket.budget(start), 0);
+        // time until the budget allows a given amount
+        ASSERT_GE(bucket.delay(50, start), std::chrono::milliseconds(550));
+        ASSERT_LE(bucket.delay(50, start), std::chrono::milliseconds(551));
+        ASSERT_FALSE(bucket.available(start + std::chrono::milliseconds(500)));
+        ASSERT_TRUE(bucket.available(start + std::chrono::milliseconds(502)));
+        ASSERT_GE(bucket.budget(start + std::chrono::milliseconds(551)), 50);
+        ASSERT_LE(bucket.budget(start + std::chrono::milliseconds(551)), 51);
+
+        // collected budget is limited by the burst size
+        Clock::time_point later = start + std::chrono::seconds(10);
+        bucket.consume(100, later);
+        ASSERT_FALSE(bucket.available(later));
+
+        TokenBucket unlimited;
+        unlimited.consume(1000000);
+        ASSERT_TRUE(unlimited.available());
+        ASSERT_EQ(unlimited.delay(), TokenBucket::Clock::duration::zero());
+    }
+
+    /// Streams take turns, a stream of weight 3 sends three times as much
+    TEST(EgressSchedulerTest, weighted_round_robin)
+    {
+        boost::asio::io_context ioContext;
+        EgressSchedulerOptions options;
+        options.quantum = 100;
+        options.maxConcurrentWrites = 1;
+        auto scheduler = std::make_shared < EgressScheduler >(ioContext, options);
+
+        std::string log;
+        ScheduledStream a('a', log);
+        ScheduledStream b('b', log);
+        a.setEgressScheduler(scheduler);
+        b.setEgressScheduler(scheduler);
+        scheduler->setWeight(b, 3);
+        ASSERT_EQ(scheduler->weight(b), 3);
+
+        WriteQueueOptions queueOptions;
+        queueOptions.maxCoalescedBytes = 100;
+        a.setWriteQueueOptions(queueOptions);
+        b.setWriteQueueOptions(queueOptions);
+
+        std::string data(100, 'x');
+        // a is greedy and queues first
+        for (size_t index = 0; index < 12; ++index) {
+            a.asyncWrite(boost::asio::buffer(data), noop);
+        }
+        for (size_t index = 0; index < 12; ++index) {
+            b.asyncWrite(boost::asio::buffer(data), noop);
+        }
+        completeAll({ &a, &b });
+        ASSERT_EQ(log, "abbbabbbabbbabbbaaaaaaaa");
+        ASSERT_EQ(scheduler->sentBytes(a), 1200);
+        ASSERT_EQ(scheduler->sentBytes(b), 1200);
+    }
+
+    /// A big write is charged completely, the other stream catches up before the big one continues
+    TEST(EgressSchedulerTest, big_write_is_paid_back)
+    {
+        boost::asio::io_context ioContext;
+        EgressSchedulerOptions options;
+        options.quantum = 100;
+        options.maxConcurrentWrites = 1;
+        auto scheduler = std::make_shared < EgressScheduler >(ioContext, options);
+
+        std::string log;
+        ScheduledStream a('a', log);
+        ScheduledStream b('b', log);
+        a.setEgressScheduler(scheduler);
+        b.setEgressScheduler(scheduler);
+
+        WriteQueueOptions queueOptions;
+        queueOptions.maxCoalescedBytes = 100;
+        b.setWriteQueueOptions(queueOptions);
+
+        std::string big(400, 'x');
+        std::string small(100, 'x');
+        a.asyncWrite(boost::asio::buffer(big), noop);
+        a.asyncWrite(boost::asio::buffer(small), noop);
+        for (size_t index = 0; index < 5; ++index) {
+            b.asyncWrite(boost::asio::buffer(small), noop);
+        }
+        completeAll({ &a, &b });
+        ASSERT_EQ(log, "abbbbab");
+    }
+
+    /// Without budget left, waiting streams get their turn from the timer
+    TEST(EgressSchedulerTest, global_budget)
+    {
+        boost::asio::io_context ioContext;
+        EgressSchedulerOptions options;
+        options.bytesPerSecond = 10000;
+        options.burstBytes = 1000;
+        auto scheduler = std::make_shared < EgressScheduler >(ioContext, options);
+
+        std::string log;
+        ScheduledStream a('a', log);
+        ScheduledStream b('b', log);
+        a.setEgressScheduler(scheduler);
+        b.setEgressScheduler(scheduler);
+
+        std::string big(2000, 'x');
+        std::string data(1000, 'x');
+        auto start = std::chrono::steady_clock::now();
+        // exceeds the burst by 1000 bytes
+        a.asyncWrite(boost::asio::buffer(big), noop);
+        b.asyncWrite(boost::asio::buffer(data), noop);
+        ASSERT_EQ(log, "a");
+        ASSERT_EQ(scheduler->waitingStreams(), 1);
+
+        ioContext.run();
+        ASSERT_EQ(log, "ab");
+        // 1000 bytes of debt take 100ms at 10000 bytes per second
+        ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+        a.completeWrite();
+        b.completeWrite();
+    }
+
+    /// A stream waiting for its own write rate limit does not keep others from writing
+    TEST(EgressSchedulerTest, rate_limited_stream_yields)
+    {
+        boost::asio::io_context ioContext;
+        EgressSchedulerOptions options;
+        options.maxConcurrentWrites = 1;
+        auto scheduler = std::make_shared < EgressScheduler >(ioContext, options);
+
+        std::string log;
+        ScheduledStream a('a', log);
+        ScheduledStream b('b', log);
+        a.setEgressScheduler(scheduler);
+        b.setEgressScheduler(scheduler);
+        a.setWriteRateLimit(ioContext, 10000, 100);
+
+        std::string big(1000, 'x');
+        std::string data(10, 'x');
+        a.asyncWrite(boost::asio::buffer(big), noop);
+        a.asyncWrite(boost::asio::buffer(data), noop);
+        b.asyncWrite(boost::asio::buffer(data), noop);
+        ASSERT_EQ(log, "a");
+
+        // a is in debt now and waits, b gets the turn
+        a.completeWrite();
+        ASSERT_EQ(log, "ab");
+        b.completeWrite();
+
+        ioContext.run();
+        ASSERT_EQ(log, "aba");
+        a.completeWrite();
+        ASSERT_FALSE(a.writing());
+    }
+
+    /// A stream destroyed while waiting for its turn is forgotten
+    TEST(EgressSchedulerTest, destroy_waiting_stream)
+    {
+        boost::asio::io_context ioContext;
+        EgressSchedulerOptions options;
+        options.maxConcurrentWrites = 1;
+        auto scheduler = std::make_shared < EgressScheduler >(ioContext, options);
+
+        std::string log;
+        ScheduledStream a('a', log);
+        std::string data = "data";
+        a.setEgressScheduler(scheduler);
+        a.asyncWrite(boost::asio::buffer(data), noop);
+        {
+            ScheduledStream b('b', log);
+            b.setEgressScheduler(scheduler);
+            b.asyncWrite(boost::asio::buffer(data), noop);
+            ASSERT_EQ(scheduler->waitingStreams(), 1);
+        }
+        ASSERT_EQ(scheduler->waitingStreams(), 0);
+        a.completeWrite();
+        ASSERT_EQ(log, "a");
+
+        // detaching lets a waiting stream write on its own
+        a.asyncWrite(boost::asio::buffer(data), noop);
+        ScheduledStream c('c', log);
+        c.setEgressScheduler(scheduler);
+        c.asyncWrite(boost::asio::buffer(data), noop);
+        c.setEgressScheduler(nullptr);
+        ASSERT_EQ(log, "aac");
+        a.completeWrite();
+        c.completeWrite();
+    }
+}
@@ -122,6 +122,59 @@ namespace daq::stream {
         std::remove(fileName.c_str());
     }
 
+    /// buffered data is returned first, the rest is read directly into the memory of the caller
+    TEST(FileStreamTest, readInto)
+    {
+        std::string fileName = "theFile";
+        std::string expectedContent(100, 'x');
+        for (size_t index = 0; index < expectedContent.size(); ++index) {
+            expectedContent[index] = static_cast < char > ('a' + index % 26);
+        }
+        {
+            std::ofstream file;
+            file.open(fileName, std::ios_base::trunc);
+            file << expectedContent;
+            file.close();
+        }
+
+        boost::asio::io_context m_ioContext;
+        FileStream fileStream(m_ioContext, fileName, false);
+        ReadSizePolicy policy;
+        policy.minReadSize = 16;
+        policy.maxReadSize = 16;
+        fileStream.setReadSizePolicy(policy);
+        boost::system::error_code ec = fileStream.init();
+        ASSERT_EQ(ec, boost::system::error_code());
+
+        ec = fileStream.read(4);
+        ASSERT_EQ(ec, boost::system::error_code());
+        ASSERT_EQ(fileStream.size(), 16);
+        std::string result(reinterpret_cast < const char* >(fileStream.data()), 4);
+        fileStream.consume(4);
+
+        char buffer[200];
+        size_t bytesRead = fileStream.readInto(boost::asio::buffer(buffer), ec);
+        ASSERT_EQ(ec, boost::system::error_code());
+        ASSERT_EQ(bytesRead, 12);
+        result += std::string(buffer, bytesRead);
+
+        auto readCb = [&](const boost::system::error_code& waitEc)
+        {
+            ASSERT_EQ(waitEc, boost::system::error_code());
+            size_t count = fileStream.readInto(boost::asio::buffer(buffer), ec);
+            ASSERT_EQ(ec, boost::system::error_code());
+            result += std::string(buffer, count);
+        };
+        fileStream.asyncWaitReadable(readCb);
+        m_ioContext.run();
+        ASSERT_EQ(result, expectedContent);
+
+        fileStream.readInto(boost::asio::buffer(buffer), ec);
+        ASSERT_EQ(ec, boost::asio::error::eof);
+
+        std::remove(fileName.c_str());
+    }
+
     TEST(FileStreamTest, empty_file)
     {
         std::string fileName = "theFile";
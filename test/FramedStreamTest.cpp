@@ -0,0 +1,253 @@
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <boost/asio/error.hpp>
+
+#include <gtest/gtest.h>
+
+#include "stream/FramedStream.hpp"
+#include "TestStream.hpp"
+
+
+namespace daq::stream {
+    static void roundTrip(const FrameHeaderFormat& format, uint64_t payloadSize, size_t expectedHeaderSize)
+    {
+        uint8_t header[FramedStream::MaxHeaderSize];
+        size_t headerSize = FramedStream::encodeHeader(format, 7, payloadSize, header);
+        ASSERT_EQ(headerSize, expectedHeaderSize);
+
+        uint64_t decodedPayloadSize;
+        uint8_t type;
+        ASSERT_EQ(FramedStream::decodeHeader(format, header, headerSize, decodedPayloadSize, type), headerSize);
+        ASSERT_EQ(decodedPayloadSize, payloadSize);
+        ASSERT_EQ(type, format.typeByte ? 7 : 0);
+        // incomplete header
+        ASSERT_EQ(FramedStream::decodeHeader(format, header, headerSize - 1, decodedPayloadSize, type), 0);
+    }
+
+    TEST(FramedStreamTest, header_formats)
+    {
+        FrameHeaderFormat format;
+        roundTrip(format, 0x01020304, 4);
+
+        format.typeByte = true;
+        format.length = FrameHeaderFormat::Length::UInt8;
+        roundTrip(format, 200, 2);
+        format.length = FrameHeaderFormat::Length::UInt16;
+        roundTrip(format, 0x1234, 3);
+        format.length = FrameHeaderFormat::Length::UInt64;
+        format.byteOrder = FrameHeaderFormat::ByteOrder::LittleEndian;
+        roundTrip(format, 0x0102030405060708, 9);
+
+        format.typeByte = false;
+        format.length = FrameHeaderFormat::Length::Varint;
+        roundTrip(format, 0, 1);
+        roundTrip(format, 127, 1);
+        roundTrip(format, 128, 2);
+        roundTrip(format, 300, 2);
+        roundTrip(format, UINT64_MAX, 10);
+    }
+
+    TEST(FramedStreamTest, byte_order)
+    {
+        FrameHeaderFormat format;
+        format.length = FrameHeaderFormat::Length::UInt16;
+        uint8_t header[FramedStream::MaxHeaderSize];
+
+        FramedStream::encodeHeader(format, 0, 0x1234, header);
+        ASSERT_EQ(header[0], 0x12);
+        ASSERT_EQ(header[1], 0x34);
+
+        format.byteOrder = FrameHeaderFormat::ByteOrder::LittleEndian;
+        FramedStream::encodeHeader(format, 0, 0x1234, header);
+        ASSERT_EQ(header[0], 0x34);
+        ASSERT_EQ(header[1], 0x12);
+    }
+
+    TEST(FramedStreamTest, write_read_messages)
+    {
+        FrameHeaderFormat format;
+        format.length = FrameHeaderFormat::Length::Varint;
+        format.typeByte = true;
+        auto loopback = std::make_shared < TestStream >();
+        FramedStream framedStream(loopback, format);
+
+        std::vector < std::string > payloads = { "first", "", std::string(1000, 'x') };
+        uint8_t type = 1;
+        for (const std::string& payload : payloads) {
+            framedStream.asyncWriteMessage(type++, boost::asio::buffer(payload), [](const boost::system::error_code& ec, std::size_t)
+            {
+                ASSERT_EQ(ec, boost::system::error_code());
+            });
+        }
+        // header and payload are written at once
+        ASSERT_EQ(loopback->m_transportWrites.size(), payloads.size());
+
+        std::vector < std::string > received;
+        std::vector < uint8_t > types;
+        auto messagesCb = [&](const boost::system::error_code& ec, const FramedStream::Messages& messages)
+        {
+            ASSERT_EQ(ec, boost::system::error_code());
+            for (const FramedStream::Message& message : messages) {
+                types.push_back(message.type);
+                received.push_back(std::string(static_cast < const char* >(message.payload.data()), message.payload.size()));
+            }
+        };
+        framedStream.asyncReadMessages(messagesCb);
+        ASSERT_EQ(received, payloads);
+        ASSERT_EQ(types, std::vector < uint8_t >({ 1, 2, 3 }));
+        ASSERT_EQ(loopback->size(), 0);
+    }
+
+    TEST(FramedStreamTest, queued_messages)
+    {
+        auto loopback = std::make_shared < TestStream >();
+        loopback->m_holdWrites = true;
+        FramedStream framedStream(loopback);
+
+        // the first write is pending on the transport while the others get queued
+        std::vector < std::string > payloads = { "first", "second message", "third" };
+        size_t completed = 0;
+        for (const std::string& payload : payloads) {
+            framedStream.asyncWriteMessage(boost::asio::buffer(payload), [&completed, &payload](const boost::system::error_code& ec, std::size_t bytesWritten)
+            {
+                ASSERT_EQ(ec, boost::system::error_code());
+                ASSERT_EQ(bytesWritten, 4 + payload.size());
+                ++completed;
+            });
+        }
+        ASSERT_EQ(completed, 0);
+        loopback->m_holdWrites = false;
+        loopback->completeWrite();
+        ASSERT_EQ(completed, payloads.size());
+
+        std::vector < std::string > received;
+        framedStream.asyncReadMessages([&received](const boost::system::error_code& ec, const FramedStream::Messages& messages)
+        {
+            ASSERT_EQ(ec, boost::system::error_code());
+            for (const FramedStream::Message& message : messages) {
+                received.push_back(std::string(static_cast < const char* >(message.payload.data()), message.payload.size()));
+            }
+        });
+        ASSERT_EQ(received, payloads);
+    }
+
+    TEST(FramedStreamTest, payload_too_big)
+    {
+        FrameHeaderFormat format;
+        format.maxPayloadSize = 10;
+        auto loopback = std::make_shared < TestStream >();
+        FramedStream framedStream(loopback, format);
+
+        // a peer not respecting the limit
+        uint8_t header[FramedStream::MaxHeaderSize];
+        std::string payload(11, 'x');
+        size_t headerSize = FramedStream::encodeHeader(format, 0, payload.size(), header);
+        loopback->append(boost::asio::buffer(header, headerSize));
+        loopback->append(boost::asio::buffer(payload));
+
+        boost::system::error_code readEc;
+        framedStream.asyncReadMessages([&readEc](const boost::system::error_code& ec, const FramedStream::Messages& messages)
+        {
+            readEc = ec;
+            ASSERT_TRUE(messages.empty());
+        });
+        ASSERT_EQ(readEc, boost::asio::error::message_size);
+    }
+
+    /// The frame length including the header must not wrap around
+    TEST(FramedStreamTest, max_payload_size_limited)
+    {
+        FrameHeaderFormat format;
+        format.length = FrameHeaderFormat::Length::UInt64;
+        format.maxPayloadSize = UINT64_MAX;
+        auto loopback = std::make_shared < TestStream >();
+        FramedStream framedStream(loopback, format);
+        ASSERT_LT(framedStream.format().maxPayloadSize, std::numeric_limits < size_t >::max() - FramedStream::MaxHeaderSize);
+
+        uint8_t header[FramedStream::MaxHeaderSize];
+        size_t headerSize = FramedStream::encodeHeader(format, 0, UINT64_MAX - 4, header);
+        loopback->append(boost::asio::buffer(header, headerSize));
+
+        boost::system::error_code readEc;
+        framedStream.asyncReadMessages([&readEc](const boost::system::error_code& ec, const FramedStream::Messages&)
+        {
+            readEc = ec;
+        });
+        ASSERT_EQ(readEc, boost::asio::error::message_size);
+    }
+
+    TEST(FramedStreamTest, write_payload_too_big)
+    {
+        FrameHeaderFormat format;
+        format.maxPayloadSize = 10;
+        auto loopback = std::make_shared < TestStream >();
+        FramedStream framedStream(loopback, format);
+
+        std::string payload(11, 'x');
+        boost::system::error_code ec;
+        ASSERT_EQ(framedStream.writeMessage(0, boost::asio::buffer(payload), ec), 0);
+        ASSERT_EQ(ec, boost::asio::error::message_size);
+
+        boost::system::error_code writeEc;
+        framedStream.asyncWriteMessage(boost::asio::buffer(payload), [&writeEc](const boost::system::error_code& ec, std::size_t bytesWritten)
+        {
+            writeEc = ec;
+            ASSERT_EQ(bytesWritten, 0);
+        });
+        ASSERT_EQ(writeEc, boost::asio::error::message_size);
+        ASSERT_TRUE(loopback->m_transportWrites.empty());
+        ASSERT_EQ(loopback->size(), 0);
+    }
+
+    TEST(FramedStreamTest, write_payload_exceeds_length_field)
+    {
+        FrameHeaderFormat format;
+        format.length = FrameHeaderFormat::Length::UInt8;
+        auto loopback = std::make_shared < TestStream >();
+        FramedStream framedStream(loopback, format);
+
+        std::string payload(256, 'x');
+        boost::system::error_code ec;
+        ASSERT_EQ(framedStream.writeMessage(0, boost::asio::buffer(payload), ec), 0);
+        ASSERT_EQ(ec, boost::asio::error::message_size);
+
+        boost::system::error_code writeEc;
+        framedStream.asyncWriteMessage(boost::asio::buffer(payload), [&writeEc](const boost::system::error_code& ec, std::size_t)
+        {
+            writeEc = ec;
+        });
+        ASSERT_EQ(writeEc, boost::asio::error::message_size);
+        ASSERT_TRUE(loopback->m_transportWrites.empty());
+        ASSERT_EQ(loopback->size(), 0);
+
+        // the biggest payload fitting still gets written
+        payload.resize(255);
+        ec.clear();
+        ASSERT_EQ(framedStream.writeMessage(0, boost::asio::buffer(payload), ec), 1 + payload.size());
+        ASSERT_EQ(ec, boost::system::error_code());
+
+        format.length = FrameHeaderFormat::Length::UInt16;
+        FramedStream framedStream16(loopback, format);
+        payload.resize(65536);
+        framedStream16.writeMessage(0, boost::asio::buffer(payload), ec);
+        ASSERT_EQ(ec, boost::asio::error::message_size);
+    }
+
+    TEST(FramedStreamTest, varint_exceeding_64_bits)
+    {
+        FrameHeaderFormat format;
+        format.length = FrameHeaderFormat::Length::Varint;
+        uint8_t header[FramedStream::MaxHeaderSize];
+        ASSERT_EQ(FramedStream::encodeHeader(format, 0, UINT64_MAX, header), 10);
+        ASSERT_EQ(header[9], 1);
+
+        uint64_t payloadSize;
+        uint8_t type;
+        header[9] = 2;
+        ASSERT_EQ(FramedStream::decodeHeader(format, header, 10, payloadSize, type), Stream::InvalidFrameLength);
+        header[9] = 0x7f;
+        ASSERT_EQ(FramedStream::decodeHeader(format, header, 10, payloadSize, type), Stream::InvalidFrameLength);
+    }
+}
@@ -1,7 +1,10 @@
 #include <functional>
 #include <future>
+#include <string>
 #include <thread>
+#include <vector>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
 
 #include <gtest/gtest.h>
 
@@ -10,6 +13,8 @@
 
 #include "stream/LocalServer.hpp"
 #include "stream/LocalServerStream.hpp"
+#include "stream/LocalWebsocketClientStream.hpp"
+#include "stream/LocalWebsocketServer.hpp"
 
 
 namespace daq::stream {
@@ -461,4 +466,82 @@ namespace daq::stream {
             ASSERT_EQ(response, GoodByeMsg);
         }
     }
+
+    /// Websocket over a Unix domain socket: messages keep their boundaries, synchronous and asynchronous connect
+    TEST(LocalWebsocketServer, test_messages)
+    {
+        static const std::string localWebsocketEndpointFile = "theWebsocketEndpoint";
+        static const std::string message = "hello local websocket!";
+
+        boost::asio::io_context ioContext;
+        std::vector < std::shared_ptr < WebsocketServerStream > > serverStreams;
+        auto newStreamCb = [&](StreamSharedPtr newStream)
+        {
+            auto serverStream = std::dynamic_pointer_cast < WebsocketServerStream >(newStream);
+            ASSERT_TRUE(serverStream);
+            ASSERT_EQ(serverStream->remoteHost(), "");
+            serverStreams.push_back(serverStream);
+            // echo one message
+            serverStream->asyncReadMessage([serverStream](const boost::system::error_code& ec, const ConstBufferView& received, bool binary)
+            {
+                ASSERT_FALSE(ec);
+                std::vector < uint8_t > data(boost::asio::buffer_size(received));
+                boost::asio::buffer_copy(boost::asio::buffer(data), received);
+                auto echo = std::make_shared < std::vector < uint8_t > >(std::move(data));
+                serverStream->asyncWriteMessage(boost::asio::buffer(*echo), binary, [echo](const boost::system::error_code&, std::size_t) {});
+            });
+        };
+        LocalWebsocketServer server(ioContext, newStreamCb, localWebsocketEndpointFile);
+        ASSERT_EQ(server.start(), 0);
+
+        std::vector < std::string > responses;
+        auto readResponse = [&](LocalWebsocketClientStream& client)
+        {
+            client.asyncReadMessage([&](const boost::system::error_code& ec, const ConstBufferView& received, bool binary)
+            {
+                ASSERT_FALSE(ec);
+                ASSERT_FALSE(binary);
+                std::string response(boost::asio::buffer_size(received), '\0');
+                boost::asio::buffer_copy(boost::asio::buffer(response), received);
+                responses.push_back(response);
+                if (responses.size() == 2) {
+                    ioContext.stop();
+                }
+            });
+        };
+
+        LocalWebsocketClientStream asyncClient(ioContext, localWebsocketEndpointFile);
+        ASSERT_EQ(asyncClient.endPointUrl(), localWebsocketEndpointFile);
+        asyncClient.asyncInit([&](const boost::system::error_code& ec)
+        {
+            ASSERT_FALSE(ec);
+            asyncClient.asyncWriteMessage(boost::asio::buffer(message), false, [](const boost::system::error_code&, std::size_t) {});
+            readResponse(asyncClient);
+        });
+
+        LocalWebsocketClientStream syncClient(ioContext, localWebsocketEndpointFile);
+        std::thread serverThread([&]()
+        {
+            ioContext.run();
+        });
+        ASSERT_FALSE(syncClient.init());
+        boost::asio::post(ioContext, [&]()
+        {
+            syncClient.asyncWriteMessage(boost::asio::buffer(message), false, [](const boost::system::error_code&, std::size_t) {});
+            readResponse(syncClient);
+        });
+        serverThread.join();
+        server.stop();
+
+        ASSERT_EQ(responses, std::vector < std::string >(2, message));
+        ASSERT_EQ(serverStreams.size(), 2);
+        // told apart by the socket handle, the clients have no path of their own
+        std::string localPrefix = "local_" + localWebsocketEndpointFile + "_";
+        ASSERT_EQ(serverStreams[0]->endPointUrl().rfind(localPrefix, 0), 0);
+        ASSERT_EQ(serverStreams[1]->endPointUrl().rfind(localPrefix, 0), 0);
+        ASSERT_NE(serverStreams[0]->endPointUrl(), serverStreams[1]->endPointUrl());
+
+        LocalWebsocketClientStream wrongEndpointClient(ioContext, localWebsocketEndpointFile + "bla");
+        ASSERT_TRUE(wrongEndpointClient.init());
+    }
 }
@@ -0,0 +1,93 @@
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+
+#include <gtest/gtest.h>
+
+#include "stream/MirroredRingBuffer.hpp"
+
+
+namespace daq::stream {
+    static void write(ReceiveBuffer& buffer, const std::vector < uint8_t >& data)
+    {
+        boost::asio::mutable_buffer prepared = buffer.prepare(data.size());
+        ASSERT_EQ(prepared.size(), data.size());
+        memcpy(prepared.data(), data.data(), data.size());
+        buffer.commit(data.size());
+    }
+
+    static std::vector < uint8_t > pattern(size_t size, uint8_t start)
+    {
+        std::vector < uint8_t > data(size);
+        std::iota(data.begin(), data.end(), start);
+        return data;
+    }
+
+    TEST(MirroredRingBufferTest, capacity_is_page_aligned)
+    {
+        MirroredRingBuffer buffer(1);
+        ASSERT_GE(buffer.capacity(), 1);
+        ASSERT_EQ(buffer.capacity() % 4096, 0);
+        ASSERT_EQ(buffer.size(), 0);
+    }
+
+    TEST(MirroredRingBufferTest, commit_consume)
+    {
+        MirroredRingBuffer buffer;
+        std::vector < uint8_t > data = pattern(100, 0);
+        write(buffer, data);
+        ASSERT_EQ(buffer.size(), data.size());
+        ASSERT_EQ(memcmp(buffer.data(), data.data(), data.size()), 0);
+
+        buffer.consume(10);
+        ASSERT_EQ(buffer.size(), data.size() - 10);
+        ASSERT_EQ(memcmp(buffer.data(), data.data() + 10, data.size() - 10), 0);
+
+        // only committed data becomes readable
+        buffer.prepare(50);
+        buffer.commit(20);
+        ASSERT_EQ(buffer.size(), data.size() - 10 + 20);
+
+        // When there is not enough left to consume, we consume the rest without complaining...
+        buffer.consume(buffer.size() * 2);
+        ASSERT_EQ(buffer.size(), 0);
+    }
+
+    /// Readable data wrapping around the end of the ring stays contiguous and is not moved
+    TEST(MirroredRingBufferTest, wrap_around)
+    {
+        MirroredRingBuffer buffer(4096);
+        const size_t capacity = buffer.capacity();
+        const uint8_t* start = buffer.data();
+
+        write(buffer, pattern(capacity - 100, 0));
+        buffer.consume(capacity - 200);
+
+        std::vector < uint8_t > data = pattern(capacity - 200, 7);
+        write(buffer, data);
+        ASSERT_EQ(buffer.capacity(), capacity);
+        ASSERT_EQ(buffer.size(), 100 + data.size());
+        ASSERT_EQ(buffer.data(), start + capacity - 200);
+
+        buffer.consume(100);
+        ASSERT_EQ(memcmp(buffer.data(), data.data(), data.size()), 0);
+    }
+
+    TEST(MirroredRingBufferTest, grow)
+    {
+        MirroredRingBuffer buffer(4096);
+        const size_t capacity = buffer.capacity();
+        std::vector < uint8_t > data = pattern(capacity - 10, 3);
+        write(buffer, data);
+        buffer.consume(5);
+
+        std::vector < uint8_t > moreData = pattern(capacity, 11);
+        write(buffer, moreData);
+        ASSERT_GT(buffer.capacity(), capacity);
+        ASSERT_EQ(buffer.size(), data.size() - 5 + moreData.size());
+        ASSERT_EQ(memcmp(buffer.data(), data.data() + 5, data.size() - 5), 0);
+        ASSERT_EQ(memcmp(buffer.data() + data.size() - 5, moreData.data(), moreData.size()), 0);
+    }
+}
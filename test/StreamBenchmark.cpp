@@ -0,0 +1,435 @@
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/beast/websocket.hpp>
+
+#include <gtest/gtest.h>
+
+#include "stream/Awaitable.hpp"
+#include "stream/Stream.hpp"
+#include "stream/TcpClientStream.hpp"
+#include "stream/TcpServer.hpp"
+#include "stream/WebsocketRead.hpp"
+#include "TestStream.hpp"
+
+
+namespace daq::stream {
+    static const size_t frameSize = 16;
+    /// Small enough for the unlimited recursion not to exhaust the stack
+    static const size_t framesPerBatch = 4096;
+    static const size_t batchCount = 200;
+
+    /// \return Frames per second delivered by asyncRead() when all frames are buffered already
+    static double measureFramesPerSecond(size_t maxInlineDepth)
+    {
+        std::vector < uint8_t > batch(frameSize * framesPerBatch, 0x55);
+        TestStream stream;
+        stream.setMaxInlineDepth(maxInlineDepth);
+
+        size_t framesReceived = 0;
+        uint64_t checksum = 0;
+        std::function < void(const boost::system::error_code&) > frameCb = [&](const boost::system::error_code&)
+        {
+            ++framesReceived;
+            checksum += stream.data()[0];
+            stream.consume(frameSize);
+            stream.asyncRead(frameCb, frameSize);
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t batchIndex = 0; batchIndex < batchCount; ++batchIndex) {
+            stream.append(boost::asio::buffer(batch));
+            stream.asyncRead(frameCb, frameSize);
+        }
+        std::chrono::duration < double > duration = std::chrono::steady_clock::now() - start;
+
+        EXPECT_EQ(framesReceived, framesPerBatch * batchCount);
+        EXPECT_EQ(checksum, 0x55 * framesPerBatch * batchCount);
+        EXPECT_EQ(stream.size(), 0);
+        return framesReceived / duration.count();
+    }
+
+    /// \return Frames per second delivered by asyncReadFrames() when all frames are buffered already
+    static double measureFramesPerSecondBatched()
+    {
+        std::vector < uint8_t > batch(frameSize * framesPerBatch, 0x55);
+        TestStream stream;
+
+        size_t framesReceived = 0;
+        uint64_t checksum = 0;
+        auto framesCb = [&](const boost::system::error_code&, const ConstBufferView& frames)
+        {
+            for (const auto& frame : frames) {
+                ++framesReceived;
+                checksum += static_cast < const uint8_t* >(frame.data())[0];
+            }
+        };
+        auto start = std::chrono::steady_clock::now();
+        for (size_t batchIndex = 0; batchIndex < batchCount; ++batchIndex) {
+            stream.append(boost::asio::buffer(batch));
+            stream.asyncReadFrames(Stream::fixedFrameLength(frameSize), framesCb);
+        }
+        std::chrono::duration < double > duration = std::chrono::steady_clock::now() - start;
+
+        EXPECT_EQ(framesReceived, framesPerBatch * batchCount);
+        EXPECT_EQ(checksum, 0x55 * framesPerBatch * batchCount);
+        EXPECT_EQ(stream.size(), 0);
+        return framesReceived / duration.count();
+    }
+
+    TEST(StreamBenchmark, asyncRead_16_byte_frames)
+    {
+        for (size_t maxInlineDepth : { 0, 1, 16, 64 }) {
+            double framesPerSecond = measureFramesPerSecond(maxInlineDepth);
+            // 0 is unlimited
+            RecordProperty("frames_per_second_max_inline_depth_" + std::to_string(maxInlineDepth), std::to_string(static_cast < uint64_t >(framesPerSecond)));
+        }
+    }
+
+    TEST(StreamBenchmark, asyncReadFrames_16_byte_frames)
+    {
+        double framesPerSecond = measureFramesPerSecondBatched();
+        RecordProperty("frames_per_second", std::to_string(static_cast < uint64_t >(framesPerSecond)));
+    }
+
+    /// Coroutine type that starts immediately and is not awaited by anyone
+    struct DetachedTask {
+        struct promise_type {
+            DetachedTask get_return_object()
+            {
+                return {};
+            }
+
+            std::suspend_never initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            std::suspend_never final_suspend() noexcept
+            {
+                return {};
+            }
+
+            void return_void()
+            {
+            }
+
+            void unhandled_exception()
+            {
+                std::terminate();
+            }
+        };
+    };
+
+    static const size_t messageSize = 64;
+    static const size_t roundTripCount = 20000;
+
+    /// TCP connection on a single io context, the server stream echoes each message
+    class EchoConnection {
+    public:
+        EchoConnection()
+            : m_server(m_ioc, [this](StreamSharedPtr newStream) { m_serverStream = newStream; }, 5013)
+            , m_client(m_ioc, "127.0.0.1", "5013")
+            , m_echo(messageSize)
+        {
+            m_server.start();
+            m_client.init();
+            while (!m_serverStream) {
+                m_ioc.run_one();
+            }
+            echo();
+        }
+
+        ~EchoConnection()
+        {
+            m_server.stop();
+        }
+
+        /// \return Average round trip time of executing the client until done is set
+        std::chrono::duration < double, std::micro > run(const bool& done)
+        {
+            auto start = std::chrono::steady_clock::now();
+            while (!done) {
+                m_ioc.run_one();
+            }
+            return (std::chrono::steady_clock::now() - start) / roundTripCount;
+        }
+
+        boost::asio::io_context& ioc()
+        {
+            return m_ioc;
+        }
+
+        Stream& client()
+        {
+            return m_client;
+        }
+
+    private:
+        void echo()
+        {
+            m_serverStream->asyncRead([this](const boost::system::error_code& ec)
+            {
+                if (ec) {
+                    return;
+                }
+                m_serverStream->copyDataAndConsume(m_echo.data(), messageSize);
+                m_serverStream->asyncWrite(boost::asio::buffer(m_echo), [this](const boost::system::error_code& ec, std::size_t)
+                {
+                    if (!ec) {
+                        echo();
+                    }
+                });
+            }, messageSize);
+        }
+
+        boost::asio::io_context m_ioc;
+        TcpServer m_server;
+        TcpClientStream m_client;
+        StreamSharedPtr m_serverStream;
+        std::vector < uint8_t > m_echo;
+    };
+
+    static DetachedTask awaiterClient(Stream& client, const std::vector < uint8_t >& request, bool& done)
+    {
+        for (size_t roundTrip = 0; roundTrip < roundTripCount; ++roundTrip) {
+            co_await awaitWrite(client, boost::asio::buffer(request));
+            co_await awaitRead(client, messageSize);
+            client.consume(messageSize);
+        }
+        done = true;
+    }
+
+    TEST(StreamBenchmark, tcp_round_trip_latency)
+    {
+        std::vector < uint8_t > request(messageSize, 0x55);
+
+        {
+            EchoConnection connection;
+            Stream& client = connection.client();
+            size_t roundTrips = 0;
+            bool done = false;
+            std::function < void() > roundTrip = [&]()
+            {
+                client.asyncWrite(boost::asio::buffer(request), [&](const boost::system::error_code&, std::size_t)
+                {
+                    client.asyncRead([&](const boost::system::error_code&)
+                    {
+                        client.consume(messageSize);
+                        if (++roundTrips == roundTripCount) {
+                            done = true;
+                        } else {
+                            roundTrip();
+                        }
+                    }, messageSize);
+                });
+            };
+            roundTrip();
+            RecordProperty("callbacks_us_per_round_trip", std::to_string(connection.run(done).count()));
+        }
+
+        {
+            EchoConnection connection;
+            bool done = false;
+            awaiterClient(connection.client(), request, done);
+            RecordProperty("awaiters_us_per_round_trip", std::to_string(connection.run(done).count()));
+        }
+
+        {
+            EchoConnection connection;
+            Stream& client = connection.client();
+            bool done = false;
+            auto roundTrips = [&]() -> boost::asio::awaitable < void >
+            {
+                for (size_t roundTrip = 0; roundTrip < roundTripCount; ++roundTrip) {
+                    co_await asyncWrite(client, boost::asio::buffer(request), boost::asio::use_awaitable);
+                    co_await asyncRead(client, messageSize, boost::asio::use_awaitable);
+                    client.consume(messageSize);
+                }
+                done = true;
+            };
+            boost::asio::co_spawn(connection.ioc(), roundTrips, boost::asio::detached);
+            RecordProperty("use_awaitable_us_per_round_trip", std::to_string(connection.run(done).count()));
+        }
+    }
+
+    /// Streambuf receive buffer remembering the memory prepared last
+    class PreparedRecordingReceiveBuffer : public StreambufReceiveBuffer {
+    public:
+        PreparedRecordingReceiveBuffer()
+            : StreambufReceiveBuffer(m_streambuf)
+        {
+        }
+
+        boost::asio::mutable_buffer prepare(size_t size) override
+        {
+            m_prepared = StreambufReceiveBuffer::prepare(size);
+            return m_prepared;
+        }
+
+        bool prepared(const void* data) const
+        {
+            const uint8_t* begin = static_cast < const uint8_t* >(m_prepared.data());
+            const uint8_t* address = static_cast < const uint8_t* >(data);
+            return address >= begin && address < begin + m_prepared.size();
+        }
+
+    private:
+        boost::asio::streambuf m_streambuf;
+        boost::asio::mutable_buffer m_prepared;
+    };
+
+    /// Socket counting the bytes it receives directly into the memory prepared by the receive buffer.
+    /// Everything else goes into the frame buffer of Beast first.
+    class CountingSocket {
+    public:
+        using executor_type = boost::asio::ip::tcp::socket::executor_type;
+
+        CountingSocket(boost::asio::ip::tcp::socket socket, const PreparedRecordingReceiveBuffer& receiveBuffer)
+            : m_socket(std::move(socket))
+            , m_receiveBuffer(receiveBuffer)
+            , directBytes(0)
+        {
+        }
+
+        executor_type get_executor()
+        {
+            return m_socket.get_executor();
+        }
+
+        boost::asio::ip::tcp::socket& socket()
+        {
+            return m_socket;
+        }
+
+        template < class MutableBufferSequence >
+        size_t read_some(const MutableBufferSequence& buffers)
+        {
+            boost::system::error_code ec;
+            size_t bytesRead = read_some(buffers, ec);
+            if (ec) {
+                throw boost::system::system_error(ec);
+            }
+            return bytesRead;
+        }
+
+        template < class MutableBufferSequence >
+        size_t read_some(const MutableBufferSequence& buffers, boost::system::error_code& ec)
+        {
+            size_t bytesRead = m_socket.read_some(buffers, ec);
+            boost::asio::mutable_buffer first = *boost::asio::buffer_sequence_begin(buffers);
+            if (m_receiveBuffer.prepared(first.data())) {
+                directBytes += bytesRead;
+            }
+            return bytesRead;
+        }
+
+        template < class ConstBufferSequence >
+        size_t write_some(const ConstBufferSequence& buffers)
+        {
+            return m_socket.write_some(buffers);
+        }
+
+        template < class ConstBufferSequence >
+        size_t write_some(const ConstBufferSequence& buffers, boost::system::error_code& ec)
+        {
+            return m_socket.write_some(buffers, ec);
+        }
+
+    private:
+        boost::asio::ip::tcp::socket m_socket;
+        const PreparedRecordingReceiveBuffer& m_receiveBuffer;
+
+    public:
+        size_t directBytes;
+    };
+
+    static void teardown(boost::beast::role_type role, CountingSocket& socket, boost::system::error_code& ec)
+    {
+        boost::beast::websocket::teardown(role, socket.socket(), ec);
+    }
+
+    static const size_t websocketMessageSize = 65536;
+    static const size_t websocketMessageCount = 256;
+
+    /// Receives masked messages as websocket server, like WebsocketServerStream does.
+    /// \param beastRead false: boost::asio::read as before, true: websocketReadAtLeast
+    /// \param fragment true: The client splits messages into frames of the Beast default size, false: one frame per message
+    /// \return Bytes copied from the frame buffer of Beast into the receive buffer per received payload byte
+    static double measureWebsocketBytesCopied(bool beastRead, bool fragment)
+    {
+        boost::asio::io_context ioc;
+        boost::asio::ip::tcp::acceptor acceptor(ioc, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 5014));
+
+        std::thread client([fragment]()
+        {
+            boost::asio::io_context clientIoc;
+            boost::beast::websocket::stream < boost::asio::ip::tcp::socket > websocket(clientIoc);
+            websocket.next_layer().connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 5014));
+            websocket.handshake("127.0.0.1", "/");
+            websocket.binary(true);
+            websocket.auto_fragment(fragment);
+            std::vector < uint8_t > message(websocketMessageSize, 0x55);
+            for (size_t messageIndex = 0; messageIndex < websocketMessageCount; ++messageIndex) {
+                websocket.write(boost::asio::buffer(message));
+            }
+        });
+
+        PreparedRecordingReceiveBuffer receiveBuffer;
+        ReadSizer readSizer;
+        ReceiveBufferRef dynamicBuffer(receiveBuffer, readSizer);
+        boost::beast::websocket::stream < CountingSocket > websocket(acceptor.accept(), receiveBuffer);
+        websocket.accept();
+        websocket.next_layer().directBytes = 0;
+
+        const size_t payloadBytes = websocketMessageSize * websocketMessageCount;
+        size_t bytesReceived = 0;
+        uint64_t checksum = 0;
+        boost::system::error_code ec;
+        while (bytesReceived < payloadBytes && !ec) {
+            if (beastRead) {
+                websocketReadAtLeast(websocket, dynamicBuffer, 1, readSizer.maxReadSize(), ec);
+            } else {
+                boost::asio::read(websocket, dynamicBuffer, ReadAtLeast(1, readSizer), ec);
+            }
+            bytesReceived += receiveBuffer.size();
+            checksum += receiveBuffer.data()[0];
+            receiveBuffer.consume(receiveBuffer.size());
+        }
+        client.join();
+
+        EXPECT_FALSE(ec);
+        EXPECT_EQ(bytesReceived, payloadBytes);
+        EXPECT_GE(checksum, 0x55);
+        return static_cast < double >(payloadBytes - websocket.next_layer().directBytes) / payloadBytes;
+    }
+
+    TEST(StreamBenchmark, websocket_receive_bytes_copied)
+    {
+        for (bool fragment : { true, false }) {
+            double before = measureWebsocketBytesCopied(false, fragment);
+            double after = measureWebsocketBytesCopied(true, fragment);
+            // bytes copied per received byte of 64KiB messages
+            std::string messages = fragment ? "fragmented" : "unfragmented";
+            RecordProperty(messages + "_asio_read_copied_per_byte", std::to_string(before));
+            RecordProperty(messages + "_websocketReadAtLeast_copied_per_byte", std::to_string(after));
+            EXPECT_LT(after, before);
+            if (!fragment) {
+                EXPECT_LT(after, 0.1);
+            }
+        }
+    }
+}
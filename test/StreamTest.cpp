@@ -1,8 +1,19 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio/error.hpp>
 #include <boost/asio/io_context.hpp>
 
 #include <gtest/gtest.h>
 
 #include "stream/Stream.hpp"
+#include "TestStream.hpp"
 
 
 namespace daq::stream {
@@ -10,78 +21,46 @@ namespace daq::stream {
     {
     }
 
-    class TestStream : public Stream
+    /// Transport writes complete when the test tells so
+    class PendingWriteStream : public TestStream
     {
     public:
-        TestStream()
+        PendingWriteStream()
         {
+            m_holdWrites = true;
         }
+    };
 
-        /// Start the asynchronous operation
-        /// @param CompletionCb Executed after completion to start receiving/sending data
-        void asyncInit(CompletionCb readCb) override
-        {
-        }
-
-        boost::system::error_code init() override
-        {
-            return boost::system::error_code();
-        }
-
-        std::string endPointUrl() const override
-        {
-            return "";
-        }
-        std::string remoteHost() const override
-        {
-            return "";
-        }
-
-        void asyncReadAtLeast(std::size_t bytesToRead, ReadCompletionCb readAtLeastCb) override
-        {
-        }
-
-        size_t readAtLeast(std::size_t bytesToRead, boost::system::error_code &ec) override
-        {
-            return 0;
-        }
-
-        void asyncWrite(const boost::asio::const_buffer& data, Stream::WriteCompletionCb writeCompletionCb) override
-        {
-            std::ostream os(&m_buffer);
-            os.write(reinterpret_cast< const char*>(data.data()), data.size());
-            writeCompletionCb(boost::system::error_code(), data.size());
-        }
-
-        void asyncWrite(const ConstBufferVector& data, WriteCompletionCb writeCompletionCb) override
-        {
-            size_t sizeSum = 0;
-            std::ostream os(&m_buffer);
-            for( const auto& iter : data) {
-                os.write(reinterpret_cast< const char*>(iter.data()), iter.size());
-                sizeSum += iter.size();
-            }
-            writeCompletionCb(boost::system::error_code(), sizeSum);
-        }
-
-        size_t write(const boost::asio::const_buffer& data, boost::system::error_code& ec) override
-        {
-            return 0;
-        }
-
-        size_t write(const ConstBufferVector& data, boost::system::error_code& ec) override
+    /// Reads complete at once with the requested amount of data
+    class GeneratorStream : public TestStream
+    {
+    public:
+        void asyncReadAtLeast(std::size_t bytesToRead, ReadCompletionCb readCb) override
         {
-            return 0;
+            ReceiveBufferRef buffer = receiveBuffer();
+            boost::asio::mutable_buffer prepared = buffer.prepare(bytesToRead);
+            memset(prepared.data(), 0, bytesToRead);
+            buffer.commit(bytesToRead);
+            m_reads.push_back(bytesToRead);
+            m_readLimits.push_back(maxReadSize());
+            readCb(boost::system::error_code(), bytesToRead);
         }
 
-        void asyncClose(CompletionCb closeCb) override
-        {
-            closeCb(boost::system::error_code());
-        }
+        std::vector < size_t > m_reads;
+        std::vector < size_t > m_readLimits;
+    };
 
-        boost::system::error_code close() override
+    /// Every transport read completes with a message of the same payload
+    class MessageStream : public TestStream
+    {
+    public:
+        void asyncReadMessageTransport(ReadCompletionCb readCb) override
         {
-            return boost::system::error_code();
+            static const std::string payload = "message";
+            ReceiveBufferRef buffer = receiveBuffer();
+            boost::asio::buffer_copy(buffer.prepare(payload.size()), boost::asio::buffer(payload));
+            buffer.commit(payload.size());
+            readCb(boost::system::error_code(), payload.size());
         }
     };
 
@@ -202,4 +181,728 @@ namespace daq::stream {
         testStream.asyncReadSome(readComplectionCb);
         ASSERT_EQ(bytesRead, bytesWritten);
     }
+
+    /// Frames already in the buffer are delivered without nesting callbacks deeper than the configured limit
+    TEST(SessioTest, asyncRead_bounded_inline_depth)
+    {
+        static const size_t frameSize = 16;
+        static const size_t frameCount = 1000;
+        std::vector < uint8_t > testData(frameSize * frameCount);
+        TestStream testStream;
+        testStream.setMaxInlineDepth(8);
+        testStream.asyncWrite(boost::asio::const_buffer(testData.data(), testData.size()), &writeCompletionCb);
+
+        size_t completionCounter = 0;
+        size_t depth = 0;
+        size_t maxDepth = 0;
+        std::function < void(const boost::system::error_code&) > completionCb = [&](const boost::system::error_code&)
+        {
+            ++completionCounter;
+            ++depth;
+            maxDepth = std::max(maxDepth, depth);
+            testStream.consume(frameSize);
+            testStream.asyncRead(completionCb, frameSize);
+            --depth;
+        };
+
+        testStream.asyncRead(completionCb, frameSize);
+        ASSERT_EQ(completionCounter, frameCount);
+        ASSERT_EQ(maxDepth, 8);
+        ASSERT_EQ(testStream.size(), 0);
+    }
+
+    /// The callback may release the last reference to the stream
+    TEST(SessioTest, asyncRead_destroy_in_callback)
+    {
+        static const std::string testData = "1234567890";
+        auto testStream = std::make_shared < TestStream >();
+        testStream->asyncWrite(boost::asio::const_buffer(testData.c_str(), testData.size()), &writeCompletionCb);
+
+        size_t completionCounter = 0;
+        testStream->asyncRead([&](const boost::system::error_code&)
+        {
+            ++completionCounter;
+            testStream.reset();
+        }, testData.size());
+        ASSERT_EQ(completionCounter, 1);
+        ASSERT_FALSE(testStream);
+
+        testStream = std::make_shared < TestStream >();
+        testStream->asyncWrite(boost::asio::const_buffer(testData.c_str(), testData.size()), &writeCompletionCb);
+        testStream->asyncReadSome([&](const boost::system::error_code&, size_t bytesRead)
+        {
+            completionCounter += bytesRead;
+            testStream.reset();
+        });
+        ASSERT_EQ(completionCounter, 1 + testData.size());
+        ASSERT_FALSE(testStream);
+    }
+
+    /// A read deferred at the maximum inline depth may release the last reference to the stream as well
+    TEST(SessioTest, asyncRead_destroy_in_deferred_callback)
+    {
+        static const std::string testData(64, 'x');
+        auto testStream = std::make_shared < TestStream >();
+        testStream->setMaxInlineDepth(1);
+        testStream->asyncWrite(boost::asio::const_buffer(testData.c_str(), testData.size()), &writeCompletionCb);
+
+        size_t completionCounter = 0;
+        std::function < void(const boost::system::error_code&) > readCb = [&](const boost::system::error_code&)
+        {
+            testStream->consume(16);
+            if (++completionCounter == 2) {
+                testStream.reset();
+                return;
+            }
+            testStream->asyncRead(readCb, 16);
+        };
+        testStream->asyncRead(readCb, 16);
+        ASSERT_EQ(completionCounter, 2);
+        ASSERT_FALSE(testStream);
+    }
+
+    /// all requested data is buffered already
+    TEST(SessioTest, asyncReadInto_buffered)
+    {
+        static const std::string testData = "1234567890";
+        TestStream testStream;
+        testStream.asyncWrite(boost::asio::const_buffer(testData.c_str(), testData.size()), &writeCompletionCb);
+
+        char first[3];
+        char second[5];
+        MutableBufferVector buffers = { boost::asio::buffer(first), boost::asio::buffer(second) };
+        size_t bytesRead = 0;
+        auto readCb = [&bytesRead](const boost::system::error_code&, size_t bytes)
+        {
+            bytesRead = bytes;
+        };
+        testStream.asyncReadInto(buffers, readCb);
+        ASSERT_EQ(bytesRead, 8);
+        ASSERT_EQ(std::string(first, 3) + std::string(second, 5), testData.substr(0, 8));
+        ASSERT_EQ(testStream.size(), 2);
+    }
+
+    TEST(SessioTest, asyncReadFrames_fixed_size)
+    {
+        static const std::string testData = "1234567890";
+        TestStream testStream;
+        testStream.asyncWrite(boost::asio::const_buffer(testData.c_str(), testData.size()), &writeCompletionCb);
+
+        std::vector < std::string > frames;
+        auto framesCb = [&frames](const boost::system::error_code& ec, const ConstBufferView& views)
+        {
+            ASSERT_EQ(ec, boost::system::error_code());
+            for (const auto& view : views) {
+                frames.push_back(std::string(static_cast < const char* >(view.data()), view.size()));
+            }
+        };
+        testStream.asyncReadFrames(Stream::fixedFrameLength(3), framesCb);
+        ASSERT_EQ(frames, std::vector < std::string >({ "123", "456", "789" }));
+        // incomplete frame stays in the buffer
+        ASSERT_EQ(testStream.size(), 1);
+    }
+
+    /// frames with a one byte length header. Requesting the next frames from the callback does not nest.
+    TEST(SessioTest, asyncReadFrames_header_length)
+    {
+        static const std::string testData = "\x03" "abc" "\x01" "d" "\x05" "ef";
+        TestStream testStream;
+        testStream.asyncWrite(boost::asio::const_buffer(testData.c_str(), testData.size()), &writeCompletionCb);
+
+        auto extractor = [](const uint8_t* data, std::size_t) -> size_t
+        {
+            return 1 + data[0];
+        };
+
+        std::vector < std::string > frames;
+        size_t callCount = 0;
+        bool inCallback = false;
+        std::function < void(const boost::system::error_code&, const ConstBufferView&) > framesCb = [&](const boost::system::error_code& ec, const ConstBufferView& views)
+        {
+            ASSERT_EQ(ec, boost::system::error_code());
+            ASSERT_FALSE(inCallback);
+            inCallback = true;
+            ++callCount;
+            for (const auto& view : views) {
+                frames.push_back(std::string(static_cast < const char* >(view.data()) + 1, view.size() - 1));
+            }
+            if (callCount == 1) {
+                // complete the last frame
+                static const std::string rest = "ghi";
+                testStream.asyncWrite(boost::asio::const_buffer(rest.c_str(), rest.size()), &writeCompletionCb);
+                testStream.asyncReadFrames(extractor, framesCb);
+            }
+            inCallback = false;
+        };
+        testStream.asyncReadFrames(extractor, framesCb);
+        ASSERT_EQ(callCount, 2);
+        ASSERT_EQ(frames, std::vector < std::string >({ "abc", "d", "efghi" }));
+        ASSERT_EQ(testStream.size(), 0);
+    }
+
+    /// The callback may release the last reference to the stream
+    TEST(SessioTest, asyncReadFrames_destroy_in_callback)
+    {
+        static const std::string testData = "1234567890";
+        auto testStream = std::make_shared < TestStream >();
+        testStream->asyncWrite(boost::asio::const_buffer(testData.c_str(), testData.size()), &writeCompletionCb);
+
+        size_t frameCount = 0;
+        testStream->asyncReadFrames(Stream::fixedFrameLength(3), [&](const boost::system::error_code&, const ConstBufferView& views)
+        {
+            frameCount += std::distance(views.begin(), views.end());
+            testStream.reset();
+        });
+        ASSERT_EQ(frameCount, 3);
+        ASSERT_FALSE(testStream);
+    }
+
+    /// The callback may release the last reference to the stream
+    TEST(SessioTest, asyncReadMessage_destroy_in_callback)
+    {
+        auto testStream = std::make_shared < MessageStream >();
+        size_t messageCount = 0;
+        testStream->asyncReadMessage([&](const boost::system::error_code& ec, const ConstBufferView& message, bool)
+        {
+            ASSERT_EQ(ec, boost::system::error_code());
+            ASSERT_EQ(boost::asio::buffer_size(message), 7);
+            ++messageCount;
+            testStream.reset();
+        });
+        ASSERT_EQ(messageCount, 1);
+        ASSERT_FALSE(testStream);
+    }
+
+    /// Writes requested while one is in progress are sent by a single gather write
+    TEST(WriteQueueTest, coalesce_pending_writes)
+    {
+        PendingWriteStream stream;
+        std::vector < std::string > messages = { "first", "second", "third", "fourth" };
+        std::vector < size_t > completed;
+        auto writeCb = [&](const boost::system::error_code& ec, std::size_t bytesWritten)
+        {
+            ASSERT_FALSE(ec);
+            completed.push_back(bytesWritten);
+        };
+        for (const auto& message : messages) {
+            stream.asyncWrite(boost::asio::buffer(message), writeCb);
+        }
+        ASSERT_EQ(stream.m_transportWrites.size(), 1);
+        ASSERT_EQ(stream.m_transportWrites[0].size(), 1);
+
+        stream.completeWrite();
+        ASSERT_EQ(completed, std::vector < size_t >({ 5 }));
+        ASSERT_EQ(stream.m_transportWrites.size(), 2);
+        ASSERT_EQ(stream.m_transportWrites[1].size(), 3);
+        ASSERT_EQ(boost::asio::buffer_size(stream.m_transportWrites[1]), 6 + 5 + 6);
+
+        stream.completeWrite();
+        ASSERT_EQ(completed, std::vector < size_t >({ 5, 6, 5, 6 }));
+        ASSERT_FALSE(stream.writing());
+    }
+
+    TEST(WriteQueueTest, coalesce_limits)
+    {
+        PendingWriteStream stream;
+        WriteQueueOptions options;
+        options.maxCoalescedBytes = 10;
+        options.maxCoalescedBuffers = 3;
+        stream.setWriteQueueOptions(options);
+
+        std::string data(20, 'x');
+        ConstBufferVector twoBuffers = { boost::asio::buffer(data.data(), 1), boost::asio::buffer(data.data(), 1) };
+        stream.asyncWrite(boost::asio::buffer(data.data(), 1), writeCompletionCb);
+        // bytes limit
+        stream.asyncWrite(boost::asio::buffer(data.data(), 4), writeCompletionCb);
+        stream.asyncWrite(boost::asio::buffer(data.data(), 4), writeCompletionCb);
+        stream.asyncWrite(boost::asio::buffer(data.data(), 4), writeCompletionCb);
+        // bigger than the limit, sent on its own
+        stream.asyncWrite(boost::asio::buffer(data.data(), 20), writeCompletionCb);
+        // buffer limit
+        stream.asyncWrite(twoBuffers, writeCompletionCb);
+        stream.asyncWrite(twoBuffers, writeCompletionCb);
+
+        while (stream.writing()) {
+            stream.completeWrite();
+        }
+        std::vector < size_t > sizes;
+        for (const auto& transportWrite : stream.m_transportWrites) {
+            sizes.push_back(boost::asio::buffer_size(transportWrite));
+        }
+        ASSERT_EQ(sizes, std::vector < size_t >({ 1, 8, 4, 20, 2, 2 }));
+    }
+
+    /// An empty sequence of buffers sends nothing, also when it reuses the slot of a write of a single buffer
+    TEST(WriteQueueTest, empty_sequence_after_single_buffer)
+    {
+        TestStream stream;
+        std::string data = "abc";
+        std::vector < size_t > completed;
+        auto writeCb = [&](const boost::system::error_code& ec, std::size_t bytesWritten)
+        {
+            ASSERT_FALSE(ec);
+            completed.push_back(bytesWritten);
+        };
+        // go around the ring of queued writes once
+        for (size_t index = 0; index < 8; ++index) {
+            stream.asyncWrite(boost::asio::buffer(data), writeCb);
+        }
+        stream.asyncWrite(ConstBufferVector(), writeCb);
+        stream.asyncWriteBuffers(ConstBufferView(), writeCb);
+
+        ASSERT_EQ(completed.size(), 10);
+        ASSERT_EQ(completed[8], 0);
+        ASSERT_EQ(completed[9], 0);
+        ASSERT_EQ(boost::asio::buffer_size(stream.m_transportWrites[8]), 0);
+        ASSERT_EQ(boost::asio::buffer_size(stream.m_transportWrites[9]), 0);
+        ASSERT_EQ(stream.size(), 8 * data.size());
+    }
+
+    /// A failing transport write fails all queued writes. The queue is usable afterwards.
+    TEST(WriteQueueTest, error_completes_all)
+    {
+        PendingWriteStream stream;
+        std::string data = "data";
+        std::vector < boost::system::error_code > results;
+        auto writeCb = [&](const boost::system::error_code& ec, std::size_t)
+        {
+            results.push_back(ec);
+        };
+        for (size_t index = 0; index < 3; ++index) {
+            stream.asyncWrite(boost::asio::buffer(data), writeCb);
+        }
+        stream.completeWrite(boost::asio::error::broken_pipe);
+        ASSERT_EQ(results.size(), 3);
+        for (const auto& ec : results) {
+            ASSERT_EQ(ec, boost::asio::error::broken_pipe);
+        }
+        ASSERT_FALSE(stream.writing());
+
+        stream.asyncWrite(boost::asio::buffer(data), writeCb);
+        ASSERT_TRUE(stream.writing());
+        stream.completeWrite();
+        ASSERT_EQ(results.size(), 4);
+        ASSERT_FALSE(results.back());
+    }
+
+    /// Writes requested by write completion callbacks are queued behind the ones already waiting
+    TEST(WriteQueueTest, write_from_callback)
+    {
+        PendingWriteStream stream;
+        std::string order;
+        stream.asyncWrite(boost::asio::buffer("a", 1), [&](const boost::system::error_code&, std::size_t)
+        {
+            order += 'a';
+            stream.asyncWrite(boost::asio::buffer("c", 1), [&](const boost::system::error_code&, std::size_t) { order += 'c'; });
+        });
+        stream.asyncWrite(boost::asio::buffer("b", 1), [&](const boost::system::error_code&, std::size_t) { order += 'b'; });
+        while (stream.writing()) {
+            stream.completeWrite();
+        }
+        ASSERT_EQ(order, "abc");
+        // b and c are combined
+        ASSERT_EQ(stream.m_transportWrites.size(), 2);
+    }
+
+    TEST(WriteQueueTest, watermarks)
+    {
+        PendingWriteStream stream;
+        std::vector < std::string > notifications;
+        stream.setWriteWatermarks(100, 40,
+            [&](std::size_t queuedBytes) { notifications.push_back("high " + std::to_string(queuedBytes)); },
+            [&](std::size_t queuedBytes) { notifications.push_back("low " + std::to_string(queuedBytes)); });
+
+        std::string data(60, 'x');
+        stream.asyncWrite(boost::asio::buffer(data), writeCompletionCb);
+        ASSERT_EQ(stream.queuedBytes(), 60);
+        ASSERT_TRUE(notifications.empty());
+        stream.asyncWrite(boost::asio::buffer(data), writeCompletionCb);
+        stream.asyncWrite(boost::asio::buffer(data), writeCompletionCb);
+        ASSERT_EQ(stream.queuedBytes(), 180);
+        ASSERT_TRUE(stream.aboveHighWatermark());
+        ASSERT_EQ(notifications, std::vector < std::string >({ "high 120" }));
+
+        // 120 left, still above the low watermark
+        stream.completeWrite();
+        ASSERT_EQ(stream.queuedBytes(), 120);
+        ASSERT_EQ(notifications.size(), 1);
+
+        stream.completeWrite();
+        ASSERT_EQ(stream.queuedBytes(), 0);
+        ASSERT_FALSE(stream.aboveHighWatermark());
+        ASSERT_EQ(notifications, std::vector < std::string >({ "high 120", "low 0" }));
+
+        // armed again
+        stream.asyncWrite(boost::asio::buffer(data), writeCompletionCb);
+        stream.asyncWrite(boost::asio::buffer(data), writeCompletionCb);
+        ASSERT_EQ(notifications.size(), 3);
+        ASSERT_EQ(notifications.back(), "high 120");
+    }
+
+    /// Records the outcome of writes by their name
+    class WriteResults {
+    public:
+        Stream::WriteCompletionCb callback(const std::string& name)
+        {
+            return [this, name](const boost::system::error_code& ec, std::size_t)
+            {
+                (ec ? dropped : written) += name;
+            };
+        }
+
+        std::string written;
+        std::string dropped;
+    };
+
+    TEST(WriteQueueTest, drop_oldest)
+    {
+        PendingWriteStream stream;
+        WriteQueueOptions options;
+        options.overflowPolicy = WriteOverflowPolicy::DropOldest;
+        options.maxQueuedBytes = 30;
+        stream.setWriteQueueOptions(options);
+
+        std::string data(10, 'x');
+        WriteResults results;
+        for (const char* name : { "a", "b", "c", "d", "e" }) {
+            stream.asyncWrite(boost::asio::buffer(data), results.callback(name));
+        }
+        // a is being sent, b and c were dropped to make room
+        ASSERT_EQ(results.dropped, "bc");
+        ASSERT_EQ(stream.queuedBytes(), 30);
+        ASSERT_EQ(stream.droppedWrites(), 2);
+        ASSERT_EQ(stream.droppedBytes(), 20);
+
+        while (stream.writing()) {
+            stream.completeWrite();
+        }
+        ASSERT_EQ(results.written, "ade");
+    }
+
+    /// Callbacks of dropped writes may write again or release the stream
+    TEST(WriteQueueTest, drop_oldest_reentrant)
+    {
+        auto stream = std::make_shared < PendingWriteStream >();
+        WriteQueueOptions options;
+        options.overflowPolicy = WriteOverflowPolicy::DropOldest;
+        options.maxQueuedBytes = 30;
+        stream->setWriteQueueOptions(options);
+
+        std::string data(10, 'x');
+        WriteResults results;
+        stream->asyncWrite(boost::asio::buffer(data), results.callback("a"));
+        stream->asyncWrite(boost::asio::buffer(data), [&](const boost::system::error_code& ec, std::size_t)
+        {
+            ASSERT_EQ(ec, boost::asio::error::no_buffer_space);
+            results.dropped += "b";
+            // queued behind c, drops it in turn
+            stream->asyncWrite(boost::asio::buffer(data), results.callback("e"));
+        });
+        stream->asyncWrite(boost::asio::buffer(data), results.callback("c"));
+        stream->asyncWrite(boost::asio::buffer(data), results.callback("d"));
+        ASSERT_EQ(results.dropped, "bc");
+        ASSERT_EQ(stream->queuedBytes(), 30);
+
+        while (stream->writing()) {
+            stream->completeWrite();
+        }
+        ASSERT_EQ(results.written, "ade");
+
+        stream->asyncWrite(boost::asio::buffer(data), results.callback("f"));
+        stream->asyncWrite(boost::asio::buffer(data), [&](const boost::system::error_code&, std::size_t)
+        {
+            stream.reset();
+        });
+        stream->asyncWrite(boost::asio::buffer(data), results.callback("g"));
+        stream->asyncWrite(boost::asio::buffer(data), results.callback("h"));
+        ASSERT_FALSE(stream);
+    }
+
+    TEST(WriteQueueTest, drop_newest)
+    {
+        PendingWriteStream stream;
+        WriteQueueOptions options;
+        options.overflowPolicy = WriteOverflowPolicy::DropNewest;
+        options.maxQueuedBytes = 30;
+        stream.setWriteQueueOptions(options);
+
+        std::string data(10, 'x');
+        WriteResults results;
+        for (const char* name : { "a", "b", "c", "d", "e" }) {
+            stream.asyncWrite(boost::asio::buffer(data), results.callback(name));
+        }
+        ASSERT_EQ(results.dropped, "de");
+        ASSERT_EQ(stream.droppedWrites(), 2);
+        ASSERT_EQ(stream.droppedBytes(), 20);
+
+        while (stream.writing()) {
+            stream.completeWrite();
+        }
+        ASSERT_EQ(results.written, "abc");
+    }
+
+    TEST(WriteQueueTest, keep_latest_per_key)
+    {
+        PendingWriteStream stream;
+        WriteQueueOptions options;
+        options.overflowPolicy = WriteOverflowPolicy::KeepLatestPerKey;
+        stream.setWriteQueueOptions(options);
+
+        std::string data(10, 'x');
+        WriteResults results;
+        stream.asyncWriteKeyed(1, boost::asio::buffer(data), results.callback("a"));
+        stream.asyncWriteKeyed(1, boost::asio::buffer(data), results.callback("b"));
+        stream.asyncWriteKeyed(2, boost::asio::buffer(data), results.callback("c"));
+        stream.asyncWrite(boost::asio::buffer(data), results.callback("d"));
+        stream.asyncWriteKeyed(1, boost::asio::buffer(data), results.callback("e"));
+        stream.asyncWriteKeyed(2, boost::asio::buffer(data), results.callback("f"));
+        // a is being sent and stays
+        ASSERT_EQ(results.dropped, "bc");
+        ASSERT_EQ(stream.droppedWrites(), 2);
+
+        while (stream.writing()) {
+            stream.completeWrite();
+        }
+        ASSERT_EQ(results.written, "adef");
+    }
+
+    /// Writes of a higher priority are sent before the queued ones of lower priorities
+    TEST(WriteQueueTest, priority_lanes)
+    {
+        PendingWriteStream stream;
+        WriteQueueOptions options;
+        options.priorityLanes = 2;
+        stream.setWriteQueueOptions(options);
+
+        WriteResults results;
+        stream.asyncWrite(boost::asio::buffer("a", 1), results.callback("a"));
+        stream.asyncWrite(boost::asio::buffer("b", 1), results.callback("b"));
+        stream.asyncWritePriority(1, boost::asio::buffer("c", 1), results.callback("c"));
+        // clamped to the highest lane
+        stream.asyncWritePriority(5, boost::asio::buffer("d", 1), results.callback("d"));
+        while (stream.writing()) {
+            stream.completeWrite();
+        }
+        ASSERT_EQ(results.written, "acdb");
+        // a, then c and d coalesced, then b
+        ASSERT_EQ(stream.m_transportWrites.size(), 3);
+    }
+
+    /// Messages are sent on their own, neither combined with other writes nor chunked
+    TEST(WriteQueueTest, messages)
+    {
+        PendingWriteStream stream;
+        WriteQueueOptions options;
+        options.maxChunkSize = 2;
+        stream.setWriteQueueOptions(options);
+
+        std::string data = "abc";
+        stream.asyncWrite(boost::asio::buffer(data.data(), 1), writeCompletionCb);
+        stream.asyncWrite(boost::asio::buffer(data.data(), 1), writeCompletionCb);
+        stream.asyncWriteMessage(boost::asio::buffer(data), false, writeCompletionCb);
+        stream.asyncWriteMessage(boost::asio::buffer(data), true, writeCompletionCb);
+        stream.asyncWrite(boost::asio::buffer(data.data(), 1), writeCompletionCb);
+        std::vector < size_t > sizes;
+        while (stream.writing()) {
+            stream.completeWrite();
+        }
+        for (const auto& transportWrite : stream.m_transportWrites) {
+            sizes.push_back(boost::asio::buffer_size(transportWrite));
+        }
+        ASSERT_EQ(sizes, std::vector < size_t >({ 1, 1, 3, 3, 1 }));
+    }
+
+    /// Big writes are sent in chunks. Writes of higher priority wait until all chunks are sent.
+    TEST(WriteQueueTest, chunks)
+    {
+        PendingWriteStream stream;
+        WriteQueueOptions options;
+        options.priorityLanes = 2;
+        options.maxChunkSize = 4;
+        stream.setWriteQueueOptions(options);
+
+        std::string bulk = "0123456789";
+        stream.asyncWrite(boost::asio::buffer(bulk), writeCompletionCb);
+        stream.completeWrite();
+        stream.asyncWritePriority(1, boost::asio::buffer("c", 1), writeCompletionCb);
+        while (stream.writing()) {
+            stream.completeWrite();
+        }
+
+        std::vector < std::string > sent;
+        for (const auto& transportWrite : stream.m_transportWrites) {
+            std::string data(boost::asio::buffer_size(transportWrite), '\0');
+            boost::asio::buffer_copy(boost::asio::buffer(data), transportWrite);
+            sent.push_back(data);
+        }
+        ASSERT_EQ(sent, std::vector < std::string >({ "0123", "4567", "89", "c" }));
+    }
+
+    /// With interleaving enabled, writes of higher priority are sent between the chunks of a big write
+    TEST(WriteQueueTest, interleaved_chunks)
+    {
+        PendingWriteStream stream;
+        WriteQueueOptions options;
+        options.priorityLanes = 2;
+        options.maxChunkSize = 4;
+        options.interleaveChunks = true;
+        stream.setWriteQueueOptions(options);
+
+        std::string first = "0123";
+        std::string second = "456789";
+        ConstBufferVector bulk = { boost::asio::buffer(first), boost::asio::buffer(second) };
+        std::vector < size_t > bulkCompleted;
+        stream.asyncWrite(bulk, [&](const boost::system::error_code& ec, std::size_t bytesWritten)
+        {
+            ASSERT_FALSE(ec);
+            bulkCompleted.push_back(bytesWritten);
+        });
+        ASSERT_EQ(stream.queuedBytes(), 10);
+        stream.asyncWritePriority(1, boost::asio::buffer("c", 1), writeCompletionCb);
+        while (stream.writing()) {
+            stream.completeWrite();
+        }
+
+        std::vector < std::string > sent;
+        for (const auto& transportWrite : stream.m_transportWrites) {
+            std::string data(boost::asio::buffer_size(transportWrite), '\0');
+            boost::asio::buffer_copy(boost::asio::buffer(data), transportWrite);
+            sent.push_back(data);
+        }
+        ASSERT_EQ(sent, std::vector < std::string >({ "0123", "c", "4567", "89" }));
+        // completed once with the size of all its data
+        ASSERT_EQ(bulkCompleted, std::vector < size_t >({ 10 }));
+        ASSERT_EQ(stream.queuedBytes(), 0);
+    }
+
+    /// A read larger than the budget is split into transport reads fitting the budget
+    TEST(RateLimitTest, read)
+    {
+        boost::asio::io_context ioContext;
+        GeneratorStream stream;
+        stream.setReadRateLimit(ioContext, 10000, 1000);
+
+        bool firstRead = false;
+        bool secondRead = false;
+        auto start = std::chrono::steady_clock::now();
+        stream.asyncRead([&](const boost::system::error_code& ec)
+        {
+            ASSERT_FALSE(ec);
+            firstRead = true;
+        }, 2000);
+        ASSERT_FALSE(firstRead);
+        ASSERT_EQ(stream.m_reads, std::vector < size_t >({ 1000 }));
+        ioContext.run();
+        ASSERT_TRUE(firstRead);
+        // the second 1000 bytes of budget take 100ms at 10000 bytes per second
+        ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+        ASSERT_EQ(stream.m_reads, std::vector < size_t >({ 1000, 1000 }));
+        // a single read is limited by the budget as well
+        ASSERT_EQ(stream.m_readLimits, std::vector < size_t >({ 1000, 1000 }));
+
+        // waits for budget worth a read of minReadSize instead of reading single bytes
+        stream.consume(2000);
+        stream.asyncReadSome([&](const boost::system::error_code& ec, std::size_t bytesRead)
+        {
+            ASSERT_FALSE(ec);
+            secondRead = true;
+        });
+        ASSERT_FALSE(secondRead);
+        ioContext.restart();
+        ioContext.run();
+        ASSERT_TRUE(secondRead);
+        ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(150));
+        ASSERT_EQ(stream.m_reads, std::vector < size_t >({ 1000, 1000, 1 }));
+    }
+
+    TEST(RateLimitTest, write)
+    {
+        boost::asio::io_context ioContext;
+        TestStream stream;
+        stream.setWriteRateLimit(ioContext, 10000, 1000);
+
+        std::string data(2000, 'x');
+        std::vector < size_t > written;
+        auto writeCb = [&](const boost::system::error_code& ec, std::size_t bytesWritten)
+        {
+            ASSERT_FALSE(ec);
+            written.push_back(bytesWritten);
+        };
+        auto start = std::chrono::steady_clock::now();
+        stream.asyncWrite(boost::asio::buffer(data), writeCb);
+        stream.asyncWrite(boost::asio::buffer(data.data(), 1000), writeCb);
+        ASSERT_EQ(written, std::vector < size_t >({ 2000 }));
+        ioContext.run();
+        ASSERT_EQ(written, std::vector < size_t >({ 2000, 1000 }));
+        ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+
+        // still in debt, removing the limit lets the waiting write go immediately
+        stream.asyncWrite(boost::asio::buffer(data), writeCb);
+        ASSERT_EQ(written.size(), 2);
+        stream.setWriteRateLimit(ioContext, 0);
+        ioContext.restart();
+        ioContext.poll();
+        ASSERT_EQ(written.size(), 3);
+    }
+
+    TEST(ReadSizerTest, fixed_policy)
+    {
+        ReadSizer readSizer;
+        // legacy behaviour: at least 512 byte, all free memory up to 64KiB
+        ASSERT_EQ(readSizer.nextReadSize(0), 512);
+        ASSERT_EQ(readSizer.nextReadSize(4000), 4000);
+        ASSERT_EQ(readSizer.nextReadSize(1000000), 65536);
+        ASSERT_EQ(readSizer.maxReadSize(), 65536);
+
+        // e.g. the budget of a rate limit
+        readSizer.setLimit(1000);
+        ASSERT_EQ(readSizer.nextReadSize(4000), 1000);
+        ASSERT_EQ(readSizer.maxReadSize(), 1000);
+        readSizer.setLimit(std::numeric_limits < size_t >::max());
+
+        ReadSizePolicy policy;
+        policy.minReadSize = 4096;
+        policy.maxReadSize = 1024 * 1024;
+        readSizer.setPolicy(policy);
+        ASSERT_EQ(readSizer.nextReadSize(0), 4096);
+        ASSERT_EQ(readSizer.maxReadSize(), 1024 * 1024);
+
+        // reads do not change anything
+        readSizer.onPrepare(4096);
+        readSizer.onCommit(4096);
+        ASSERT_EQ(readSizer.nextReadSize(0), 4096);
+    }
+
+    TEST(ReadSizerTest, adaptive_policy)
+    {
+        ReadSizePolicy policy;
+        policy.minReadSize = 1024;
+        policy.maxReadSize = 8192;
+        policy.adaptive = true;
+
+        ReadSizer readSizer;
+        readSizer.setPolicy(policy);
+        ASSERT_EQ(readSizer.nextReadSize(1000000), 1024);
+
+        // reads filling the prepared memory let the size grow up to the maximum
+        for (size_t expected : { 2048, 4096, 8192, 8192 }) {
+            size_t readSize = readSizer.nextReadSize(0);
+            readSizer.onPrepare(readSize);
+            readSizer.onCommit(readSize);
+            ASSERT_EQ(readSizer.nextReadSize(0), expected);
+            ASSERT_EQ(readSizer.maxReadSize(), expected);
+        }
+
+        // a read returning at least a quarter keeps the size
+        readSizer.onPrepare(8192);
+        readSizer.onCommit(2048);
+        ASSERT_EQ(readSizer.nextReadSize(0), 8192);
+
+        // idle traffic lets the size shrink down to the minimum
+        for (size_t expected : { 4096, 2048, 1024, 1024 }) {
+            readSizer.onPrepare(readSizer.nextReadSize(0));
+            readSizer.onCommit(10);
+            ASSERT_EQ(readSizer.nextReadSize(0), expected);
+        }
+    }
 }
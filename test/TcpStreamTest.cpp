@@ -1,7 +1,11 @@
+#include <array>
+#include <cstring>
 #include <functional>
 #include <future>
 #include <thread>
+#include <vector>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
 
 #include <gtest/gtest.h>
 
@@ -214,6 +218,80 @@ namespace daq::stream {
     }
 
 
+    /// Stopping the server closes the streams it created, clients see the connection end
+    /// Accepted streams use the receive buffer type of the server
+    TEST(TcpServer, test_receive_buffer_type)
+    {
+        static const uint16_t ListeningPort = 5003;
+        static const std::string message = "pooled";
+
+        boost::asio::io_context ioContext;
+        bool detachedInPlace = false;
+        auto newStreamCb = [&](StreamSharedPtr newStream)
+        {
+            newStream->asyncRead([&, newStream](const boost::system::error_code& ec)
+            {
+                ASSERT_FALSE(ec);
+                const uint8_t* data = newStream->data();
+                BufferSlice slice = newStream->detach(message.size());
+                // only pooled memory is handed over without copying
+                detachedInPlace = slice.data() == data;
+                ioContext.stop();
+            }, message.size());
+        };
+        TcpServer server(ioContext, newStreamCb, ListeningPort);
+        server.setReceiveBufferType(ReceiveBufferType::Pooled);
+        ASSERT_EQ(server.receiveBufferType(), ReceiveBufferType::Pooled);
+        ASSERT_EQ(server.start(), 0);
+
+        TcpClientStream client(ioContext, "localhost", std::to_string(ListeningPort));
+        client.asyncInit([&](const boost::system::error_code& ec)
+        {
+            ASSERT_FALSE(ec);
+            client.asyncWrite(boost::asio::buffer(message), [](const boost::system::error_code& ec, std::size_t)
+            {
+                ASSERT_FALSE(ec);
+            });
+        });
+        ioContext.run_for(std::chrono::seconds(2));
+        ASSERT_TRUE(detachedInPlace);
+        server.stop();
+    }
+
+    TEST(TcpServer, test_close_streams_on_stop)
+    {
+        static const uint16_t ListeningPort = 5003;
+
+        boost::asio::io_context ioContext;
+        auto newStreamCb = [&](StreamSharedPtr newStream)
+        {
+            // the pending read keeps the stream alive, the server tracks it without owning it
+            newStream->asyncReadSome([newStream](const boost::system::error_code&, std::size_t) {});
+        };
+        TcpServer server(ioContext, newStreamCb, ListeningPort);
+        server.setCloseStreamsOnStop(true);
+        ASSERT_EQ(server.start(), 0);
+
+        TcpClientStream client(ioContext, "localhost", std::to_string(ListeningPort));
+        boost::system::error_code readError;
+        client.asyncInit([&](const boost::system::error_code& ec)
+        {
+            ASSERT_FALSE(ec);
+            client.asyncReadSome([&](const boost::system::error_code& ec, std::size_t)
+            {
+                readError = ec;
+                ioContext.stop();
+            });
+        });
+        while (server.streams().empty()) {
+            ioContext.run_one();
+        }
+        server.stop();
+        ASSERT_TRUE(server.streams().empty());
+        ioContext.run_for(std::chrono::seconds(2));
+        ASSERT_EQ(readError, boost::asio::error::eof);
+    }
+
 #ifndef _WIN32
     TEST_F(TcpStreamTest, test_forbidden_port)
     {
@@ -553,6 +631,322 @@ namespace daq::stream {
         ASSERT_EQ(ec, boost::system::error_code());
     }
 
+    TEST_F(TcpStreamTest, test_write_read_mirrored_ring)
+    {
+        boost::system::error_code ec;
+        std::size_t bytesWritten;
+        TcpClientStream clientStream(m_ioContext, "localhost", std::to_string(ListeningPort), ReceiveBufferType::MirroredRing);
+        ec = clientStream.init();
+        ASSERT_EQ(ec, boost::system::error_code());
+
+        // data is echoed in several parts
+        std::string sendMessage(200000, 'x');
+        for (size_t index = 0; index < sendMessage.size(); ++index) {
+            sendMessage[index] = static_cast < char > (index % 251);
+        }
+        bytesWritten = clientStream.write(boost::asio::buffer(sendMessage), ec);
+        ASSERT_EQ(ec, boost::system::error_code());
+        ASSERT_EQ(bytesWritten, sendMessage.size());
+
+        std::string result;
+        while (result.size() < sendMessage.size()) {
+            size_t chunkSize = std::min < size_t > (30000, sendMessage.size() - result.size());
+            ec = clientStream.read(chunkSize);
+            ASSERT_EQ(ec, boost::system::error_code());
+            result += std::string(reinterpret_cast < const char* >(clientStream.data()), chunkSize);
+            clientStream.consume(chunkSize);
+        }
+        ASSERT_EQ(sendMessage, result);
+
+        ec = clientStream.close();
+        ASSERT_EQ(ec, boost::system::error_code());
+    }
+
+    TEST_F(TcpStreamTest, test_wait_readable_read_into)
+    {
+        boost::system::error_code ec;
+        TcpClientStream clientStream(m_ioContext, "localhost", std::to_string(ListeningPort));
+        ec = clientStream.init();
+        ASSERT_EQ(ec, boost::system::error_code());
+
+        std::string sendMessage = "hello";
+        clientStream.write(boost::asio::buffer(sendMessage), ec);
+        ASSERT_EQ(ec, boost::system::error_code());
+
+        std::promise < std::string > receivedPromise;
+        std::future < std::string > receivedFuture = receivedPromise.get_future();
+        char buffer[64];
+        auto waitCb = [&](const boost::system::error_code& waitEc)
+        {
+            ASSERT_EQ(waitEc, boost::system::error_code());
+            // nothing got buffered, read goes directly into our memory
+            ASSERT_EQ(clientStream.size(), 0);
+            boost::system::error_code readEc;
+            size_t bytesRead = clientStream.readInto(boost::asio::buffer(buffer), readEc);
+            ASSERT_EQ(readEc, boost::system::error_code());
+            receivedPromise.set_value(std::string(buffer, bytesRead));
+        };
+        clientStream.asyncWaitReadable(waitCb);
+        ASSERT_EQ(receivedFuture.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+        ASSERT_EQ(receivedFuture.get(), sendMessage);
+
+        ec = clientStream.close();
+        ASSERT_EQ(ec, boost::system::error_code());
+    }
+
+    /// fixed size records are read into a scatter list, data already buffered is copied first
+    TEST_F(TcpStreamTest, test_async_read_into_records)
+    {
+        static const size_t recordSize = 32;
+        static const size_t recordCount = 1024;
+        boost::system::error_code ec;
+        TcpClientStream clientStream(m_ioContext, "localhost", std::to_string(ListeningPort));
+        ec = clientStream.init();
+        ASSERT_EQ(ec, boost::system::error_code());
+
+        std::string sendMessage(recordSize * recordCount + 3, 'x');
+        for (size_t index = 0; index < sendMessage.size(); ++index) {
+            sendMessage[index] = static_cast < char > (index % 251);
+        }
+        clientStream.write(boost::asio::buffer(sendMessage), ec);
+        ASSERT_EQ(ec, boost::system::error_code());
+        ec = clientStream.read(3);
+        ASSERT_EQ(ec, boost::system::error_code());
+        clientStream.consume(3);
+
+        std::vector < std::array < char, recordSize > > records(recordCount);
+        MutableBufferVector buffers;
+        for (auto& record : records) {
+            buffers.push_back(boost::asio::buffer(record));
+        }
+
+        std::promise < boost::system::error_code > readPromise;
+        std::future < boost::system::error_code > readFuture = readPromise.get_future();
+        auto readCb = [&](const boost::system::error_code& readEc, std::size_t bytesRead)
+        {
+            EXPECT_EQ(bytesRead, recordSize * recordCount);
+            readPromise.set_value(readEc);
+        };
+        clientStream.asyncReadInto(buffers, readCb);
+        ASSERT_EQ(readFuture.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+        ASSERT_EQ(readFuture.get(), boost::system::error_code());
+
+        for (size_t index = 0; index < recordCount; ++index) {
+            ASSERT_EQ(memcmp(records[index].data(), sendMessage.data() + 3 + index * recordSize, recordSize), 0);
+        }
+
+        ec = clientStream.close();
+        ASSERT_EQ(ec, boost::system::error_code());
+    }
+
+    /// frames are delivered in batches until all of them are received
+    /// Many writes pending at the same time are sent in order
+    TEST_F(TcpStreamTest, test_queued_async_writes)
+    {
+        static const size_t writeCount = 1000;
+        boost::system::error_code ec;
+        TcpClientStream clientStream(m_ioContext, "localhost", std::to_string(ListeningPort));
+        ec = clientStream.init();
+        ASSERT_EQ(ec, boost::system::error_code());
+
+        std::vector < uint32_t > sequenceNumbers(writeCount);
+        for (size_t index = 0; index < writeCount; ++index) {
+            sequenceNumbers[index] = static_cast < uint32_t >(index);
+        }
+
+        std::promise < void > writtenPromise;
+        std::future < void > writtenFuture = writtenPromise.get_future();
+        size_t completed = 0;
+        auto writeAll = [&]()
+        {
+            for (auto& sequenceNumber : sequenceNumbers) {
+                clientStream.asyncWrite(boost::asio::buffer(&sequenceNumber, sizeof(sequenceNumber)), [&](const boost::system::error_code& writeEc, std::size_t bytesWritten)
+                {
+                    EXPECT_EQ(writeEc, boost::system::error_code());
+                    EXPECT_EQ(bytesWritten, sizeof(uint32_t));
+                    if (++completed == writeCount) {
+                        writtenPromise.set_value();
+                    }
+                });
+            }
+        };
+        boost::asio::post(m_ioContext, writeAll);
+        ASSERT_EQ(writtenFuture.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+
+        ec = clientStream.read(writeCount * sizeof(uint32_t));
+        ASSERT_EQ(ec, boost::system::error_code());
+        ASSERT_EQ(memcmp(clientStream.data(), sequenceNumbers.data(), writeCount * sizeof(uint32_t)), 0);
+
+        ec = clientStream.close();
+        ASSERT_EQ(ec, boost::system::error_code());
+    }
+
+    /// A client not reading makes the writes of the server stream pile up
+    TEST_F(TcpStreamTest, test_server_write_watermarks)
+    {
+        static const size_t chunkSize = 1024 * 1024;
+        static const size_t chunkCount = 16;
+        boost::system::error_code ec;
+        TcpClientStream clientStream(m_ioContext, "localhost", std::to_string(ListeningPort));
+        ec = clientStream.init();
+        ASSERT_EQ(ec, boost::system::error_code());
+        // after the echo, the server stream exists
+        clientStream.write(boost::asio::buffer(GoodByeMsg.data(), 1), ec);
+        ASSERT_EQ(clientStream.read(1), boost::system::error_code());
+        clientStream.consume(1);
+
+        std::vector < uint8_t > chunk(chunkSize, 0x5a);
+        std::promise < size_t > highPromise;
+        std::future < size_t > highFuture = highPromise.get_future();
+        std::promise < size_t > lowPromise;
+        std::future < size_t > lowFuture = lowPromise.get_future();
+        auto writeAll = [&]()
+        {
+            m_ServerStream->setWriteWatermarks(chunkSize, chunkSize / 2,
+                [&](std::size_t queuedBytes) { highPromise.set_value(queuedBytes); },
+                [&](std::size_t queuedBytes) { lowPromise.set_value(queuedBytes); });
+            for (size_t index = 0; index < chunkCount; ++index) {
+                m_ServerStream->asyncWrite(boost::asio::buffer(chunk), [](const boost::system::error_code&, std::size_t) {});
+            }
+        };
+        boost::asio::post(m_ioContext, writeAll);
+        ASSERT_EQ(highFuture.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+        // the echo of the byte above might still be queued
+        ASSERT_GE(highFuture.get(), chunkSize);
+        ASSERT_EQ(lowFuture.wait_for(std::chrono::milliseconds(100)), std::future_status::timeout);
+
+        size_t received = 0;
+        while (received < chunkSize * chunkCount) {
+            size_t bytesRead = clientStream.readSome(ec);
+            ASSERT_EQ(ec, boost::system::error_code());
+            clientStream.consume(bytesRead);
+            received += bytesRead;
+        }
+        ASSERT_EQ(lowFuture.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+        ASSERT_LE(lowFuture.get(), chunkSize / 2);
+
+        ec = clientStream.close();
+        ASSERT_EQ(ec, boost::system::error_code());
+    }
+
+    TEST_F(TcpStreamTest, test_async_read_frames)
+    {
+        static const size_t frameSize = 16;
+        static const size_t frameCount = 10000;
+        boost::system::error_code ec;
+        TcpClientStream clientStream(m_ioContext, "localhost", std::to_string(ListeningPort));
+        ec = clientStream.init();
+        ASSERT_EQ(ec, boost::system::error_code());
+
+        std::string sendMessage(frameSize * frameCount, 'x');
+        for (size_t index = 0; index < sendMessage.size(); ++index) {
+            sendMessage[index] = static_cast < char > (index % 251);
+        }
+        clientStream.write(boost::asio::buffer(sendMessage), ec);
+        ASSERT_EQ(ec, boost::system::error_code());
+
+        std::promise < boost::system::error_code > readPromise;
+        std::future < boost::system::error_code > readFuture = readPromise.get_future();
+        std::string result;
+        std::function < void(const boost::system::error_code&, const ConstBufferView&) > framesCb = [&](const boost::system::error_code& readEc, const ConstBufferView& frames)
+        {
+            if (readEc) {
+                readPromise.set_value(readEc);
+                return;
+            }
+            for (const auto& frame : frames) {
+                EXPECT_EQ(frame.size(), frameSize);
+                result.append(static_cast < const char* >(frame.data()), frame.size());
+            }
+            if (result.size() == sendMessage.size()) {
+                // the stream consumes the frames after we return, signal afterwards
+                boost::asio::post(m_ioContext, [&readPromise]() { readPromise.set_value(boost::system::error_code()); });
+                return;
+            }
+            clientStream.asyncReadFrames(Stream::fixedFrameLength(frameSize), framesCb);
+        };
+        clientStream.asyncReadFrames(Stream::fixedFrameLength(frameSize), framesCb);
+        ASSERT_EQ(readFuture.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+        ASSERT_EQ(readFuture.get(), boost::system::error_code());
+        ASSERT_EQ(result, sendMessage);
+
+        ec = clientStream.close();
+        ASSERT_EQ(ec, boost::system::error_code());
+    }
+
+    /// detached chunks stay valid while reading continues
+    TEST_F(TcpStreamTest, test_write_read_detach_pooled)
+    {
+        boost::system::error_code ec;
+        std::size_t bytesWritten;
+        TcpClientStream clientStream(m_ioContext, "localhost", std::to_string(ListeningPort), ReceiveBufferType::Pooled);
+        ec = clientStream.init();
+        ASSERT_EQ(ec, boost::system::error_code());
+
+        std::string sendMessage(200000, 'x');
+        for (size_t index = 0; index < sendMessage.size(); ++index) {
+            sendMessage[index] = static_cast < char > (index % 251);
+        }
+        bytesWritten = clientStream.write(boost::asio::buffer(sendMessage), ec);
+        ASSERT_EQ(ec, boost::system::error_code());
+        ASSERT_EQ(bytesWritten, sendMessage.size());
+
+        std::vector < BufferSlice > slices;
+        size_t received = 0;
+        while (received < sendMessage.size()) {
+            size_t chunkSize = std::min < size_t > (30000, sendMessage.size() - received);
+            ec = clientStream.read(chunkSize);
+            ASSERT_EQ(ec, boost::system::error_code());
+            const uint8_t* data = clientStream.data();
+            slices.push_back(clientStream.detach(chunkSize));
+            ASSERT_EQ(slices.back().data(), data);
+            received += chunkSize;
+        }
+
+        std::string result;
+        for (const BufferSlice& slice : slices) {
+            result += std::string(reinterpret_cast < const char* >(slice.data()), slice.size());
+        }
+        ASSERT_EQ(sendMessage, result);
+
+        ec = clientStream.close();
+        ASSERT_EQ(ec, boost::system::error_code());
+    }
+
+    TEST_F(TcpStreamTest, test_write_read_adaptive_read_size)
+    {
+        boost::system::error_code ec;
+        std::size_t bytesWritten;
+        TcpClientStream clientStream(m_ioContext, "localhost", std::to_string(ListeningPort));
+        ReadSizePolicy policy;
+        policy.minReadSize = 1024;
+        policy.maxReadSize = 1024 * 1024;
+        policy.adaptive = true;
+        clientStream.setReadSizePolicy(policy);
+        ASSERT_TRUE(clientStream.readSizePolicy().adaptive);
+
+        ec = clientStream.init();
+        ASSERT_EQ(ec, boost::system::error_code());
+
+        std::string sendMessage(200000, 'x');
+        for (size_t index = 0; index < sendMessage.size(); ++index) {
+            sendMessage[index] = static_cast < char > (index % 251);
+        }
+        bytesWritten = clientStream.write(boost::asio::buffer(sendMessage), ec);
+        ASSERT_EQ(ec, boost::system::error_code());
+        ASSERT_EQ(bytesWritten, sendMessage.size());
+
+        ec = clientStream.read(sendMessage.size());
+        ASSERT_EQ(ec, boost::system::error_code());
+        ASSERT_GE(clientStream.size(), sendMessage.size());
+        std::string result(reinterpret_cast < const char* >(clientStream.data()), sendMessage.size());
+        clientStream.consume(sendMessage.size());
+        ASSERT_EQ(sendMessage, result);
+
+        ec = clientStream.close();
+        ASSERT_EQ(ec, boost::system::error_code());
+    }
+
     TEST_F(TcpStreamTest, test_disconnect_by_server)
     {
         TcpClientStream clientStream(m_ioContext, "localhost", std::to_string(ListeningPort));
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+
+#include "stream/Stream.hpp"
+
+namespace daq::stream {
+    /// Stream without transport, shared by the tests.
+    /// Written data is appended to the receive buffer, it is read back like from a loopback connection.
+    /// With m_holdWrites, a transport write completes only when the test calls completeWrite().
+    class TestStream : public Stream
+    {
+    public:
+        explicit TestStream(ReceiveBufferType receiveBufferType = ReceiveBufferType::Streambuf)
+            : Stream(receiveBufferType)
+        {
+        }
+
+        /// Put data into the receive buffer as if it got received
+        /// \return Number of bytes appended
+        size_t append(const ConstBufferView& data)
+        {
+            size_t size = boost::asio::buffer_size(data);
+            ReceiveBufferRef buffer = receiveBuffer();
+            boost::asio::buffer_copy(buffer.prepare(size), data);
+            buffer.commit(size);
+            return size;
+        }
+
+        size_t append(const boost::asio::const_buffer& data)
+        {
+            return append(ConstBufferView(&data, &data + 1));
+        }
+
+        void asyncInit(CompletionCb) override
+        {
+        }
+
+        boost::system::error_code init() override
+        {
+            return boost::system::error_code();
+        }
+
+        std::string endPointUrl() const override
+        {
+            return "";
+        }
+
+        std::string remoteHost() const override
+        {
+            return "";
+        }
+
+        void asyncReadAtLeast(std::size_t, ReadCompletionCb) override
+        {
+        }
+
+        size_t readAtLeast(std::size_t, boost::system::error_code&) override
+        {
+            return 0;
+        }
+
+        void asyncWriteTransport(const ConstBufferView& data, WriteCompletionCb writeCompletionCb) override
+        {
+            m_transportWrites.push_back(ConstBufferVector(data.begin(), data.end()));
+            m_pendingCb = std::move(writeCompletionCb);
+            if (!m_holdWrites) {
+                completeWrite();
+            }
+        }
+
+        size_t write(const boost::asio::const_buffer& data, boost::system::error_code&) override
+        {
+            return append(data);
+        }
+
+        size_t write(const ConstBufferVector& data, boost::system::error_code&) override
+        {
+            return append(ConstBufferView(data.data(), data.data() + data.size()));
+        }
+
+        void asyncClose(CompletionCb closeCb) override
+        {
+            closeCb(boost::system::error_code());
+        }
+
+        boost::system::error_code close() override
+        {
+            return boost::system::error_code();
+        }
+
+        /// Complete the transport write in progress. Without an error, the written data is read back.
+        void completeWrite(const boost::system::error_code& ec = boost::system::error_code())
+        {
+            const ConstBufferVector& data = m_transportWrites.back();
+            size_t bytes = ec ? 0 : append(ConstBufferView(data.data(), data.data() + data.size()));
+            WriteCompletionCb writeCb = std::move(m_pendingCb);
+            writeCb(ec, bytes);
+        }
+
+        bool writing() const
+        {
+            return static_cast < bool >(m_pendingCb);
+        }
+
+        /// Buffers of all transport writes. They refer to memory that is valid until the write completed.
+        std::vector < ConstBufferVector > m_transportWrites;
+        /// Transport writes do not complete until completeWrite()
+        bool m_holdWrites = false;
+
+    private:
+        WriteCompletionCb m_pendingCb;
+    };
+}
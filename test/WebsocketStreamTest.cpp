@@ -2,13 +2,19 @@
 #include <future>
 #include <thread>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
 
 #include <gtest/gtest.h>
 
+#include "stream/BroadcastHub.hpp"
+#include "stream/Defines.hpp"
 #include "stream/Stream.hpp"
 #include "stream/WebsocketClientStream.hpp"
 
 #include "stream/WebsocketServer.hpp"
+#include "stream/WebsocketServerStream.hpp"
 
 
 namespace daq::stream {
@@ -248,6 +254,600 @@ namespace daq::stream {
         ASSERT_EQ(message, response);
     }
 
+    /// A block bigger than the write buffer of the websocket reaches all clients unchanged
+    TEST(WebsocketServer, test_broadcast)
+    {
+        static const uint16_t ListeningPort = 5004;
+        static const size_t ClientCount = 3;
+
+        boost::asio::io_context ioContext;
+        BroadcastHub hub;
+        std::vector < StreamSharedPtr > serverStreams;
+
+        std::string block(200000, '\0');
+        for (size_t index = 0; index < block.size(); ++index) {
+            block[index] = static_cast < char >(index % 251);
+        }
+        std::string tail = "tail";
+
+        auto newStreamCb = [&](StreamSharedPtr newStream)
+        {
+            serverStreams.push_back(newStream);
+            hub.subscribe(newStream);
+            if (serverStreams.size() == ClientCount) {
+                hub.publish(boost::asio::buffer(block));
+                hub.publish(boost::asio::buffer(tail));
+            }
+        };
+        WebsocketServer server(ioContext, newStreamCb, ListeningPort);
+        ASSERT_EQ(server.start(), 0);
+
+        std::vector < std::unique_ptr < WebsocketClientStream > > clients;
+        std::vector < std::string > received(ClientCount);
+        size_t completed = 0;
+        for (size_t index = 0; index < ClientCount; ++index) {
+            clients.push_back(std::make_unique < WebsocketClientStream >(ioContext, "localhost", std::to_string(ListeningPort), "/"));
+            WebsocketClientStream& client = *clients.back();
+            client.asyncInit([&, index](const boost::system::error_code& ec)
+            {
+                ASSERT_FALSE(ec);
+                client.asyncRead([&, index](const boost::system::error_code& ec)
+                {
+                    ASSERT_FALSE(ec);
+                    received[index] = std::string(reinterpret_cast < const char* >(client.data()), client.size());
+                    if (++completed == ClientCount) {
+                        server.stop();
+                        ioContext.stop();
+                    }
+                }, block.size() + tail.size());
+            });
+        }
+
+        ioContext.run();
+        ASSERT_EQ(completed, ClientCount);
+        for (const auto& data : received) {
+            ASSERT_EQ(data, block + tail);
+        }
+        for (const auto& stream : serverStreams) {
+            ASSERT_EQ(hub.stats(*stream).sentMessages, 2);
+        }
+    }
+
+    /// Messages keep their boundaries and their kind, even when queued at once
+    TEST(WebsocketServer, test_messages)
+    {
+        static const uint16_t ListeningPort = 5005;
+
+        boost::asio::io_context ioContext;
+        StreamSharedPtr serverStream;
+
+        std::function < void() > echoMessage = [&]()
+        {
+            serverStream->asyncReadMessage([&](const boost::system::error_code& ec, const ConstBufferView& message, bool binary)
+            {
+                if (ec) {
+                    return;
+                }
+                ASSERT_EQ(message.count(), 1);
+                // copied, the message is consumed after returning
+                auto copy = std::make_shared < std::string >(static_cast < const char* >(message.begin()->data()), message.begin()->size());
+                serverStream->asyncWriteMessage(boost::asio::buffer(*copy), binary, [copy](const boost::system::error_code&, std::size_t)
+                {
+                });
+                echoMessage();
+            });
+        };
+        auto newStreamCb = [&](StreamSharedPtr newStream)
+        {
+            serverStream = newStream;
+            echoMessage();
+        };
+        WebsocketServer server(ioContext, newStreamCb, ListeningPort);
+        ASSERT_EQ(server.start(), 0);
+
+        WebsocketClientStream client(ioContext, "localhost", std::to_string(ListeningPort), "/");
+        std::vector < std::pair < std::string, bool > > received;
+        std::string text = "text";
+        std::string first = "bin";
+        std::string second = "ary";
+        std::function < void() > readMessage = [&]()
+        {
+            client.asyncReadMessage([&](const boost::system::error_code& ec, const ConstBufferView& message, bool binary)
+            {
+                ASSERT_FALSE(ec);
+                received.emplace_back(std::string(static_cast < const char* >(message.begin()->data()), message.begin()->size()), binary);
+                if (received.size() < 3) {
+                    readMessage();
+                    return;
+                }
+                server.stop();
+                ioContext.stop();
+            });
+        };
+        client.asyncInit([&](const boost::system::error_code& ec)
+        {
+            ASSERT_FALSE(ec);
+            client.asyncWriteMessage(boost::asio::buffer(text), false, [](const boost::system::error_code&, std::size_t) {});
+            client.asyncWriteMessage(ConstBufferVector({ boost::asio::buffer(first), boost::asio::buffer(second) }), true, [](const boost::system::error_code&, std::size_t) {});
+            client.asyncWriteMessage(boost::asio::buffer(text), true, [](const boost::system::error_code&, std::size_t) {});
+            readMessage();
+        });
+
+        ioContext.run();
+        std::vector < std::pair < std::string, bool > > expected = { { "text", false }, { "binary", true }, { "text", true } };
+        ASSERT_EQ(received, expected);
+    }
+
+    /// Plain writes queued while another one is in progress are not combined, each one arrives as a message of its own
+    TEST(WebsocketServer, test_write_boundaries)
+    {
+        static const uint16_t ListeningPort = 5016;
+
+        boost::asio::io_context ioContext;
+        StreamSharedPtr serverStream;
+        std::vector < std::string > received;
+        const std::vector < std::string > sent = { "a", "bb", "ccc", "dddd" };
+
+        std::function < void() > readMessage = [&]()
+        {
+            serverStream->asyncReadMessage([&](const boost::system::error_code& ec, const ConstBufferView& message, bool)
+            {
+                if (ec) {
+                    return;
+                }
+                received.emplace_back(static_cast < const char* >(message.begin()->data()), message.begin()->size());
+                if (received.size() < sent.size()) {
+                    readMessage();
+                    return;
+                }
+                ioContext.stop();
+            });
+        };
+        auto newStreamCb = [&](StreamSharedPtr newStream)
+        {
+            serverStream = newStream;
+            readMessage();
+        };
+        WebsocketServer server(ioContext, newStreamCb, ListeningPort);
+        ASSERT_EQ(server.start(), 0);
+
+        // writes combined into fewer messages would keep the server waiting
+        boost::asio::steady_timer timeout(ioContext, std::chrono::seconds(5));
+        timeout.async_wait([&](const boost::system::error_code&) { ioContext.stop(); });
+
+        WebsocketClientStream client(ioContext, "localhost", std::to_string(ListeningPort), "/");
+        client.asyncInit([&](const boost::system::error_code& ec)
+        {
+            ASSERT_FALSE(ec);
+            for (const auto& data : sent) {
+                client.asyncWrite(boost::asio::buffer(data), [](const boost::system::error_code&, std::size_t) {});
+            }
+        });
+
+        ioContext.run();
+        server.stop();
+        ASSERT_EQ(received, sent);
+    }
+
+    /// A websocket accepted on boost::beast::tcp_stream, as before WebsocketTransport, still makes a server stream
+    TEST(WebsocketServerStream, test_tcp_websocket)
+    {
+        static const uint16_t ListeningPort = 5019;
+        static const std::string message = "hello tcp websocket!";
+
+        boost::asio::io_context ioContext;
+        boost::asio::ip::tcp::acceptor acceptor(ioContext, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), ListeningPort));
+        std::shared_ptr < WebsocketServerStream > serverStream;
+        acceptor.async_accept([&](const boost::system::error_code& ec, boost::asio::ip::tcp::socket&& socket)
+        {
+            ASSERT_FALSE(ec);
+            auto websocket = std::make_shared < TcpWebsocket >(std::move(socket));
+            websocket->async_accept([&, websocket](const boost::system::error_code& ec)
+            {
+                ASSERT_FALSE(ec);
+                serverStream = std::make_shared < WebsocketServerStream >(websocket);
+                ASSERT_FALSE(serverStream->init());
+                ASSERT_EQ(serverStream->remoteHost(), "127.0.0.1");
+                ASSERT_EQ(serverStream->endPointUrl().rfind("127_0_0_1_", 0), 0);
+                // echo one message
+                serverStream->asyncReadMessage([&](const boost::system::error_code& ec, const ConstBufferView& received, bool binary)
+                {
+                    ASSERT_FALSE(ec);
+                    auto echo = std::make_shared < std::string >(boost::asio::buffer_size(received), '\0');
+                    boost::asio::buffer_copy(boost::asio::buffer(*echo), received);
+                    serverStream->asyncWriteMessage(boost::asio::buffer(*echo), binary, [echo](const boost::system::error_code&, std::size_t) {});
+                });
+            });
+        });
+
+        WebsocketClientStream client(ioContext, "127.0.0.1", std::to_string(ListeningPort), "/");
+        std::string response;
+        client.asyncInit([&](const boost::system::error_code& ec)
+        {
+            ASSERT_FALSE(ec);
+            client.asyncWriteMessage(boost::asio::buffer(message), false, [](const boost::system::error_code&, std::size_t) {});
+            client.asyncReadMessage([&](const boost::system::error_code& ec, const ConstBufferView& received, bool binary)
+            {
+                ASSERT_FALSE(ec);
+                ASSERT_FALSE(binary);
+                response.resize(boost::asio::buffer_size(received));
+                boost::asio::buffer_copy(boost::asio::buffer(response), received);
+                ioContext.stop();
+            });
+        });
+        ioContext.run();
+
+        ASSERT_EQ(response, message);
+        // the transport does not count
+        ASSERT_EQ(serverStream->trafficStats().uncompressedBytesSent, message.size());
+        ASSERT_EQ(serverStream->trafficStats().compressedBytesSent, 0);
+    }
+
+    TEST(WebsocketServer, test_deflate)
+    {
+        static const uint16_t ListeningPort = 5006;
+
+        WebsocketDeflateOptions deflateOptions;
+        deflateOptions.enabled = true;
+
+        boost::asio::io_context ioContext;
+        std::shared_ptr < WebsocketServerStream > serverStream;
+        size_t messagesReceived = 0;
+        std::function < void() > readMessage = [&]()
+        {
+            serverStream->asyncReadMessage([&](const boost::system::error_code& ec, const ConstBufferView&, bool)
+            {
+                if (ec) {
+                    return;
+                }
+                if (++messagesReceived < 2) {
+                    readMessage();
+                    return;
+                }
+                ioContext.stop();
+            });
+        };
+        auto newStreamCb = [&](StreamSharedPtr newStream)
+        {
+            serverStream = std::dynamic_pointer_cast < WebsocketServerStream >(newStream);
+            readMessage();
+        };
+        WebsocketServer server(ioContext, newStreamCb, ListeningPort);
+        server.setDeflateOptions(deflateOptions);
+        ASSERT_EQ(server.start(), 0);
+
+        WebsocketClientStream client(ioContext, "localhost", std::to_string(ListeningPort), "/");
+        client.setDeflateOptions(deflateOptions);
+        std::vector < uint8_t > compressible(65536, 0x55);
+        std::vector < uint8_t > small(16, 0x55);
+        client.asyncInit([&](const boost::system::error_code& ec)
+        {
+            ASSERT_FALSE(ec);
+            client.asyncWriteMessage(boost::asio::buffer(compressible), true, [](const boost::system::error_code&, std::size_t) {});
+            client.asyncWriteMessage(boost::asio::buffer(small), true, [](const boost::system::error_code&, std::size_t) {});
+        });
+        ioContext.run();
+        server.stop();
+
+        ASSERT_EQ(messagesReceived, 2);
+        WebsocketTrafficStats clientStats = client.trafficStats();
+        ASSERT_EQ(clientStats.uncompressedBytesSent, compressible.size() + small.size());
+        ASSERT_LT(clientStats.compressedBytesSent, compressible.size() / 10);
+
+        WebsocketTrafficStats serverStats = serverStream->trafficStats();
+        ASSERT_EQ(serverStats.uncompressedBytesReceived, clientStats.uncompressedBytesSent);
+        ASSERT_EQ(serverStats.compressedBytesReceived, clientStats.compressedBytesSent);
+    }
+
+    /// Small messages are sent uncompressed if Beast can switch compression per message, otherwise the option is dropped
+    TEST(WebsocketServer, test_deflate_min_message_size)
+    {
+        static const uint16_t ListeningPort = 5018;
+
+        WebsocketDeflateOptions deflateOptions;
+        deflateOptions.enabled = true;
+        deflateOptions.minMessageSize = 1024;
+
+        boost::asio::io_context ioContext;
+        std::shared_ptr < WebsocketServerStream > serverStream;
+        auto newStreamCb = [&](StreamSharedPtr newStream)
+        {
+            serverStream = std::dynamic_pointer_cast < WebsocketServerStream >(newStream);
+            serverStream->asyncReadMessage([&](const boost::system::error_code&, const ConstBufferView&, bool)
+            {
+                ioContext.stop();
+            });
+        };
+        WebsocketServer server(ioContext, newStreamCb, ListeningPort);
+        server.setDeflateOptions(deflateOptions);
+        if (!perMessageCompressionSupported()) {
+            ASSERT_EQ(server.deflateOptions().minMessageSize, 0);
+            GTEST_SKIP() << "Beast can not switch compression per message";
+        }
+        ASSERT_EQ(server.deflateOptions().minMessageSize, 1024);
+        ASSERT_EQ(server.start(), 0);
+
+        WebsocketClientStream client(ioContext, "localhost", std::to_string(ListeningPort), "/");
+        client.setDeflateOptions(deflateOptions);
+        std::vector < uint8_t > small(16, 0x55);
+        client.asyncInit([&](const boost::system::error_code& ec)
+        {
+            ASSERT_FALSE(ec);
+            client.asyncWriteMessage(boost::asio::buffer(small), true, [](const boost::system::error_code&, std::size_t) {});
+        });
+        ioContext.run();
+        server.stop();
+
+        // payload as is behind 2 bytes of header and 4 bytes of mask
+        ASSERT_EQ(client.trafficStats().compressedBytesSent, small.size() + 6);
+    }
+
+    /// Messages above readMessageMax are rejected, fragmented messages of the client arrive complete
+    TEST(WebsocketServer, test_websocket_options)
+    {
+        static const uint16_t ListeningPort = 5007;
+
+        WebsocketOptions serverOptions;
+        serverOptions.readMessageMax = 4096;
+        serverOptions.readBufferSize = 1024;
+        WebsocketOptions clientOptions;
+        clientOptions.autoFragment = true;
+        clientOptions.writeBufferSize = 512;
+
+        boost::asio::io_context ioContext;
+        std::shared_ptr < WebsocketServerStream > serverStream;
+        std::vector < size_t > received;
+        boost::system::error_code readError;
+        std::function < void() > readMessage = [&]()
+        {
+            serverStream->asyncReadMessage([&](const boost::system::error_code& ec, const ConstBufferView& message, bool)
+            {
+                if (ec) {
+                    readError = ec;
+                    ioContext.stop();
+                    return;
+                }
+                received.push_back(boost::asio::buffer_size(message));
+                readMessage();
+            });
+        };
+        auto newStreamCb = [&](StreamSharedPtr newStream)
+        {
+            serverStream = std::dynamic_pointer_cast < WebsocketServerStream >(newStream);
+            readMessage();
+        };
+        WebsocketServer server(ioContext, newStreamCb, ListeningPort);
+        server.setWebsocketOptions(serverOptions);
+        ASSERT_EQ(server.start(), 0);
+
+        WebsocketClientStream client(ioContext, "localhost", std::to_string(ListeningPort), "/");
+        client.setWebsocketOptions(clientOptions);
+        std::vector < uint8_t > allowed(serverOptions.readMessageMax, 0x55);
+        std::vector < uint8_t > tooBig(serverOptions.readMessageMax + 1, 0x55);
+        uint64_t allowedBytesSent = 0;
+        client.asyncInit([&](const boost::system::error_code& ec)
+        {
+            ASSERT_FALSE(ec);
+            client.asyncWriteMessage(boost::asio::buffer(allowed), true, [&](const boost::system::error_code&, std::size_t)
+            {
+                allowedBytesSent = client.trafficStats().compressedBytesSent;
+            });
+            client.asyncWriteMessage(boost::asio::buffer(tooBig), true, [](const boost::system::error_code&, std::size_t) {});
+            // answers the close the server starts after the message being too big
+            client.asyncReadSome([](const boost::system::error_code&, std::size_t) {});
+        });
+        ioContext.run();
+        server.stop();
+
+        ASSERT_EQ(received, std::vector < size_t >{ allowed.size() });
+        ASSERT_EQ(readError, boost::beast::websocket::error::message_too_big);
+        ASSERT_EQ(serverStream->readSizePolicy().maxReadSize, serverOptions.readBufferSize);
+        // 8 frames of 512 bytes, each with 2 bytes of header, 2 bytes of extended length and 4 bytes of mask
+        ASSERT_EQ(allowedBytesSent, allowed.size() + 8 * 8);
+    }
+
+    TEST(WebsocketWriteBufferSizer, test_adaptive)
+    {
+        WebsocketOptions options;
+        options.writeBufferSize = 4096;
+        options.minWriteBufferSize = 1024;
+        options.maxWriteBufferSize = 65536;
+
+        WebsocketWriteBufferSizer sizer;
+        sizer.setOptions(options);
+        ASSERT_EQ(sizer.onMessage(1000000), 4096);
+
+        options.adaptiveWriteBuffer = true;
+        sizer.setOptions(options);
+        ASSERT_EQ(sizer.onMessage(5000), 8192);
+        ASSERT_EQ(sizer.onMessage(1000000), 65536);
+
+        for (size_t message = 1; message < WebsocketWriteBufferSizer::ShrinkAfterMessages; ++message) {
+            ASSERT_EQ(sizer.onMessage(100), 65536);
+        }
+        ASSERT_EQ(sizer.onMessage(100), 32768);
+
+        // a message not fitting into a quarter starts counting again
+        for (size_t message = 1; message < WebsocketWriteBufferSizer::ShrinkAfterMessages; ++message) {
+            sizer.onMessage(100);
+        }
+        ASSERT_EQ(sizer.onMessage(16384), 32768);
+        ASSERT_EQ(sizer.onMessage(100), 32768);
+
+        for (size_t message = 0; message < 10 * WebsocketWriteBufferSizer::ShrinkAfterMessages; ++message) {
+            sizer.onMessage(100);
+        }
+        ASSERT_EQ(sizer.writeBufferSize(), 1024);
+    }
+
+    /// Both sides ping and measure while the other side is reading
+    TEST(WebsocketServer, test_rtt)
+    {
+        static const uint16_t ListeningPort = 5008;
+        static const std::chrono::milliseconds PingInterval(5);
+        static const uint64_t MinPongs = 3;
+
+        boost::asio::io_context ioContext;
+        std::shared_ptr < WebsocketServerStream > serverStream;
+        WebsocketClientStream client(ioContext, "localhost", std::to_string(ListeningPort), "/");
+        boost::asio::steady_timer checkTimer(ioContext);
+        std::function < void() > check = [&]()
+        {
+            checkTimer.expires_after(PingInterval);
+            checkTimer.async_wait([&](const boost::system::error_code&)
+            {
+                if (serverStream && serverStream->rttStats().pongsReceived >= MinPongs && client.rttStats().pongsReceived >= MinPongs) {
+                    ioContext.stop();
+                    return;
+                }
+                check();
+            });
+        };
+        auto newStreamCb = [&](StreamSharedPtr newStream)
+        {
+            serverStream = std::dynamic_pointer_cast < WebsocketServerStream >(newStream);
+            serverStream->asyncReadSome([](const boost::system::error_code&, std::size_t) {});
+        };
+        WebsocketServer server(ioContext, newStreamCb, ListeningPort);
+        server.setPingInterval(PingInterval);
+        ASSERT_EQ(server.start(), 0);
+
+        client.asyncInit([&](const boost::system::error_code& ec)
+        {
+            ASSERT_FALSE(ec);
+            client.setPingInterval(PingInterval);
+            client.asyncReadSome([](const boost::system::error_code&, std::size_t) {});
+            check();
+        });
+        ioContext.run_for(std::chrono::seconds(5));
+        server.stop();
+
+        for (const WebsocketRttStats& stats : { serverStream->rttStats(), client.rttStats() }) {
+            ASSERT_GE(stats.pongsReceived, MinPongs);
+            ASSERT_GE(stats.pingsSent, stats.pongsReceived);
+            ASSERT_GT(stats.maxRtt.count(), 0);
+            ASSERT_LE(stats.minRtt, stats.smoothedRtt);
+            ASSERT_LE(stats.smoothedRtt, stats.maxRtt);
+            ASSERT_NE(stats.lastPongTime, std::chrono::steady_clock::time_point());
+        }
+    }
+
+    /// Stopping the server closes the streams of clients that do not read anymore, without waiting for a close handshake
+    TEST(WebsocketServer, test_shutdown_modes)
+    {
+        static const uint16_t ListeningPort = 5009;
+        static const size_t ClientCount = 20;
+
+        for (WebsocketCloseMode shutdownMode : { WebsocketCloseMode::CloseFrame, WebsocketCloseMode::Abort }) {
+            boost::asio::io_context ioContext;
+            size_t closedStreams = 0;
+            // exceeds the socket buffers, the writes are still in progress on stop
+            std::vector < uint8_t > bigMessage(64 * 1024 * 1024);
+            auto newStreamCb = [&](StreamSharedPtr newStream)
+            {
+                newStream->asyncWrite(boost::asio::buffer(bigMessage), [](const boost::system::error_code& ec, std::size_t)
+                {
+                    ASSERT_TRUE(ec);
+                });
+                // the pending read keeps the stream alive, the server tracks it without owning it
+                newStream->asyncReadSome([&, newStream](const boost::system::error_code& ec, std::size_t)
+                {
+                    ASSERT_TRUE(ec);
+                    if (++closedStreams == ClientCount) {
+                        ioContext.stop();
+                    }
+                });
+            };
+            WebsocketServer server(ioContext, newStreamCb, ListeningPort);
+            server.setCloseStreamsOnStop(true);
+            server.setShutdownMode(shutdownMode);
+            ASSERT_EQ(server.start(), 0);
+
+            std::vector < std::unique_ptr < WebsocketClientStream > > clients;
+            for (size_t index = 0; index < ClientCount; ++index) {
+                clients.push_back(std::make_unique < WebsocketClientStream >(ioContext, "localhost", std::to_string(ListeningPort), "/"));
+                // clients never read, like dead ones
+                clients.back()->asyncInit([](const boost::system::error_code& ec)
+                {
+                    ASSERT_FALSE(ec);
+                });
+            }
+            while (server.streams().size() < ClientCount) {
+                ioContext.run_one();
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            server.stop();
+            ASSERT_TRUE(server.streams().empty());
+            ioContext.run_for(std::chrono::seconds(2));
+            ASSERT_EQ(closedStreams, ClientCount);
+            ASSERT_LT(std::chrono::steady_clock::now() - start, WEBSOCKET_CLOSE_HANDSHAKE_TIMEOUT);
+        }
+    }
+
+    /// A handshake completing after stop() gets closed, no stream is handed out for it
+    TEST(WebsocketServer, test_stop_during_handshake)
+    {
+        static const uint16_t ListeningPort = 5020;
+
+        boost::asio::io_context ioContext;
+        size_t newStreams = 0;
+        auto newStreamCb = [&](StreamSharedPtr)
+        {
+            ++newStreams;
+        };
+        WebsocketServer server(ioContext, newStreamCb, ListeningPort);
+        server.setShutdownMode(WebsocketCloseMode::CloseFrame);
+        ASSERT_EQ(server.start(), 0);
+
+        boost::asio::ip::tcp::socket client(ioContext);
+        client.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), ListeningPort));
+        std::string request =
+            "GET / HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "\r\n";
+        // the server accepts and waits for the rest of the request
+        boost::asio::write(client, boost::asio::buffer(request.data(), 20));
+        ioContext.run_for(std::chrono::milliseconds(100));
+        server.stop();
+        boost::asio::write(client, boost::asio::buffer(request.data() + 20, request.size() - 20));
+
+        std::string received;
+        auto readCb = [&](const boost::system::error_code& ec, std::size_t)
+        {
+            ASSERT_EQ(ec, boost::asio::error::eof);
+            ioContext.stop();
+        };
+        boost::asio::async_read(client, boost::asio::dynamic_buffer(received), readCb);
+        ioContext.restart();
+        ioContext.run_for(std::chrono::seconds(2));
+        ASSERT_EQ(newStreams, 0);
+        ASSERT_TRUE(server.streams().empty());
+        // the upgrade response followed by the close frame
+        ASSERT_EQ(received.find("HTTP/1.1 101"), 0);
+        ASSERT_EQ(received.substr(received.size() - 4, 2), "\x88\x02");
+    }
+
+    TEST(RttEstimator, test_smoothing)
+    {
+        RttEstimator estimator;
+        estimator.addSample(std::chrono::microseconds(800));
+        ASSERT_EQ(estimator.smoothedRtt().count(), 800);
+        ASSERT_EQ(estimator.jitter().count(), 400);
+
+        estimator.addSample(std::chrono::microseconds(1600));
+        ASSERT_EQ(estimator.samples(), 2);
+        ASSERT_EQ(estimator.smoothedRtt().count(), 900);
+        ASSERT_EQ(estimator.jitter().count(), 500);
+        ASSERT_EQ(estimator.minRtt().count(), 800);
+        ASSERT_EQ(estimator.maxRtt().count(), 1600);
+        ASSERT_EQ(estimator.lastRtt().count(), 1600);
+    }
+
     TEST_F(WebsocketStreamTest, test_async_connect)
     {
         static const std::string hostname = "localhost";
@@ -533,6 +1133,34 @@ namespace daq::stream {
     
     }
 
+    /// websocket framing does not allow to read into the buffers directly, data is copied from the receive buffer
+    TEST_F(WebsocketStreamTest, test_async_read_into)
+    {
+        WebsocketClientStream clientStream(m_ioContext, "localhost", std::to_string(ListeningPort), Path);
+        boost::system::error_code ec = clientStream.init();
+        ASSERT_EQ(ec, boost::system::error_code());
+
+        std::string sendMessage = "hello world";
+        clientStream.write(boost::asio::buffer(sendMessage), ec);
+        ASSERT_EQ(ec, boost::system::error_code());
+
+        char first[5];
+        char second[6];
+        MutableBufferVector buffers = { boost::asio::buffer(first), boost::asio::buffer(second) };
+        std::promise < boost::system::error_code > readPromise;
+        std::future < boost::system::error_code > readFuture = readPromise.get_future();
+        auto readCb = [&](const boost::system::error_code& readEc, std::size_t bytesRead)
+        {
+            EXPECT_EQ(bytesRead, sendMessage.size());
+            readPromise.set_value(readEc);
+        };
+        clientStream.asyncReadInto(buffers, readCb);
+        readFuture.wait();
+        ASSERT_EQ(readFuture.get(), boost::system::error_code());
+        ASSERT_EQ(std::string(first, 5) + std::string(second, 6), sendMessage);
+        ASSERT_EQ(clientStream.size(), 0);
+    }
+
     TEST_F(WebsocketStreamTest, test_gathered_write_read)
     {
         WebsocketClientStream clientStream(m_ioContext, "localhost", std::to_string(ListeningPort), Path);